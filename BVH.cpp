@@ -0,0 +1,348 @@
+#include "BVH.h"
+#include "Trace.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <thread>
+using namespace std;
+
+namespace {
+
+  const int BINS = 16;
+  const int MAX_LEAF = 8;
+  //Deeper nodes become leaves however many triangles they hold, which bounds
+  //the traversal stack: each level leaves at most one sibling on it
+  const int MAX_DEPTH = 64;
+  const int STACK_SIZE = 2*MAX_DEPTH;
+  const int PARALLEL_MIN = 4096;
+
+  struct Bounds{
+    float lo[3];
+    float hi[3];
+
+    Bounds(){
+      for(int a=0; a<3; a++){
+        lo[a] = numeric_limits<float>::max();
+        hi[a] = -numeric_limits<float>::max();
+      }
+    }
+    void grow(const float p[3]){
+      for(int a=0; a<3; a++){
+        lo[a] = std::min(lo[a], p[a]);
+        hi[a] = std::max(hi[a], p[a]);
+      }
+    }
+    void grow(const Bounds& b){
+      for(int a=0; a<3; a++){
+        lo[a] = std::min(lo[a], b.lo[a]);
+        hi[a] = std::max(hi[a], b.hi[a]);
+      }
+    }
+    float area() const {
+      float dx=hi[0]-lo[0], dy=hi[1]-lo[1], dz=hi[2]-lo[2];
+      if(dx<0 || dy<0 || dz<0)
+        return 0.f;
+      return 2.f*(dx*dy + dy*dz + dz*dx);
+    }
+  };
+
+  struct BuildNode{
+    Bounds bounds;
+    int first;
+    int count;
+    unique_ptr<BuildNode> left;
+    unique_ptr<BuildNode> right;
+  };
+
+  //Shared, read only inputs of a build; tasks own disjoint ranges of order
+  struct BuildInput{
+    vector<Bounds> triBounds;
+    vector<array<float,3>> centroids;
+    vector<int> order;
+  };
+
+  unique_ptr<BuildNode> buildRange(BuildInput& in, int first, int count, int depth, int spawnDepth){
+    unique_ptr<BuildNode> node(new BuildNode());
+    node->first = first;
+    node->count = count;
+
+    Bounds centroidBounds;
+    for(int i=first; i<first+count; i++){
+      node->bounds.grow(in.triBounds[in.order[i]]);
+      centroidBounds.grow(in.centroids[in.order[i]].data());
+    }
+    if(count <= 2 || depth >= MAX_DEPTH)
+      return node;
+
+    //Binned SAH: evaluate BINS-1 planes on every axis
+    float bestCost = numeric_limits<float>::max();
+    int bestAxis = -1;
+    int bestSplit = 0;
+    for(int a=0; a<3; a++){
+      float extent = centroidBounds.hi[a]-centroidBounds.lo[a];
+      if(extent <= 0.f)
+        continue;
+      float scale = BINS/extent;
+
+      Bounds binBounds[BINS];
+      int binCount[BINS] = {0};
+      for(int i=first; i<first+count; i++){
+        int t = in.order[i];
+        int b = std::min(BINS-1, int((in.centroids[t][a]-centroidBounds.lo[a])*scale));
+        binCount[b]++;
+        binBounds[b].grow(in.triBounds[t]);
+      }
+
+      float rightArea[BINS];
+      int rightCount[BINS];
+      Bounds acc;
+      int n=0;
+      for(int b=BINS-1; b>0; b--){
+        acc.grow(binBounds[b]);
+        n += binCount[b];
+        rightArea[b] = acc.area();
+        rightCount[b] = n;
+      }
+      Bounds leftAcc;
+      int leftN=0;
+      for(int b=1; b<BINS; b++){
+        leftAcc.grow(binBounds[b-1]);
+        leftN += binCount[b-1];
+        if(leftN==0 || rightCount[b]==0)
+          continue;
+        float cost = leftN*leftAcc.area() + rightCount[b]*rightArea[b];
+        if(cost < bestCost){
+          bestCost = cost;
+          bestAxis = a;
+          bestSplit = b;
+        }
+      }
+    }
+
+    float leafCost = count*node->bounds.area();
+    if(bestAxis < 0 || (count <= MAX_LEAF && bestCost >= leafCost))
+      return node;
+
+    float lo = centroidBounds.lo[bestAxis];
+    float scale = BINS/(centroidBounds.hi[bestAxis]-lo);
+    int* middle = std::partition(&in.order[first], &in.order[first]+count,
+      [&](int t){
+        int b = std::min(BINS-1, int((in.centroids[t][bestAxis]-lo)*scale));
+        return b < bestSplit;
+      });
+    int leftCount = int(middle - &in.order[first]);
+
+    if(spawnDepth > 0 && count >= PARALLEL_MIN){
+      thread worker([&](){
+        TRACE_ZONE("bvh subtree");
+        node->left = buildRange(in, first, leftCount, depth+1, spawnDepth-1);
+      });
+      node->right = buildRange(in, first+leftCount, count-leftCount, depth+1, spawnDepth-1);
+      worker.join();
+    }
+    else{
+      node->left = buildRange(in, first, leftCount, depth+1, 0);
+      node->right = buildRange(in, first+leftCount, count-leftCount, depth+1, 0);
+    }
+    return node;
+  }
+
+  int flatten(BuildNode* b, TrackedVector<BVHNode, MEMORY_CACHE>& out){
+    int index = out.size();
+    out.push_back(BVHNode());
+    for(int a=0; a<3; a++){
+      out[index].boundsMin[a] = b->bounds.lo[a];
+      out[index].boundsMax[a] = b->bounds.hi[a];
+    }
+    if(!b->left){
+      out[index].offset = b->first;
+      out[index].count = b->count;
+      return index;
+    }
+    flatten(b->left.get(), out);
+    int right = flatten(b->right.get(), out);
+    out[index].offset = right;
+    out[index].count = 0;
+    return index;
+  }
+
+  void addTriangle(TrackedVector<BVH::Triangle, MEMORY_CACHE>& tris, Vertex a, Vertex b, Vertex c, int face){
+    BVH::Triangle t;
+    t.v0[0]=a.getX(); t.v0[1]=a.getY(); t.v0[2]=a.getZ();
+    t.e1[0]=b.getX()-t.v0[0]; t.e1[1]=b.getY()-t.v0[1]; t.e1[2]=b.getZ()-t.v0[2];
+    t.e2[0]=c.getX()-t.v0[0]; t.e2[1]=c.getY()-t.v0[1]; t.e2[2]=c.getZ()-t.v0[2];
+    t.face = face;
+    tris.push_back(t);
+  }
+
+  //Slab test; returns entry distance or infinity on a miss
+  inline float hitBox(const BVHNode& n, const float o[3], const float inv[3], float tMax){
+    float t0=0.f, t1=tMax;
+    for(int a=0; a<3; a++){
+      float tn = (n.boundsMin[a]-o[a])*inv[a];
+      float tf = (n.boundsMax[a]-o[a])*inv[a];
+      if(tn > tf)
+        std::swap(tn, tf);
+      t0 = tn > t0 ? tn : t0;
+      t1 = tf < t1 ? tf : t1;
+      if(t0 > t1)
+        return numeric_limits<float>::infinity();
+    }
+    return t0;
+  }
+
+  //Moller-Trumbore
+  inline bool hitTriangle(const BVH::Triangle& t, const float o[3], const float d[3], float& dist){
+    float p[3] = {d[1]*t.e2[2]-d[2]*t.e2[1], d[2]*t.e2[0]-d[0]*t.e2[2], d[0]*t.e2[1]-d[1]*t.e2[0]};
+    float det = t.e1[0]*p[0] + t.e1[1]*p[1] + t.e1[2]*p[2];
+    if(std::fabs(det) < 1e-12f)
+      return false;
+    float invDet = 1.f/det;
+    float s[3] = {o[0]-t.v0[0], o[1]-t.v0[1], o[2]-t.v0[2]};
+    float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2])*invDet;
+    if(u < 0.f || u > 1.f)
+      return false;
+    float q[3] = {s[1]*t.e1[2]-s[2]*t.e1[1], s[2]*t.e1[0]-s[0]*t.e1[2], s[0]*t.e1[1]-s[1]*t.e1[0]};
+    float v = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2])*invDet;
+    if(v < 0.f || u+v > 1.f)
+      return false;
+    float tt = (t.e2[0]*q[0] + t.e2[1]*q[1] + t.e2[2]*q[2])*invDet;
+    if(tt <= 0.f || tt >= dist)
+      return false;
+    dist = tt;
+    return true;
+  }
+}
+
+BVH::BVH(){
+  buildTime=0.f;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Build the hierarchy, splitting quads into two triangles
+/// @param faces Faces of the model; hits report indices into this list
+/// @param threads Number of threads the top of the build may use
+void BVH::build(FaceList& faces, int threads){
+  using namespace std::chrono;
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+
+  clear();
+  triangles.reserve(faces.size()*2);
+  for(size_t i=0; i<faces.size(); i++){
+    addTriangle(triangles, faces[i].getV1(), faces[i].getV2(), faces[i].getV3(), i);
+    if(!faces[i].isTriangle())
+      addTriangle(triangles, faces[i].getV1(), faces[i].getV3(), faces[i].getV4(), i);
+  }
+  if(triangles.empty())
+    return;
+
+  BuildInput in;
+  in.triBounds.resize(triangles.size());
+  in.centroids.resize(triangles.size());
+  in.order.resize(triangles.size());
+  for(size_t i=0; i<triangles.size(); i++){
+    const Triangle& t = triangles[i];
+    float b[3] = {t.v0[0]+t.e1[0], t.v0[1]+t.e1[1], t.v0[2]+t.e1[2]};
+    float c[3] = {t.v0[0]+t.e2[0], t.v0[1]+t.e2[1], t.v0[2]+t.e2[2]};
+    in.triBounds[i].grow(t.v0);
+    in.triBounds[i].grow(b);
+    in.triBounds[i].grow(c);
+    for(int a=0; a<3; a++)
+      in.centroids[i][a] = (t.v0[a]+b[a]+c[a])/3.f;
+    in.order[i] = i;
+  }
+
+  //Every split level doubles the number of concurrent subtrees
+  int spawnDepth=0;
+  while((1 << spawnDepth) < threads)
+    spawnDepth++;
+
+  TRACE_ZONE("bvh");
+  unique_ptr<BuildNode> root = buildRange(in, 0, triangles.size(), 0, spawnDepth);
+  nodes.reserve(triangles.size()/2 + 1);
+  flatten(root.get(), nodes);
+
+  TrackedVector<Triangle, MEMORY_CACHE> ordered(triangles.size());
+  for(size_t i=0; i<in.order.size(); i++)
+    ordered[i] = triangles[in.order[i]];
+  triangles.swap(ordered);
+
+  buildTime = duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+}
+
+void BVH::clear(){
+  triangles.clear();
+  nodes.clear();
+  buildTime=0.f;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Find the closest face along a ray
+/// @param origin Ray origin
+/// @param direction Ray direction, need not be normalized
+/// @param hit Closest hit; t is in units of direction
+/// @return Whether anything was hit
+bool BVH::intersect(const float origin[3], const float direction[3], Hit& hit){
+  if(nodes.empty())
+    return false;
+
+  float inv[3];
+  for(int a=0; a<3; a++)
+    inv[a] = 1.f/direction[a];
+
+  float closest = numeric_limits<float>::max();
+  int face=-1;
+  int stack[STACK_SIZE];
+  int top=0;
+  stack[top++]=0;
+
+  while(top > 0){
+    const BVHNode& n = nodes[stack[--top]];
+    if(hitBox(n, origin, inv, closest) == numeric_limits<float>::infinity())
+      continue;
+
+    if(n.count > 0){
+      for(int i=n.offset; i<n.offset+n.count; i++)
+        if(hitTriangle(triangles[i], origin, direction, closest))
+          face = triangles[i].face;
+      continue;
+    }
+
+    //Visit the nearer child first
+    int left = int(&n - &nodes[0]) + 1;
+    int right = n.offset;
+    float tl = hitBox(nodes[left], origin, inv, closest);
+    float tr = hitBox(nodes[right], origin, inv, closest);
+    if(tl > tr){
+      std::swap(left, right);
+      std::swap(tl, tr);
+    }
+    if(tr != numeric_limits<float>::infinity())
+      stack[top++] = right;
+    if(tl != numeric_limits<float>::infinity())
+      stack[top++] = left;
+  }
+
+  if(face < 0)
+    return false;
+  hit.t = closest;
+  hit.face = face;
+  for(int a=0; a<3; a++)
+    hit.point[a] = origin[a] + closest*direction[a];
+  return true;
+}
+
+bool BVH::isEmpty(){return nodes.empty();};
+int BVH::getNodeCount(){return nodes.size();};
+int BVH::getTriangleCount(){return triangles.size();};
+float BVH::getBuildTime(){return buildTime;};
+
+void BVH::getBounds(float boundsMin[3], float boundsMax[3]){
+  for(int a=0; a<3; a++){
+    boundsMin[a] = nodes.empty() ? 0.f : nodes[0].boundsMin[a];
+    boundsMax[a] = nodes.empty() ? 0.f : nodes[0].boundsMax[a];
+  }
+}
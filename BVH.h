@@ -0,0 +1,62 @@
+// STL
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include "Mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Closest intersection found by a ray query
+struct Hit{
+  float t;
+  int face;
+  float point[3];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Node of the flattened tree
+///
+/// Interior nodes keep their left child directly after them and store the
+/// right child in offset; leaves store their first triangle in offset and a
+/// nonzero count.
+struct BVHNode{
+  float boundsMin[3];
+  float boundsMax[3];
+  int offset;
+  int count;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Bounding volume hierarchy over the faces of a model
+///
+/// Built top down with a binned surface area heuristic. Subtrees near the
+/// root are built on their own threads, then the tree is flattened into a
+/// single depth first node array for traversal.
+class BVH{
+
+public:
+  struct Triangle{
+    float v0[3];
+    float e1[3];
+    float e2[3];
+    int face;
+  };
+
+private:
+  TrackedVector<Triangle, MEMORY_CACHE> triangles;
+  TrackedVector<BVHNode, MEMORY_CACHE> nodes;
+  float buildTime;
+
+public:
+  BVH();
+  void build(FaceList& faces, int threads);
+  void clear();
+  bool intersect(const float origin[3], const float direction[3], Hit& hit);
+  bool isEmpty();
+  int getNodeCount();
+  int getTriangleCount();
+  float getBuildTime();
+  void getBounds(float boundsMin[3], float boundsMax[3]);
+
+};
+#endif
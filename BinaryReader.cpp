@@ -0,0 +1,132 @@
+#include "BinaryReader.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+using namespace std;
+
+BinaryReader::BinaryReader() : buffer(1 << 20) {
+  begin=0;
+  end=0;
+  size=-1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Open a file, decompressing it as it is read if its name asks for it
+/// @return Whether the file exists and could be opened
+bool BinaryReader::open(std::string filename){
+  struct stat info;
+  if(stat(filename.c_str(), &info) != 0){
+    cout << "Could not open " << filename << endl;
+    return false;
+  }
+  if(DecompressStream::isCompressed(filename)){
+    compressed.reset(new DecompressStream(filename));
+    return !compressed->hasFailed();
+  }
+  size = info.st_size;
+  file.open(filename.c_str(), ios::in | ios::binary);
+  if(!file.is_open()){
+    cout << "Could not open " << filename << endl;
+    return false;
+  }
+  return true;
+}
+
+std::istream& BinaryReader::input(){
+  return compressed ? static_cast<istream&>(*compressed) : static_cast<istream&>(file);
+}
+
+//Makes at least bytes available from begin unless the file ends first
+bool BinaryReader::fill(size_t bytes){
+  if(end-begin >= bytes)
+    return true;
+  memmove(buffer.data(), buffer.data()+begin, end-begin);
+  end -= begin;
+  begin = 0;
+  if(buffer.size() < bytes)
+    buffer.resize(bytes);
+  while(end < bytes && input()){
+    input().read(buffer.data()+end, buffer.size()-end);
+    end += input().gcount();
+  }
+  return end >= bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Size of the file in bytes, or -1 if it is decompressed as it is read
+long BinaryReader::getSize(){return size;};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Next line of text, without its line ending
+/// @return False at the end of the file
+bool BinaryReader::getline(std::string& line){
+  size_t searched = begin;
+  while(true){
+    const char* first = buffer.data()+begin;
+    const char* found = static_cast<const char*>(memchr(buffer.data()+searched, '\n', end-searched));
+    if(found){
+      size_t length = found-first;
+      if(length > 0 && first[length-1] == '\r')
+        length--;
+      line.assign(first, length);
+      begin = found-buffer.data()+1;
+      return true;
+    }
+    searched = end-begin;
+    if(!fill(end-begin+1)){
+      if(begin == end)
+        return false;
+      line.assign(buffer.data()+begin, end-begin);
+      begin = end;
+      return true;
+    }
+    searched += begin;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief The next bytes of the file, valid until the next call
+/// @return Null if the file ends first
+const char* BinaryReader::peek(size_t bytes){
+  return fill(bytes) ? buffer.data()+begin : nullptr;
+}
+
+void BinaryReader::skip(size_t bytes){
+  begin += bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Copy the next bytes of the file into memory of the caller's
+/// @return Whether the file held that many bytes
+bool BinaryReader::read(void* out, size_t bytes){
+  size_t buffered = std::min(bytes, end-begin);
+  memcpy(out, buffer.data()+begin, buffered);
+  begin += buffered;
+  if(buffered == bytes)
+    return true;
+  input().read(static_cast<char*>(out)+buffered, bytes-buffered);
+  return size_t(input().gcount()) == bytes-buffered;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Done reading; waits for decompression to end
+/// @return Whether the whole file could be decompressed
+bool BinaryReader::finish(){
+  if(!compressed)
+    return true;
+  //Anything past the data still has to leave the queue
+  while(fill(buffer.size()))
+    begin = end;
+  compressed->finish();
+  return !compressed->hasFailed();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Whether binary files in little endian order match memory
+bool BinaryReader::isLittleEndian(){
+  uint16_t one = 1;
+  unsigned char first;
+  memcpy(&first, &one, 1);
+  return first == 1;
+}
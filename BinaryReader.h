@@ -0,0 +1,43 @@
+// STL
+#ifndef BINARYREADER_H
+#define BINARYREADER_H
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include "DecompressStream.h"
+#include "Memory.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Buffered reader for binary model files, compressed or not
+///
+/// Small records are handed out in place from a buffer with peek and skip;
+/// large blocks go straight from the file into the caller's memory with read.
+/// getline reads text headers and ASCII bodies through the same buffer.
+/// .gz and .zst files are decompressed on a thread of their own.
+class BinaryReader{
+
+private:
+  std::ifstream file;
+  std::unique_ptr<DecompressStream> compressed;
+  TrackedVector<char, MEMORY_PARSE> buffer;
+  size_t begin;
+  size_t end;
+  long size;
+
+  std::istream& input();
+  bool fill(size_t bytes);
+
+public:
+  BinaryReader();
+  bool open(std::string filename);
+  long getSize();
+  bool getline(std::string& line);
+  const char* peek(size_t bytes);
+  void skip(size_t bytes);
+  bool read(void* out, size_t bytes);
+  bool finish();
+  static bool isLittleEndian();
+
+};
+#endif
@@ -0,0 +1,55 @@
+// STL
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Blocking queue with a fixed capacity
+///
+/// push waits while the queue is full, which is what applies back-pressure
+/// between pipeline stages. Once closed, pop drains what is left and then
+/// returns false.
+template <typename T>
+class BoundedQueue{
+
+private:
+  std::deque<T> items;
+  size_t capacity;
+  bool closed;
+  std::mutex lock;
+  std::condition_variable notFull;
+  std::condition_variable notEmpty;
+
+public:
+  BoundedQueue(size_t cap) : capacity(cap > 0 ? cap : 1), closed(false) {}
+
+  void push(T item){
+    std::unique_lock<std::mutex> guard(lock);
+    notFull.wait(guard, [this](){return items.size() < capacity || closed;});
+    items.push_back(std::move(item));
+    notEmpty.notify_one();
+  }
+
+  bool pop(T& item){
+    std::unique_lock<std::mutex> guard(lock);
+    notEmpty.wait(guard, [this](){return !items.empty() || closed;});
+    if(items.empty())
+      return false;
+    item = std::move(items.front());
+    items.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+
+  void close(){
+    std::lock_guard<std::mutex> guard(lock);
+    closed = true;
+    notFull.notify_all();
+    notEmpty.notify_all();
+  }
+
+};
+#endif
@@ -0,0 +1,73 @@
+#include "Camera.h"
+#include <cmath>
+
+const float Camera::DISTANCE = 10.f;
+const float Camera::FOV = 45.f;
+const float Camera::NEAR_PLANE = 0.01f;
+const float Camera::FAR_PLANE = 100.f;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Eye position orbiting the origin in the xz plane
+/// @param theta Orbit angle
+/// @param out Eye position
+void Camera::eye(float theta, float out[3]){
+  out[0] = DISTANCE*std::sin(theta);
+  out[1] = 0.f;
+  out[2] = DISTANCE*std::cos(theta);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Same matrix as gluLookAt(eye, origin, +y)
+/// @param theta Orbit angle
+/// @param out Column major view matrix
+void Camera::modelview(float theta, float out[16]){
+  float e[3];
+  eye(theta, e);
+
+  // Forward, side and up vectors of the view
+  float len = std::sqrt(e[0]*e[0] + e[1]*e[1] + e[2]*e[2]);
+  float f[3] = {-e[0]/len, -e[1]/len, -e[2]/len};
+  float s[3] = {-f[2], 0.f, f[0]};
+  float slen = std::sqrt(s[0]*s[0] + s[2]*s[2]);
+  s[0] /= slen;
+  s[2] /= slen;
+  float u[3] = {s[1]*f[2]-s[2]*f[1], s[2]*f[0]-s[0]*f[2], s[0]*f[1]-s[1]*f[0]};
+
+  out[0]=s[0]; out[4]=s[1]; out[8]=s[2];
+  out[1]=u[0]; out[5]=u[1]; out[9]=u[2];
+  out[2]=-f[0]; out[6]=-f[1]; out[10]=-f[2];
+  out[3]=0.f; out[7]=0.f; out[11]=0.f;
+  out[12] = -(s[0]*e[0] + s[1]*e[1] + s[2]*e[2]);
+  out[13] = -(u[0]*e[0] + u[1]*e[1] + u[2]*e[2]);
+  out[14] = (f[0]*e[0] + f[1]*e[1] + f[2]*e[2]);
+  out[15] = 1.f;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Same matrix as gluPerspective(FOV, aspect, NEAR_PLANE, FAR_PLANE)
+/// @param aspect Width over height of the viewport
+/// @param out Column major projection matrix
+void Camera::projection(float aspect, float out[16]){
+  float f = 1.f/std::tan(FOV*3.14159265f/360.f);
+  for(int i=0; i<16; i++)
+    out[i] = 0.f;
+  out[0] = f/aspect;
+  out[5] = f;
+  out[10] = (FAR_PLANE+NEAR_PLANE)/(NEAR_PLANE-FAR_PLANE);
+  out[11] = -1.f;
+  out[14] = 2.f*FAR_PLANE*NEAR_PLANE/(NEAR_PLANE-FAR_PLANE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief out = a*b for column major matrices
+void Camera::multiply(const float a[16], const float b[16], float out[16]){
+  float r[16];
+  for(int c=0; c<4; c++)
+    for(int row=0; row<4; row++){
+      r[c*4+row] = 0.f;
+      for(int k=0; k<4; k++)
+        r[c*4+row] += a[k*4+row]*b[c*4+k];
+    }
+  for(int i=0; i<16; i++)
+    out[i] = r[i];
+}
@@ -0,0 +1,25 @@
+// STL
+#ifndef CAMERA_H
+#define CAMERA_H
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Orbit camera shared by every render path
+///
+/// Mirrors the gluPerspective/gluLookAt setup of the fixed function path so
+/// shader, offscreen and culling code see exactly the same view. Matrices are
+/// column major, as OpenGL expects them.
+class Camera{
+
+public:
+  static const float DISTANCE;
+  static const float FOV;
+  static const float NEAR_PLANE;
+  static const float FAR_PLANE;
+
+  static void eye(float theta, float out[3]);
+  static void modelview(float theta, float out[16]);
+  static void projection(float aspect, float out[16]);
+  static void multiply(const float a[16], const float b[16], float out[16]);
+
+};
+#endif
@@ -0,0 +1,179 @@
+#include "DecompressStream.h"
+#include "Trace.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef ZSTD
+#include <zstd.h>
+#endif
+using namespace std;
+
+namespace {
+
+  bool endsWith(const string& s, const string& suffix){
+    return s.size() >= suffix.size() && s.compare(s.size()-suffix.size(), suffix.size(), suffix) == 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Next block from the decompressing thread, waiting if none is ready
+DecompressStream::BlockBuffer::int_type DecompressStream::BlockBuffer::underflow(){
+  using namespace std::chrono;
+  if(gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  do{
+    if(!queue->pop(current))
+      return traits_type::eof();
+  } while(current.empty());
+  waitSeconds += duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+  setg(current.data(), current.data(), current.data()+current.size());
+  return traits_type::to_int_type(*gptr());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Start decompressing a file
+/// @param filename .gz or .zst file
+/// @param block Size of the blocks handed to the reader
+/// @param blocks Blocks that may wait in the queue before decompression pauses
+DecompressStream::DecompressStream(std::string filename, size_t block, size_t blocks)
+  : std::istream(nullptr), queue(blocks), cancelled(false), failed(false),
+    blockSize(block), compressedBytes(0), bytes(0), decompressSeconds(0.f) {
+  buffer.queue = &queue;
+  buffer.waitSeconds = 0.f;
+  rdbuf(&buffer);
+
+  struct stat info;
+  if(stat(filename.c_str(), &info) != 0){
+    cout << "Could not open " << filename << endl;
+    failed = true;
+    setstate(std::ios::failbit);
+    return;
+  }
+  compressedBytes = info.st_size;
+
+  worker = std::thread([this, filename](){
+    using namespace std::chrono;
+    Trace::setThreadName("decompress");
+    TRACE_ZONE("decompress");
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    if(endsWith(filename, ".zst"))
+      decompressZstd(filename);
+    else
+      decompressGzip(filename);
+    decompressSeconds = duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+    queue.close();
+  });
+}
+
+DecompressStream::~DecompressStream(){
+  //Stop early if the reader gave up before the end of the file
+  cancelled = true;
+  queue.close();
+  if(worker.joinable())
+    worker.join();
+}
+
+void DecompressStream::decompressGzip(std::string filename){
+  gzFile file = gzopen(filename.c_str(), "rb");
+  if(!file){
+    cout << "Could not open " << filename << endl;
+    failed = true;
+    return;
+  }
+  gzbuffer(file, 1 << 17);
+  while(!cancelled){
+    Block block(blockSize);
+    int read = gzread(file, block.data(), block.size());
+    if(read < 0){
+      int error;
+      cout << "Could not decompress " << filename << ": " << gzerror(file, &error) << endl;
+      failed = true;
+      break;
+    }
+    if(read == 0)
+      break;
+    block.resize(read);
+    bytes += read;
+    queue.push(std::move(block));
+  }
+  gzclose(file);
+}
+
+void DecompressStream::decompressZstd(std::string filename){
+#ifdef ZSTD
+  FILE* file = fopen(filename.c_str(), "rb");
+  if(!file){
+    cout << "Could not open " << filename << endl;
+    failed = true;
+    return;
+  }
+  ZSTD_DStream* stream = ZSTD_createDStream();
+  ZSTD_initDStream(stream);
+  vector<char> in(ZSTD_DStreamInSize());
+  Block block(blockSize);
+  size_t filled = 0;
+  size_t read;
+  while(!cancelled && !failed && (read = fread(in.data(), 1, in.size(), file)) > 0){
+    ZSTD_inBuffer input = {in.data(), read, 0};
+    while(input.pos < input.size){
+      ZSTD_outBuffer output = {block.data()+filled, blockSize-filled, 0};
+      size_t result = ZSTD_decompressStream(stream, &output, &input);
+      if(ZSTD_isError(result)){
+        cout << "Could not decompress " << filename << ": " << ZSTD_getErrorName(result) << endl;
+        failed = true;
+        break;
+      }
+      filled += output.pos;
+      if(filled == blockSize){
+        bytes += filled;
+        queue.push(std::move(block));
+        block = Block(blockSize);
+        filled = 0;
+      }
+    }
+  }
+  if(filled > 0 && !failed){
+    block.resize(filled);
+    bytes += filled;
+    queue.push(std::move(block));
+  }
+  ZSTD_freeDStream(stream);
+  fclose(file);
+#else
+  cout << "Cannot read " << filename << ": built without zstd (make ZSTD=1)" << endl;
+  failed = true;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Whether a file name asks for decompression (.gz or .zst)
+bool DecompressStream::isCompressed(std::string filename){
+  return endsWith(filename, ".gz") || endsWith(filename, ".zst");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief File name without its compression suffix
+std::string DecompressStream::uncompressedName(std::string filename){
+  if(endsWith(filename, ".gz"))
+    return filename.substr(0, filename.size()-3);
+  if(endsWith(filename, ".zst"))
+    return filename.substr(0, filename.size()-4);
+  return filename;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Wait for the decompressing thread once the stream has been read
+void DecompressStream::finish(){
+  if(worker.joinable())
+    worker.join();
+}
+
+bool DecompressStream::hasFailed(){return failed;};
+size_t DecompressStream::getCompressedBytes(){return compressedBytes;};
+size_t DecompressStream::getBytes(){return bytes;};
+float DecompressStream::getDecompressSeconds(){return decompressSeconds;};
+float DecompressStream::getWaitSeconds(){return buffer.waitSeconds;};
@@ -0,0 +1,60 @@
+// STL
+#ifndef DECOMPRESSSTREAM_H
+#define DECOMPRESSSTREAM_H
+
+#include <atomic>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include "BoundedQueue.h"
+#include "Memory.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Input stream over a gzip or zstd compressed file
+///
+/// A thread of its own decompresses the file into fixed size blocks and hands
+/// them to the reader through a bounded queue, so decompressing and parsing
+/// overlap and at most a few blocks are held in memory. zstd needs a build
+/// with ZSTD defined (make ZSTD=1).
+class DecompressStream : public std::istream{
+
+public:
+  typedef TrackedVector<char, MEMORY_PARSE> Block;
+
+private:
+  class BlockBuffer : public std::streambuf{
+  public:
+    BoundedQueue<Block>* queue;
+    Block current;
+    float waitSeconds;
+    int_type underflow();
+  };
+
+  BoundedQueue<Block> queue;
+  BlockBuffer buffer;
+  std::thread worker;
+  std::atomic<bool> cancelled;
+  std::atomic<bool> failed;
+  size_t blockSize;
+  size_t compressedBytes;
+  size_t bytes;
+  float decompressSeconds;
+
+  void decompressGzip(std::string filename);
+  void decompressZstd(std::string filename);
+
+public:
+  DecompressStream(std::string filename, size_t block = 1 << 16, size_t blocks = 8);
+  ~DecompressStream();
+  static bool isCompressed(std::string filename);
+  static std::string uncompressedName(std::string filename);
+  void finish();
+  bool hasFailed();
+  size_t getCompressedBytes();
+  size_t getBytes();
+  float getDecompressSeconds();
+  float getWaitSeconds();
+
+};
+#endif
@@ -0,0 +1,197 @@
+#include "DrawKernels.h"
+using namespace std;
+
+// GL
+#if   defined(OSX)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#include <OpenGL/gl.h>
+#elif defined(LINUX)
+#include <GL/gl.h>
+#endif
+
+namespace {
+
+  //Sends the normal of a triangle, as the fixed function light wants it
+  template <bool FileNormals>
+  inline void sendNormal(Face& face, Vertex p[3]){
+    if(FileNormals){
+      Normal n = face.getNormal();
+      glNormal3f(n.getX(), n.getY(), n.getZ());
+    }
+    else{
+      float u[3] = {p[1].getX()-p[0].getX(), p[1].getY()-p[0].getY(), p[1].getZ()-p[0].getZ()};
+      float w[3] = {p[2].getX()-p[0].getX(), p[2].getY()-p[0].getY(), p[2].getZ()-p[0].getZ()};
+      glNormal3f(u[1]*w[2]-u[2]*w[1], u[2]*w[0]-u[0]*w[2], u[0]*w[1]-u[1]*w[0]);
+    }
+  }
+
+  //Triangles and quad halves of the listed meshlets
+  template <bool FileNormals, bool Textured, DrawPrimitive Primitive, bool Lit>
+  struct Kernel{
+    static void draw(const DrawSpan& span){
+      FaceList& faces = span.geometry->mesh.faces;
+      Meshlets& meshlets = span.geometry->meshlets;
+      glBegin(GL_TRIANGLES);
+      for(int c=0; c<span.clusterCount; c++){
+        Meshlet& cluster = meshlets.getMeshlet(span.clusters[c]);
+        for(int t=cluster.firstTriangle; t<cluster.firstTriangle+cluster.triangleCount; t++){
+          Face& face = faces[meshlets.getFace(t)];
+          //Only quads have a second half to look up
+          int half = Primitive == DRAW_QUADS ? meshlets.getHalf(t) : 0;
+          Vertex p[3];
+          Meshlets::corners(face, half, p);
+          if(Lit)
+            sendNormal<FileNormals>(face, p);
+          if(Textured){
+            Texture uv[3] = {face.getT1(), half ? face.getT3() : face.getT2(),
+                             half ? face.getT4() : face.getT3()};
+            for(int k=0; k<3; k++){
+              glTexCoord2f(uv[k].getX(), uv[k].getY());
+              glVertex3f(p[k].getX(), p[k].getY(), p[k].getZ());
+            }
+          }
+          else
+            for(int k=0; k<3; k++)
+              glVertex3f(p[k].getX(), p[k].getY(), p[k].getZ());
+        }
+      }
+      glEnd();
+    }
+  };
+
+  template <bool FileNormals, bool Textured, bool Lit>
+  struct Kernel<FileNormals, Textured, DRAW_LINES, Lit>{
+    static void draw(const DrawSpan& span){
+      Topology& topology = span.geometry->topology;
+      Topology::EdgeList& edges = span.featureEdgesOnly ? topology.getFeatureEdges() : topology.getEdges();
+      glEnableClientState(GL_VERTEX_ARRAY);
+      glVertexPointer(3, GL_FLOAT, 0, topology.getPoints().data());
+      glDrawElements(GL_LINES, edges.size(), GL_UNSIGNED_INT, edges.data());
+      glDisableClientState(GL_VERTEX_ARRAY);
+    }
+  };
+
+  template <bool FileNormals, bool Textured, bool Lit>
+  struct Kernel<FileNormals, Textured, DRAW_POINTS, Lit>{
+    static void draw(const DrawSpan& span){
+      Topology& topology = span.geometry->topology;
+      glEnableClientState(GL_VERTEX_ARRAY);
+      glVertexPointer(3, GL_FLOAT, 0, topology.getPoints().data());
+      glDrawArrays(GL_POINTS, 0, topology.getPointCount());
+      glDisableClientState(GL_VERTEX_ARRAY);
+    }
+  };
+
+  template <bool FileNormals, bool Textured, DrawPrimitive Primitive, bool Lit>
+  void drawKernel(const DrawSpan& span){
+    Kernel<FileNormals, Textured, Primitive, Lit>::draw(span);
+  }
+
+  //Turns the runtime choices into template arguments, one at a time
+  template <DrawPrimitive Primitive, bool FileNormals, bool Textured>
+  DrawKernel withLighting(bool lit){
+    return lit ? drawKernel<FileNormals, Textured, Primitive, true> :
+                 drawKernel<FileNormals, Textured, Primitive, false>;
+  }
+
+  template <DrawPrimitive Primitive, bool FileNormals>
+  DrawKernel withTexture(bool textured, bool lit){
+    return textured ? withLighting<Primitive, FileNormals, true>(lit) :
+                      withLighting<Primitive, FileNormals, false>(lit);
+  }
+
+  template <DrawPrimitive Primitive>
+  DrawKernel withNormals(bool fileNormals, bool textured, bool lit){
+    return fileNormals ? withTexture<Primitive, true>(textured, lit) :
+                         withTexture<Primitive, false>(textured, lit);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief The kernel for one configuration
+/// @param fileNormals Send the face normals from the file rather than computed ones
+/// @param textured Send texture coordinates
+/// @param primitive What to draw
+/// @param lit Send normals at all; leave it false with lighting off
+DrawKernel DrawKernels::select(bool fileNormals, bool textured, DrawPrimitive primitive, bool lit){
+  switch(primitive){
+    //Unlit kernels send no normals, so they come in one kind only
+    case DRAW_TRIANGLES:
+      return withNormals<DRAW_TRIANGLES>(fileNormals && lit, textured, lit);
+    case DRAW_QUADS:
+      return withNormals<DRAW_QUADS>(fileNormals && lit, textured, lit);
+    case DRAW_LINES:
+      return drawKernel<false, false, DRAW_LINES, false>;
+    default:
+      return drawKernel<false, false, DRAW_POINTS, false>;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief The kernel a model is drawn with in a render mode
+/// @param fileNormals Whether the model has normals from its file
+/// @param textured Whether the model has texture coordinates
+/// @param quads Whether any face of the model is a quad
+/// @param mode Render mode; only solid models are lit
+DrawKernel DrawKernels::forMode(bool fileNormals, bool textured, bool quads, RenderMode mode){
+  if(mode == RENDER_WIRE)
+    return select(false, false, DRAW_LINES, false);
+  if(mode == RENDER_POINTS)
+    return select(false, false, DRAW_POINTS, false);
+  return select(fileNormals, textured, quads ? DRAW_QUADS : DRAW_TRIANGLES, true);
+}
+
+std::string DrawKernels::name(bool fileNormals, bool textured, DrawPrimitive primitive, bool lit){
+  if(primitive == DRAW_LINES)
+    return "lines";
+  if(primitive == DRAW_POINTS)
+    return "points";
+  std::string text = primitive == DRAW_QUADS ? "quads" : "triangles";
+  if(lit)
+    text += fileNormals ? ", file normals" : ", computed normals";
+  text += textured ? ", textured" : ", untextured";
+  return text + (lit ? ", lit" : ", unlit");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draws listed meshlets with one loop for every configuration
+/// @param span Meshlets to draw
+/// @param fileNormals Send the face normals from the file rather than computed ones
+///
+/// Tests for file normals at every triangle and looks up the half of every
+/// face, and always sends texture coordinates and normals. The kernels are
+/// measured against it.
+void DrawKernels::drawGeneric(const DrawSpan& span, bool fileNormals){
+  FaceList& faces = span.geometry->mesh.faces;
+  Meshlets& meshlets = span.geometry->meshlets;
+  glBegin(GL_TRIANGLES);
+  for(int c=0; c<span.clusterCount; c++){
+    Meshlet& cluster = meshlets.getMeshlet(span.clusters[c]);
+    for(int t=cluster.firstTriangle; t<cluster.firstTriangle+cluster.triangleCount; t++){
+      Face& face = faces[meshlets.getFace(t)];
+      int half = meshlets.getHalf(t);
+      if(!fileNormals){
+        Vertex a=face.getV1(), b=face.getV2(), c=face.getV3();
+        float u[3] = {b.getX()-a.getX(), b.getY()-a.getY(), b.getZ()-a.getZ()};
+        float w[3] = {c.getX()-a.getX(), c.getY()-a.getY(), c.getZ()-a.getZ()};
+        glNormal3f(u[1]*w[2]-u[2]*w[1], u[2]*w[0]-u[0]*w[2], u[0]*w[1]-u[1]*w[0]);
+      }
+      else
+        glNormal3f(face.getNormal().getX(), face.getNormal().getY(), face.getNormal().getZ());
+
+      Vertex p[3];
+      Texture uv[3] = {face.getT1(), half ? face.getT3() : face.getT2(), half ? face.getT4() : face.getT3()};
+      Meshlets::corners(face, half, p);
+      for(int k=0; k<3; k++){
+        glTexCoord2f(uv[k].getX(), uv[k].getY());
+        glVertex3f(p[k].getX(), p[k].getY(), p[k].getZ());
+      }
+    }
+  }
+  glEnd();
+}
+
+#if   defined(OSX)
+#pragma clang diagnostic pop
+#endif
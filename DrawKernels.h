@@ -0,0 +1,51 @@
+// STL
+#ifndef DRAWKERNELS_H
+#define DRAWKERNELS_H
+
+#include <string>
+#include "MeshStore.h"
+#include "ShaderRenderer.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief What a fixed function kernel submits
+enum DrawPrimitive{
+  DRAW_TRIANGLES,
+  DRAW_QUADS,
+  DRAW_LINES,
+  DRAW_POINTS
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief One call's worth of drawing
+///
+/// Triangle and quad kernels draw the listed meshlets; line and point kernels
+/// draw the unique edges or points of the whole topology and ignore them.
+struct DrawSpan{
+  Geometry* geometry;
+  const int* clusters;
+  int clusterCount;
+  bool featureEdgesOnly;
+};
+
+typedef void (*DrawKernel)(const DrawSpan& span);
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Fixed function draw loops specialized at compile time
+///
+/// There is one kernel for each combination of face normals (from the file or
+/// computed from the corners), texture coordinates (sent or not), primitive
+/// and lighting (normals sent or not), so the per triangle loop tests none of
+/// them. Triangle kernels are only for models without quads; quad kernels
+/// draw both halves of each quad and any triangles between them. Lines and
+/// points are drawn from client arrays and have no variants. select is meant
+/// to be called once per model and mode, at load time.
+class DrawKernels{
+
+public:
+  static DrawKernel select(bool fileNormals, bool textured, DrawPrimitive primitive, bool lit);
+  static DrawKernel forMode(bool fileNormals, bool textured, bool quads, RenderMode mode);
+  static std::string name(bool fileNormals, bool textured, DrawPrimitive primitive, bool lit);
+  static void drawGeneric(const DrawSpan& span, bool fileNormals);
+
+};
+#endif
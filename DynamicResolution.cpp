@@ -0,0 +1,88 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+const float DynamicResolution::MIN_SCALE = 0.25f;
+const float DynamicResolution::HEADROOM = 0.85f;
+
+namespace {
+
+  //Largest change of scale from one frame to the next, down and up
+  const float MAX_DROP = 0.8f;
+  const float MAX_RISE = 1.05f;
+
+  //Weight of a new frame time in the smoothed one
+  const float SMOOTHING = 0.25f;
+}
+
+DynamicResolution::DynamicResolution(){
+  budget=1.f/60.f;
+  reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Frame time to stay within
+/// @param seconds Budget of one frame
+void DynamicResolution::setBudget(float seconds){
+  budget = seconds;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Back to full resolution, forgetting the history
+void DynamicResolution::reset(){
+  scale=1.f;
+  smoothed=0.f;
+  history.clear();
+  frames=0;
+  overBudgetFrames=0;
+  overBudgetSeconds=0.f;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Account for a frame drawn at the current scale and pick the next one
+/// @param frameSeconds Time the frame took
+void DynamicResolution::update(float frameSeconds){
+  frames++;
+  history.push_back(scale);
+  if(history.size() > size_t(HISTORY))
+    history.pop_front();
+  if(frameSeconds > budget){
+    overBudgetFrames++;
+    overBudgetSeconds += frameSeconds-budget;
+  }
+
+  smoothed = frames == 1 ? frameSeconds : smoothed + SMOOTHING*(frameSeconds-smoothed);
+  if(smoothed <= 0.f)
+    return;
+  float change = std::sqrt(HEADROOM*budget/smoothed);
+  change = std::min(MAX_RISE, std::max(MAX_DROP, change));
+  scale = std::min(1.f, std::max(MIN_SCALE, scale*change));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Size in pixels to render at for a full size
+int DynamicResolution::scaled(int size){
+  return std::max(1, int(size*scale + 0.5f));
+}
+
+float DynamicResolution::getScale(){return scale;};
+float DynamicResolution::getBudget(){return budget;};
+const std::deque<float>& DynamicResolution::getHistory(){return history;};
+
+float DynamicResolution::getMinScale(){
+  return history.empty() ? scale : *std::min_element(history.begin(), history.end());
+}
+
+float DynamicResolution::getMeanScale(){
+  if(history.empty())
+    return scale;
+  float total = 0.f;
+  for(size_t i=0; i<history.size(); i++)
+    total += history[i];
+  return total/history.size();
+}
+
+int DynamicResolution::getFrames(){return frames;};
+int DynamicResolution::getOverBudgetFrames(){return overBudgetFrames;};
+float DynamicResolution::getOverBudgetSeconds(){return overBudgetSeconds;};
@@ -0,0 +1,47 @@
+// STL
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <deque>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Picks the render scale of each frame from the frame times measured
+///
+/// Frame cost is taken to grow with the number of pixels, so the scale moves
+/// by the square root of how far a smoothed frame time is from the target,
+/// a little under the budget. It drops quickly when frames run long and
+/// climbs back slowly, so it does not oscillate. The scales of the last
+/// HISTORY frames and the time spent over budget are kept for the stats.
+class DynamicResolution{
+
+public:
+  static const float MIN_SCALE;
+  static const float HEADROOM;
+  static const int HISTORY = 120;
+
+private:
+  float budget;
+  float scale;
+  float smoothed;
+  std::deque<float> history;
+  int frames;
+  int overBudgetFrames;
+  float overBudgetSeconds;
+
+public:
+  DynamicResolution();
+  void setBudget(float seconds);
+  void reset();
+  void update(float frameSeconds);
+  int scaled(int size);
+  float getScale();
+  float getBudget();
+  const std::deque<float>& getHistory();
+  float getMinScale();
+  float getMeanScale();
+  int getFrames();
+  int getOverBudgetFrames();
+  float getOverBudgetSeconds();
+
+};
+#endif
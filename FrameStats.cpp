@@ -0,0 +1,53 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+using namespace std;
+
+void FrameStats::add(float seconds){times.push_back(seconds);};
+void FrameStats::clear(){times.clear();};
+int FrameStats::getCount(){return times.size();};
+
+float FrameStats::getMean(){
+  if(times.empty())
+    return 0.f;
+  double total=0.0;
+  for(size_t i=0; i<times.size(); i++)
+    total += times[i];
+  return float(total/times.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Frame time below which p percent of frames fall
+/// @param p Percentile, 0 to 100
+float FrameStats::getPercentile(float p){
+  if(times.empty())
+    return 0.f;
+  vector<float> sorted(times);
+  size_t rank = size_t(std::ceil(p/100.f*sorted.size()));
+  size_t i = std::min(sorted.size()-1, rank > 0 ? rank-1 : 0);
+  std::nth_element(sorted.begin(), sorted.begin()+i, sorted.end());
+  return sorted[i];
+}
+
+float FrameStats::getMax(){
+  return times.empty() ? 0.f : *std::max_element(times.begin(), times.end());
+}
+
+void FrameStats::printSummary(std::string title){
+  printf("%s: %d frames\n", title.c_str(), getCount());
+  printf("  mean %.3f ms  median %.3f ms  p95 %.3f ms  p99 %.3f ms  max %.3f ms\n",
+         1000.f*getMean(), 1000.f*getPercentile(50.f), 1000.f*getPercentile(95.f),
+         1000.f*getPercentile(99.f), 1000.f*getMax());
+}
+
+std::string FrameStats::toJson(){
+  ostringstream out;
+  out << "{\"frames\": " << getCount() << ", \"meanMs\": " << 1000.f*getMean()
+      << ", \"medianMs\": " << 1000.f*getPercentile(50.f)
+      << ", \"p95Ms\": " << 1000.f*getPercentile(95.f)
+      << ", \"p99Ms\": " << 1000.f*getPercentile(99.f)
+      << ", \"maxMs\": " << 1000.f*getMax() << "}";
+  return out.str();
+}
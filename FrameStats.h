@@ -0,0 +1,27 @@
+// STL
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Collects frame times and summarizes them
+class FrameStats{
+
+private:
+  std::vector<float> times;
+
+public:
+  FrameStats(){};
+  void add(float seconds);
+  void clear();
+  int getCount();
+  float getMean();
+  float getPercentile(float p);
+  float getMax();
+  void printSummary(std::string title);
+  std::string toJson();
+
+};
+#endif
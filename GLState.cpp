@@ -0,0 +1,134 @@
+#include "GLState.h"
+using namespace std;
+
+// GL
+#if   defined(OSX)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#include <OpenGL/gl.h>
+#elif defined(LINUX)
+#include <GL/gl.h>
+#endif
+
+GLState::GLState(){
+  issued=0;
+  elided=0;
+  frameIssued=0;
+  frameElided=0;
+  invalidate();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Forget everything, so the next call of each kind is issued
+void GLState::invalidate(){
+  capabilities.clear();
+  lights.clear();
+  polygonMode=-1;
+  stippleFactor=-1;
+  stipplePattern=0;
+  depthFunction=-1;
+  knownLineWidth=false;
+  knownPointSize=false;
+  knownClear=false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Start counting a new frame; the getters report the frame before
+void GLState::beginFrame(){
+  frameIssued=issued;
+  frameElided=elided;
+  issued=0;
+  elided=0;
+}
+
+//Counts the call and says whether it has to reach GL
+bool GLState::changed(bool same){
+  if(same){
+    elided++;
+    return false;
+  }
+  issued++;
+  return true;
+}
+
+void GLState::setCapability(unsigned int cap, bool on){
+  map<unsigned int, bool>::iterator it = capabilities.find(cap);
+  if(!changed(it != capabilities.end() && it->second == on))
+    return;
+  if(on)
+    glEnable(cap);
+  else
+    glDisable(cap);
+  capabilities[cap] = on;
+}
+
+void GLState::enable(unsigned int cap){setCapability(cap, true);}
+void GLState::disable(unsigned int cap){setCapability(cap, false);}
+
+void GLState::setPolygonMode(unsigned int mode){
+  if(!changed(polygonMode == int(mode)))
+    return;
+  glPolygonMode(GL_FRONT_AND_BACK, mode);
+  polygonMode = mode;
+}
+
+void GLState::setLineWidth(float width){
+  if(!changed(knownLineWidth && lineWidth == width))
+    return;
+  glLineWidth(width);
+  lineWidth = width;
+  knownLineWidth = true;
+}
+
+void GLState::setPointSize(float size){
+  if(!changed(knownPointSize && pointSize == size))
+    return;
+  glPointSize(size);
+  pointSize = size;
+  knownPointSize = true;
+}
+
+void GLState::setLineStipple(int factor, unsigned short pattern){
+  if(!changed(stippleFactor == factor && stipplePattern == pattern))
+    return;
+  glLineStipple(factor, pattern);
+  stippleFactor = factor;
+  stipplePattern = pattern;
+}
+
+void GLState::setClearColor(float r, float g, float b, float a){
+  if(!changed(knownClear && clear[0] == r && clear[1] == g && clear[2] == b && clear[3] == a))
+    return;
+  glClearColor(r, g, b, a);
+  clear[0] = r;
+  clear[1] = g;
+  clear[2] = b;
+  clear[3] = a;
+  knownClear = true;
+}
+
+void GLState::setDepthFunc(unsigned int func){
+  if(!changed(depthFunction == int(func)))
+    return;
+  glDepthFunc(func);
+  depthFunction = func;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief glLightfv for the four component parameters (position and colours)
+void GLState::setLight(unsigned int light, unsigned int pname, const float values[4]){
+  unsigned int key = (light << 16) ^ pname;
+  array<float, 4> v = {{values[0], values[1], values[2], values[3]}};
+  map<unsigned int, array<float, 4>>::iterator it = lights.find(key);
+  if(!changed(it != lights.end() && it->second == v))
+    return;
+  glLightfv(light, pname, values);
+  lights[key] = v;
+}
+
+int GLState::getIssued(){return frameIssued;};
+int GLState::getElided(){return frameElided;};
+
+#if   defined(OSX)
+#pragma clang diagnostic pop
+#endif
@@ -0,0 +1,56 @@
+// STL
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <array>
+#include <map>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Shadow of the fixed function GL state the draw paths set every frame
+///
+/// Each setter compares against the value last sent and only calls GL when it
+/// differs, counting issued and elided calls. Nothing is known at start, so
+/// the first call of each kind is always issued; call invalidate after code
+/// that changes state behind the cache's back. Light parameters are cached as
+/// given, so light positions must be set under the same modelview each time.
+class GLState{
+
+private:
+  std::map<unsigned int, bool> capabilities;
+  std::map<unsigned int, std::array<float, 4>> lights;
+  int polygonMode;
+  float lineWidth;
+  float pointSize;
+  int stippleFactor;
+  unsigned short stipplePattern;
+  float clear[4];
+  int depthFunction;
+  bool knownLineWidth;
+  bool knownPointSize;
+  bool knownClear;
+  int issued;
+  int elided;
+  int frameIssued;
+  int frameElided;
+
+  void setCapability(unsigned int cap, bool on);
+  bool changed(bool same);
+
+public:
+  GLState();
+  void invalidate();
+  void beginFrame();
+  void enable(unsigned int cap);
+  void disable(unsigned int cap);
+  void setPolygonMode(unsigned int mode);
+  void setLineWidth(float width);
+  void setPointSize(float size);
+  void setLineStipple(int factor, unsigned short pattern);
+  void setClearColor(float r, float g, float b, float a);
+  void setDepthFunc(unsigned int func);
+  void setLight(unsigned int light, unsigned int pname, const float values[4]);
+  int getIssued();
+  int getElided();
+
+};
+#endif
@@ -0,0 +1,378 @@
+#include "Image.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <zlib.h>
+using namespace std;
+
+namespace {
+
+  //Largest image decoded, in pixels; a corrupt header cannot size more
+  const unsigned long long MAX_PIXELS = 1ull << 26;
+
+  unsigned int bigEndian(const unsigned char* p){
+    return (unsigned int)(p[0])<<24 | p[1]<<16 | p[2]<<8 | p[3];
+  }
+
+  int paeth(int a, int b, int c){
+    int p = a+b-c;
+    int pa = abs(p-a), pb = abs(p-b), pc = abs(p-c);
+    if(pa <= pb && pa <= pc)
+      return a;
+    return pb <= pc ? b : c;
+  }
+
+  //Next whitespace separated number of a PNM header, skipping comments
+  bool pnmNumber(const vector<unsigned char>& data, size_t& at, int& value){
+    while(at < data.size() && (isspace(data[at]) || data[at]=='#')){
+      if(data[at]=='#')
+        while(at < data.size() && data[at]!='\n')
+          at++;
+      else
+        at++;
+    }
+    if(at >= data.size() || !isdigit(data[at]))
+      return false;
+    value = 0;
+    while(at < data.size() && isdigit(data[at])){
+      if(value > 100000000)
+        return false;
+      value = 10*value + (data[at++]-'0');
+    }
+    return true;
+  }
+
+  void putBigEndian(vector<unsigned char>& out, unsigned int v){
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+  }
+
+  //Length, type, data and CRC of one PNG chunk
+  void pngChunk(vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size){
+    putBigEndian(out, size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type+4);
+    out.insert(out.end(), data, data+size);
+    putBigEndian(out, crc32(0, &out[start], out.size()-start));
+  }
+}
+
+Image::Image(){
+  width=0;
+  height=0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Decode an image file, choosing the format from its contents
+/// @param filename File to read
+/// @param image Decoded image
+/// @return Whether the file could be read and decoded
+bool Image::load(std::string filename, Image& image){
+  FILE* file = fopen(filename.c_str(), "rb");
+  if(!file){
+    cout << "Could not open " << filename << endl;
+    return false;
+  }
+  vector<unsigned char> data;
+  unsigned char chunk[1 << 16];
+  size_t read;
+  while((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    data.insert(data.end(), chunk, chunk+read);
+  fclose(file);
+
+  bool ok;
+  if(data.size() >= 8 && memcmp(data.data(), "\x89PNG\r\n\x1a\n", 8) == 0)
+    ok = decodePng(data, image);
+  else if(data.size() >= 2 && data[0]=='P' && (data[1]=='5' || data[1]=='6'))
+    ok = decodePnm(data, image);
+  else
+    ok = decodeTga(data, image);
+  if(!ok)
+    cout << "Could not decode " << filename << endl;
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write an image as an 8 bit RGBA PNG
+/// @param filename File to write
+/// @param image Image to write, bottom row first
+/// @return Whether the file could be written
+bool Image::save(std::string filename, Image& image){
+  size_t stride = size_t(image.width)*4;
+  vector<unsigned char> raw((stride+1)*image.height);
+  for(int y=0; y<image.height; y++){
+    //Filter type 0 (none) on every row, top row first
+    raw[y*(stride+1)] = 0;
+    memcpy(&raw[y*(stride+1)+1], &image.pixels[(image.height-1-y)*stride], stride);
+  }
+  uLongf packedSize = compressBound(raw.size());
+  vector<unsigned char> packed(packedSize);
+  if(compress2(packed.data(), &packedSize, raw.data(), raw.size(), Z_BEST_SPEED) != Z_OK)
+    return false;
+
+  vector<unsigned char> header;
+  putBigEndian(header, image.width);
+  putBigEndian(header, image.height);
+  unsigned char format[5] = {8, 6, 0, 0, 0};
+  header.insert(header.end(), format, format+5);
+
+  vector<unsigned char> out(8);
+  memcpy(out.data(), "\x89PNG\r\n\x1a\n", 8);
+  pngChunk(out, "IHDR", header.data(), header.size());
+  pngChunk(out, "IDAT", packed.data(), packedSize);
+  pngChunk(out, "IEND", nullptr, 0);
+
+  FILE* file = fopen(filename.c_str(), "wb");
+  if(!file){
+    cout << "Could not write " << filename << endl;
+    return false;
+  }
+  bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+  fclose(file);
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Decode a PNG file held in memory
+bool Image::decodePng(const std::vector<unsigned char>& data, Image& image){
+  int bitDepth=0, colorType=0, interlace=0;
+  unsigned int w=0, h=0;
+  vector<unsigned char> compressed;
+  unsigned char palette[256][4];
+  for(int i=0; i<256; i++)
+    palette[i][0] = palette[i][1] = palette[i][2] = 0, palette[i][3] = 255;
+
+  size_t at = 8;
+  while(at+8 <= data.size()){
+    unsigned int length = bigEndian(&data[at]);
+    string type(data.begin()+at+4, data.begin()+at+8);
+    if(at+12+length > data.size())
+      return false;
+    const unsigned char* body = &data[at+8];
+    if(type == "IHDR"){
+      if(length < 13)
+        return false;
+      w = bigEndian(body);
+      h = bigEndian(body+4);
+      bitDepth = body[8];
+      colorType = body[9];
+      interlace = body[12];
+    }
+    else if(type == "PLTE")
+      for(unsigned int i=0; i<length/3 && i<256; i++)
+        memcpy(palette[i], body+3*i, 3);
+    else if(type == "tRNS" && colorType == 3)
+      for(unsigned int i=0; i<length && i<256; i++)
+        palette[i][3] = body[i];
+    else if(type == "IDAT")
+      compressed.insert(compressed.end(), body, body+length);
+    else if(type == "IEND")
+      break;
+    at += 12+length;
+  }
+  if(w == 0 || h == 0 || interlace != 0){
+    if(interlace != 0)
+      cout << "Interlaced PNG is not supported" << endl;
+    return false;
+  }
+  //Bit depths the PNG specification allows for each colour type
+  bool validDepth;
+  switch(colorType){
+    case 0: validDepth = bitDepth==1 || bitDepth==2 || bitDepth==4 || bitDepth==8 || bitDepth==16; break;
+    case 3: validDepth = bitDepth==1 || bitDepth==2 || bitDepth==4 || bitDepth==8; break;
+    case 2: case 4: case 6: validDepth = bitDepth==8 || bitDepth==16; break;
+    default: validDepth = false;
+  }
+  if(!validDepth || (unsigned long long)w*h > MAX_PIXELS){
+    cout << "Unsupported PNG: " << w << "x" << h << ", colour type " << colorType
+         << ", bit depth " << bitDepth << endl;
+    return false;
+  }
+
+  int channels = colorType==2 ? 3 : colorType==4 ? 2 : colorType==6 ? 4 : 1;
+  size_t rowBytes = (size_t(w)*channels*bitDepth + 7)/8;
+  size_t pixelBytes = std::max(1, channels*bitDepth/8);
+  vector<unsigned char> raw(size_t(h)*(rowBytes+1));
+  uLongf rawSize = raw.size();
+  if(uncompress(raw.data(), &rawSize, compressed.data(), compressed.size()) != Z_OK || rawSize != raw.size())
+    return false;
+
+  //Undo the per row filters in place; each row refers to the one above
+  for(unsigned int y=0; y<h; y++){
+    unsigned char* row = &raw[y*(rowBytes+1)+1];
+    const unsigned char* up = y ? row-(rowBytes+1) : nullptr;
+    int filter = row[-1];
+    for(size_t x=0; x<rowBytes; x++){
+      int a = x >= pixelBytes ? row[x-pixelBytes] : 0;
+      int b = up ? up[x] : 0;
+      int c = up && x >= pixelBytes ? up[x-pixelBytes] : 0;
+      switch(filter){
+        case 1: row[x] += a; break;
+        case 2: row[x] += b; break;
+        case 3: row[x] += (a+b)/2; break;
+        case 4: row[x] += paeth(a, b, c); break;
+      }
+    }
+  }
+
+  image.width = w;
+  image.height = h;
+  image.pixels.resize(size_t(w)*h*4);
+  for(unsigned int y=0; y<h; y++){
+    const unsigned char* row = &raw[y*(rowBytes+1)+1];
+    unsigned char* out = &image.pixels[size_t(y)*w*4];
+    for(unsigned int x=0; x<w; x++, out+=4){
+      //Sample s of this pixel scaled to 8 bits; 16 bit keeps the high byte
+      int sample[4];
+      for(int s=0; s<channels; s++){
+        if(bitDepth == 16)
+          sample[s] = row[2*(x*channels+s)];
+        else if(bitDepth == 8)
+          sample[s] = row[x*channels+s];
+        else{
+          size_t bit = size_t(x*channels+s)*bitDepth;
+          int value = (row[bit/8] >> (8-bitDepth-bit%8)) & ((1<<bitDepth)-1);
+          sample[s] = colorType==3 ? value : value*255/((1<<bitDepth)-1);
+        }
+      }
+      if(colorType == 3)
+        memcpy(out, palette[sample[0]], 4);
+      else if(channels <= 2){
+        out[0] = out[1] = out[2] = sample[0];
+        out[3] = channels==2 ? sample[1] : 255;
+      }
+      else{
+        out[0] = sample[0];
+        out[1] = sample[1];
+        out[2] = sample[2];
+        out[3] = channels==4 ? sample[3] : 255;
+      }
+    }
+  }
+  image.flip();
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Decode a true colour or grey TGA file, plain or run length encoded
+bool Image::decodeTga(const std::vector<unsigned char>& data, Image& image){
+  if(data.size() < 18)
+    return false;
+  int idLength = data[0];
+  int colorMapType = data[1];
+  int imageType = data[2];
+  int mapLength = data[5] | data[6]<<8;
+  int mapEntryBits = data[7];
+  int w = data[12] | data[13]<<8;
+  int h = data[14] | data[15]<<8;
+  int bits = data[16];
+  bool topFirst = data[17] & 0x20;
+  bool rle = imageType == 10 || imageType == 11;
+  bool grey = imageType == 3 || imageType == 11;
+  if((imageType != 2 && imageType != 3 && !rle) || w == 0 || h == 0 ||
+     (unsigned long long)w*h > MAX_PIXELS)
+    return false;
+  int bytes = bits/8;
+  if(grey ? bytes != 1 : (bytes != 3 && bytes != 4))
+    return false;
+
+  size_t at = 18 + idLength + (colorMapType ? mapLength*((mapEntryBits+7)/8) : 0);
+  image.width = w;
+  image.height = h;
+  image.pixels.resize(size_t(w)*h*4);
+  size_t count = size_t(w)*h;
+  size_t done = 0;
+  while(done < count){
+    //A packet repeats one pixel or copies several; plain images are one copy
+    size_t run = count-done;
+    bool repeat = false;
+    if(rle){
+      if(at >= data.size())
+        return false;
+      repeat = data[at] & 0x80;
+      run = std::min(count-done, size_t(data[at] & 0x7f) + 1);
+      at++;
+    }
+    for(size_t i=0; i<run; i++, done++){
+      if(at+bytes > data.size())
+        return false;
+      const unsigned char* p = &data[at];
+      unsigned char* out = &image.pixels[4*done];
+      out[0] = grey ? p[0] : p[2];
+      out[1] = grey ? p[0] : p[1];
+      out[2] = p[0];
+      out[3] = bytes==4 ? p[3] : 255;
+      if(!repeat || i+1 == run)
+        at += bytes;
+    }
+  }
+  if(topFirst)
+    image.flip();
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Decode a binary PPM (P6) or PGM (P5) file
+bool Image::decodePnm(const std::vector<unsigned char>& data, Image& image){
+  bool grey = data[1]=='5';
+  size_t at = 2;
+  int w, h, maxValue;
+  if(!pnmNumber(data, at, w) || !pnmNumber(data, at, h) || !pnmNumber(data, at, maxValue))
+    return false;
+  at++;
+  int channels = grey ? 1 : 3;
+  int sampleBytes = maxValue > 255 ? 2 : 1;
+  if(w <= 0 || h <= 0 || maxValue <= 0 || (unsigned long long)w*h > MAX_PIXELS ||
+     at + size_t(w)*h*channels*sampleBytes > data.size())
+    return false;
+
+  image.width = w;
+  image.height = h;
+  image.pixels.resize(size_t(w)*h*4);
+  for(size_t i=0; i<size_t(w)*h; i++){
+    unsigned char* out = &image.pixels[4*i];
+    for(int c=0; c<3; c++){
+      size_t s = at + (i*channels + (grey ? 0 : c))*sampleBytes;
+      int value = sampleBytes==2 ? (data[s]<<8 | data[s+1]) : data[s];
+      out[c] = value*255/maxValue;
+    }
+    out[3] = 255;
+  }
+  image.flip();
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Next smaller mip level, averaging blocks of 2x2 pixels
+/// @param out Image half the size, rounded down and at least 1x1
+void Image::halve(Image& out){
+  out.width = std::max(1, width/2);
+  out.height = std::max(1, height/2);
+  out.pixels.resize(size_t(out.width)*out.height*4);
+  for(int y=0; y<out.height; y++){
+    int y0 = std::min(2*y, height-1), y1 = std::min(2*y+1, height-1);
+    for(int x=0; x<out.width; x++){
+      int x0 = std::min(2*x, width-1), x1 = std::min(2*x+1, width-1);
+      for(int c=0; c<4; c++){
+        int sum = pixels[(size_t(y0)*width+x0)*4+c] + pixels[(size_t(y0)*width+x1)*4+c]
+                + pixels[(size_t(y1)*width+x0)*4+c] + pixels[(size_t(y1)*width+x1)*4+c];
+        out.pixels[(size_t(y)*out.width+x)*4+c] = (sum+2)/4;
+      }
+    }
+  }
+}
+
+size_t Image::getBytes(){return pixels.size();};
+
+//Swap rows so the first row is the bottom one
+void Image::flip(){
+  size_t stride = size_t(width)*4;
+  for(int y=0; y<height/2; y++)
+    std::swap_ranges(pixels.begin()+y*stride, pixels.begin()+(y+1)*stride,
+                     pixels.begin()+(height-1-y)*stride);
+}
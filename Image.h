@@ -0,0 +1,35 @@
+// STL
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <string>
+#include <vector>
+#include "Memory.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Decoded RGBA8 image, bottom row first as OpenGL expects
+///
+/// Reads 8 and 16 bit non-interlaced PNG (every colour type), uncompressed and
+/// RLE TGA and binary PPM/PGM, and writes RGBA PNG. Pixel memory is
+/// accounted to MEMORY_TEXTURE.
+class Image{
+
+public:
+  int width;
+  int height;
+  TrackedVector<unsigned char, MEMORY_TEXTURE> pixels;
+
+  Image();
+  static bool load(std::string filename, Image& image);
+  static bool save(std::string filename, Image& image);
+  void halve(Image& out);
+  size_t getBytes();
+
+private:
+  static bool decodePng(const std::vector<unsigned char>& data, Image& image);
+  static bool decodeTga(const std::vector<unsigned char>& data, Image& image);
+  static bool decodePnm(const std::vector<unsigned char>& data, Image& image);
+  void flip();
+
+};
+#endif
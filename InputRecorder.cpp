@@ -0,0 +1,77 @@
+#include "InputRecorder.h"
+#include <iostream>
+#include <sstream>
+using namespace std;
+
+InputRecorder::InputRecorder(){
+  next=0;
+  recording=false;
+  replaying=false;
+}
+
+bool InputRecorder::startRecording(std::string filename){
+  out.open(filename.c_str());
+  if(!out.is_open()){
+    cout << "Could not record to " << filename << endl;
+    return false;
+  }
+  out << "# spiderling input recording: frame time_ms type code [menu]" << endl;
+  recording=true;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Append an event to the recording
+/// @param frame Frame the event arrived in
+/// @param time Milliseconds since the application started
+/// @param type key, special or menu
+/// @param code Key code or menu choice
+/// @param menu Name of the menu for menu events
+void InputRecorder::record(int frame, float time, std::string type, int code, std::string menu){
+  if(!recording)
+    return;
+  out << frame << " " << time << " " << type << " " << code;
+  if(!menu.empty())
+    out << " " << menu;
+  out << endl;
+}
+
+bool InputRecorder::startReplay(std::string filename){
+  ifstream in(filename.c_str());
+  if(!in.is_open()){
+    cout << "Could not replay " << filename << endl;
+    return false;
+  }
+  string line;
+  while(getline(in, line)){
+    if(line.empty() || line[0]=='#')
+      continue;
+    istringstream fields(line);
+    InputEvent event;
+    if(fields >> event.frame >> event.time >> event.type >> event.code){
+      fields >> event.menu;
+      events.push_back(event);
+    }
+  }
+  cout << "Replaying " << events.size() << " events from " << filename << endl;
+  next=0;
+  replaying=true;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Next event due at or before a frame
+/// @return Whether there was one; call until false each frame
+bool InputRecorder::nextEvent(int frame, InputEvent& event){
+  if(!replaying || next >= events.size() || events[next].frame > frame)
+    return false;
+  event = events[next++];
+  return true;
+}
+
+bool InputRecorder::isRecording(){return recording;};
+bool InputRecorder::isReplaying(){return replaying;};
+
+int InputRecorder::getLastFrame(){
+  return events.empty() ? 0 : events.back().frame;
+}
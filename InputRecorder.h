@@ -0,0 +1,45 @@
+// STL
+#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief One recorded key, special key or menu choice
+struct InputEvent{
+  int frame;
+  float time;
+  std::string type;
+  int code;
+  std::string menu;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Records input to a file and plays it back frame by frame
+///
+/// Events are keyed by the frame they arrived in, so a replay applies them at
+/// the same point of the sequence however fast frames are drawn. Each line of
+/// the file is "frame time_ms type code [menu]".
+class InputRecorder{
+
+private:
+  std::ofstream out;
+  std::vector<InputEvent> events;
+  size_t next;
+  bool recording;
+  bool replaying;
+
+public:
+  InputRecorder();
+  bool startRecording(std::string filename);
+  void record(int frame, float time, std::string type, int code, std::string menu);
+  bool startReplay(std::string filename);
+  bool nextEvent(int frame, InputEvent& event);
+  bool isRecording();
+  bool isReplaying();
+  int getLastFrame();
+
+};
+#endif
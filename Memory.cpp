@@ -0,0 +1,118 @@
+#include "Memory.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+using namespace std;
+
+namespace {
+
+  class MallocAllocator : public Allocator{
+  public:
+    void* allocate(size_t bytes){return malloc(bytes);}
+    void deallocate(void* pointer, size_t){free(pointer);}
+  };
+
+  MallocAllocator defaultAllocator;
+  atomic<Allocator*> hook{&defaultAllocator};
+
+  atomic<size_t> current[MEMORY_SUBSYSTEMS];
+  atomic<size_t> peak[MEMORY_SUBSYSTEMS];
+  atomic<size_t> allocations[MEMORY_SUBSYSTEMS];
+  atomic<size_t> totalPeak{0};
+
+  const char* names[MEMORY_SUBSYSTEMS] = {"parse", "mesh", "gpu", "cache", "texture"};
+
+  void raise(atomic<size_t>& value, size_t candidate){
+    size_t seen = value.load();
+    while(candidate > seen && !value.compare_exchange_weak(seen, candidate));
+  }
+
+  void add(int subsystem, size_t bytes){
+    size_t now = current[subsystem] += bytes;
+    raise(peak[subsystem], now);
+    raise(totalPeak, MemoryTracker::getTotalCurrent());
+  }
+}
+
+void* MemoryTracker::allocate(int subsystem, size_t bytes){
+  void* pointer = hook.load()->allocate(bytes);
+  if(!pointer)
+    throw std::bad_alloc();
+  allocations[subsystem]++;
+  add(subsystem, bytes);
+  return pointer;
+}
+
+void MemoryTracker::deallocate(int subsystem, void* pointer, size_t bytes){
+  current[subsystem] -= bytes;
+  hook.load()->deallocate(pointer, bytes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Account memory the tracker did not allocate itself
+void MemoryTracker::record(int subsystem, size_t bytes){
+  add(subsystem, bytes);
+}
+
+void MemoryTracker::release(int subsystem, size_t bytes){
+  current[subsystem] -= bytes;
+}
+
+void MemoryTracker::setAllocator(Allocator* allocator){
+  hook = allocator ? allocator : &defaultAllocator;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Start a new peak measurement, e.g. before loading a model
+void MemoryTracker::resetPeak(){
+  for(int s=0; s<MEMORY_SUBSYSTEMS; s++)
+    peak[s] = current[s].load();
+  totalPeak = getTotalCurrent();
+}
+
+size_t MemoryTracker::getCurrent(int subsystem){return current[subsystem];};
+size_t MemoryTracker::getPeak(int subsystem){return peak[subsystem];};
+size_t MemoryTracker::getAllocations(int subsystem){return allocations[subsystem];};
+size_t MemoryTracker::getTotalPeak(){return totalPeak;};
+const char* MemoryTracker::getName(int subsystem){return names[subsystem];};
+
+size_t MemoryTracker::getTotalCurrent(){
+  size_t total=0;
+  for(int s=0; s<MEMORY_SUBSYSTEMS; s++)
+    total += current[s];
+  return total;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Counters as a JSON object
+/// @param triangles Triangle count of the loaded model
+/// @param modelBytes Memory that model's geometry holds, for bytes per
+///                   triangle; the totals include every other model loaded
+std::string MemoryTracker::toJson(int triangles, size_t modelBytes){
+  ostringstream out;
+  out << "{";
+  for(int s=0; s<MEMORY_SUBSYSTEMS; s++)
+    out << "\"" << names[s] << "\": {\"current\": " << getCurrent(s)
+        << ", \"peak\": " << getPeak(s) << ", \"allocations\": " << getAllocations(s) << "}, ";
+  out << "\"current\": " << getTotalCurrent() << ", \"peak\": " << getTotalPeak()
+      << ", \"triangles\": " << triangles << ", \"modelBytes\": " << modelBytes
+      << ", \"bytesPerTriangle\": " << (triangles > 0 ? double(modelBytes)/triangles : 0.0) << "}";
+  return out.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Print the counters after a load
+/// @param model Name of the model loaded
+/// @param triangles Its triangle count
+/// @param modelBytes Memory its geometry holds, for bytes per triangle
+void MemoryTracker::printReport(std::string model, int triangles, size_t modelBytes){
+  printf("Memory for %s (%d triangles, %.1f KB, %.1f bytes/triangle)\n", model.c_str(), triangles,
+         modelBytes/1024.0, triangles > 0 ? double(modelBytes)/triangles : 0.0);
+  for(int s=0; s<MEMORY_SUBSYSTEMS; s++)
+    printf("  %-6s %10.1f KB current %10.1f KB peak %8zu allocations\n", names[s],
+           getCurrent(s)/1024.0, getPeak(s)/1024.0, getAllocations(s));
+  printf("  total  %10.1f KB current %10.1f KB peak\n", getTotalCurrent()/1024.0, getTotalPeak()/1024.0);
+}
@@ -0,0 +1,90 @@
+// STL
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parts of the engine memory is accounted to
+enum MemorySubsystem{
+  MEMORY_PARSE,
+  MEMORY_MESH,
+  MEMORY_GPU,
+  MEMORY_CACHE,
+  MEMORY_TEXTURE,
+  MEMORY_SUBSYSTEMS
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Allocation hook; replace with MemoryTracker::setAllocator
+///
+/// Must be installed before anything is allocated through the tracker, since
+/// memory is always returned to the allocator that is current when it is freed.
+class Allocator{
+
+public:
+  virtual ~Allocator(){};
+  virtual void* allocate(size_t bytes) = 0;
+  virtual void deallocate(void* pointer, size_t bytes) = 0;
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Counts bytes and allocations per subsystem
+///
+/// Containers allocate through TrackedAllocator; memory owned elsewhere, such
+/// as GL buffers, is reported with record and release. All counters are atomic
+/// so meshes may be loaded on any thread.
+class MemoryTracker{
+
+public:
+  static void* allocate(int subsystem, size_t bytes);
+  static void deallocate(int subsystem, void* pointer, size_t bytes);
+  static void record(int subsystem, size_t bytes);
+  static void release(int subsystem, size_t bytes);
+
+  static void setAllocator(Allocator* allocator);
+  static void resetPeak();
+  static size_t getCurrent(int subsystem);
+  static size_t getPeak(int subsystem);
+  static size_t getAllocations(int subsystem);
+  static size_t getTotalCurrent();
+  static size_t getTotalPeak();
+  static const char* getName(int subsystem);
+  static std::string toJson(int triangles, size_t modelBytes);
+  static void printReport(std::string model, int triangles, size_t modelBytes);
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief STL allocator accounting to one subsystem
+template <typename T, int Subsystem>
+class TrackedAllocator{
+
+public:
+  typedef T value_type;
+  template <typename U> struct rebind{ typedef TrackedAllocator<U, Subsystem> other; };
+
+  TrackedAllocator(){}
+  template <typename U> TrackedAllocator(const TrackedAllocator<U, Subsystem>&){}
+
+  T* allocate(size_t n){
+    return static_cast<T*>(MemoryTracker::allocate(Subsystem, n*sizeof(T)));
+  }
+  void deallocate(T* pointer, size_t n){
+    MemoryTracker::deallocate(Subsystem, pointer, n*sizeof(T));
+  }
+
+};
+
+template <typename T, typename U, int S>
+bool operator==(const TrackedAllocator<T, S>&, const TrackedAllocator<U, S>&){return true;}
+template <typename T, typename U, int S>
+bool operator!=(const TrackedAllocator<T, S>&, const TrackedAllocator<U, S>&){return false;}
+
+template <typename T, int Subsystem>
+using TrackedVector = std::vector<T, TrackedAllocator<T, Subsystem>>;
+
+#endif
@@ -0,0 +1,34 @@
+#include "Mesh.h"
+using namespace std;
+
+bool Mesh::hasNormals(){return !normals.empty();};
+bool Mesh::hasTextures(){return !textures.empty();};
+
+int Mesh::getTriangleCount(){
+  int count=0;
+  for(size_t i=0; i<faces.size(); i++)
+    count += faces[i].isTriangle() ? 1 : 2;
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Index of the material a face is drawn with, or -1 for none
+int Mesh::materialOfFace(int face){
+  int material = -1;
+  for(size_t i=0; i<materialFirstFace.size() && materialFirstFace[i]<=face; i++)
+    material = materialIndex[i];
+  return material;
+}
+
+void Mesh::clear(){
+  vertices.clear();
+  normals.clear();
+  textures.clear();
+  faces.clear();
+  objectNames.clear();
+  objectFirstFace.clear();
+  materialLibraries.clear();
+  materials.clear();
+  materialFirstFace.clear();
+  materialIndex.clear();
+}
@@ -0,0 +1,57 @@
+// STL
+#ifndef MESH_H
+#define MESH_H
+
+#include <string>
+#include <vector>
+#include "Vertex.h"
+#include "Normal.h"
+#include "Texture.h"
+#include "Face.h"
+#include "Memory.h"
+
+//Mesh arrays account their memory to the CPU mesh
+typedef TrackedVector<Vertex, MEMORY_MESH> VertexList;
+typedef TrackedVector<Normal, MEMORY_MESH> NormalList;
+typedef TrackedVector<Texture, MEMORY_MESH> TextureList;
+typedef TrackedVector<Face, MEMORY_MESH> FaceList;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Material from an MTL library or a usemtl statement
+///
+/// diffuseMap is the path of the image to texture with, relative to the
+/// working directory, or empty for an untextured material.
+struct Material{
+  std::string name;
+  float diffuse[3];
+  std::string diffuseMap;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Everything parsed from one model file
+///
+/// Holds no global state, so separate meshes can be loaded and processed on
+/// separate threads.
+class Mesh{
+
+public:
+  Mesh(){};
+  VertexList vertices;
+  NormalList normals;
+  TextureList textures;
+  FaceList faces;
+  std::vector<std::string> objectNames;
+  std::vector<int> objectFirstFace;
+  std::vector<std::string> materialLibraries;
+  std::vector<Material> materials;
+  std::vector<int> materialFirstFace;
+  std::vector<int> materialIndex;
+
+  bool hasNormals();
+  bool hasTextures();
+  int getTriangleCount();
+  int materialOfFace(int face);
+  void clear();
+
+};
+#endif
@@ -0,0 +1,283 @@
+#include "MeshCleaner.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+using namespace std;
+
+namespace {
+
+  //Integer cell coordinates of the weld grid
+  struct Cell{
+    int64_t x;
+    int64_t y;
+    int64_t z;
+    bool operator==(const Cell& o) const {return x==o.x && y==o.y && z==o.z;}
+  };
+
+  struct CellHash{
+    size_t operator()(const Cell& c) const {
+      return size_t(c.x*73856093) ^ size_t(c.y*19349663) ^ size_t(c.z*83492791);
+    }
+  };
+
+  //Exact bit pattern of a position, so face corners find their source vertex
+  struct PositionKey{
+    uint32_t x;
+    uint32_t y;
+    uint32_t z;
+    bool operator==(const PositionKey& o) const {return x==o.x && y==o.y && z==o.z;}
+  };
+
+  struct PositionKeyHash{
+    size_t operator()(const PositionKey& k) const {
+      return size_t(k.x)*2654435761u ^ size_t(k.y)*40503u ^ size_t(k.z);
+    }
+  };
+
+  PositionKey keyOf(Vertex p){
+    PositionKey k;
+    float x=p.getX(), y=p.getY(), z=p.getZ();
+    memcpy(&k.x,&x,4);
+    memcpy(&k.y,&y,4);
+    memcpy(&k.z,&z,4);
+    return k;
+  }
+
+  //Sorted corner indices identify a face regardless of winding or start corner
+  struct FaceKey{
+    int i[4];
+    bool operator==(const FaceKey& o) const {
+      return i[0]==o.i[0] && i[1]==o.i[1] && i[2]==o.i[2] && i[3]==o.i[3];
+    }
+  };
+
+  struct FaceKeyHash{
+    size_t operator()(const FaceKey& k) const {
+      size_t h=0;
+      for(int x=0; x<4; x++)
+        h = h*1000003u ^ size_t(k.i[x]);
+      return h;
+    }
+  };
+
+  float triangleArea(Vertex a, Vertex b, Vertex c){
+    float ux=b.getX()-a.getX(), uy=b.getY()-a.getY(), uz=b.getZ()-a.getZ();
+    float vx=c.getX()-a.getX(), vy=c.getY()-a.getY(), vz=c.getZ()-a.getZ();
+    float cx=uy*vz-uz*vy, cy=uz*vx-ux*vz, cz=ux*vy-uy*vx;
+    return 0.5f*std::sqrt(cx*cx+cy*cy+cz*cz);
+  }
+}
+
+MeshCleaner::MeshCleaner(float eps){
+  epsilon = std::max(eps, 1e-7f);
+  verticesBefore=0;
+  verticesAfter=0;
+  trianglesBefore=0;
+  trianglesAfter=0;
+  degenerateFaces=0;
+  duplicateFaces=0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Weld, remove degenerate and duplicate faces, compact vertices
+/// @param vertices Vertex list of the model, rewritten to the referenced set
+/// @param faces Face list of the model, rewritten in place
+void MeshCleaner::clean(VertexList& vertices, FaceList& faces){
+  TRACE_ZONE("weld");
+  verticesBefore = vertices.size();
+  trianglesBefore = 0;
+  for(size_t i=0; i<faces.size(); i++)
+    trianglesBefore += faces[i].isTriangle() ? 1 : 2;
+
+  //Weld: every vertex maps to the first representative within epsilon
+  unordered_map<Cell, vector<int>, CellHash> grid;
+  unordered_map<PositionKey, int, PositionKeyHash> exact;
+  VertexList reps;
+  grid.reserve(vertices.size());
+  exact.reserve(vertices.size());
+
+  float eps2 = epsilon*epsilon;
+  for(size_t i=0; i<vertices.size(); i++){
+    Vertex p = vertices[i];
+    PositionKey key = keyOf(p);
+    if(exact.count(key))
+      continue;
+
+    Cell c{int64_t(std::floor(p.getX()/epsilon)),
+           int64_t(std::floor(p.getY()/epsilon)),
+           int64_t(std::floor(p.getZ()/epsilon))};
+    int found=-1;
+    for(int dx=-1; dx<=1 && found<0; dx++)
+      for(int dy=-1; dy<=1 && found<0; dy++)
+        for(int dz=-1; dz<=1 && found<0; dz++){
+          auto it = grid.find(Cell{c.x+dx, c.y+dy, c.z+dz});
+          if(it == grid.end())
+            continue;
+          for(int r : it->second){
+            float ex=reps[r].getX()-p.getX();
+            float ey=reps[r].getY()-p.getY();
+            float ez=reps[r].getZ()-p.getZ();
+            if(ex*ex+ey*ey+ez*ez <= eps2){
+              found=r;
+              break;
+            }
+          }
+        }
+
+    if(found<0){
+      found = reps.size();
+      reps.push_back(p);
+      grid[c].push_back(found);
+    }
+    exact[key]=found;
+  }
+
+  //Faces: snap corners, drop collapsed, zero-area and repeated faces
+  auto repOf = [&](Vertex p){
+    auto it = exact.find(keyOf(p));
+    if(it != exact.end())
+      return it->second;
+    //Corner not in the vertex list; keep it as its own representative
+    int r = reps.size();
+    reps.push_back(p);
+    exact[keyOf(p)] = r;
+    return r;
+  };
+
+  float minArea = eps2*1e-3f;
+  degenerateFaces=0;
+  duplicateFaces=0;
+  unordered_set<FaceKey, FaceKeyHash> seen;
+  vector<int> used(reps.size(), 0);
+  FaceList kept;
+  kept.reserve(faces.size());
+  keptBefore.assign(faces.size()+1, 0);
+
+  for(size_t i=0; i<faces.size(); i++){
+    keptBefore[i] = kept.size();
+    Face f = faces[i];
+    int idx[4];
+    Texture tex[4] = {f.getT1(), f.getT2(), f.getT3(), f.getT4()};
+    int corners = f.isTriangle() ? 3 : 4;
+    idx[0]=repOf(f.getV1());
+    idx[1]=repOf(f.getV2());
+    idx[2]=repOf(f.getV3());
+    idx[3]= corners==4 ? repOf(f.getV4()) : -1;
+
+    //Remove corners welded onto their neighbour (a quad may become a triangle)
+    int unique[4];
+    Texture uniqueTex[4];
+    int n=0;
+    for(int x=0; x<corners; x++){
+      if(n>0 && unique[n-1]==idx[x])
+        continue;
+      unique[n]=idx[x];
+      uniqueTex[n]=tex[x];
+      n++;
+    }
+    if(n>1 && unique[n-1]==unique[0])
+      n--;
+
+    if(n<3){
+      degenerateFaces++;
+      continue;
+    }
+    if(n==4 && (unique[0]==unique[2] || unique[1]==unique[3])){
+      degenerateFaces++;
+      continue;
+    }
+
+    float area = triangleArea(reps[unique[0]], reps[unique[1]], reps[unique[2]]);
+    if(n==4)
+      area += triangleArea(reps[unique[0]], reps[unique[2]], reps[unique[3]]);
+    if(area <= minArea){
+      degenerateFaces++;
+      continue;
+    }
+
+    //Rotated to start at the smallest corner, keeping the winding, so the
+    //back of a two-sided surface is not taken for a copy of its front
+    int start=0;
+    for(int x=1; x<n; x++)
+      if(unique[x] < unique[start])
+        start=x;
+    FaceKey key{{-1, -1, -1, -1}};
+    for(int x=0; x<n; x++)
+      key.i[x] = unique[(start+x)%n];
+    if(!seen.insert(key).second){
+      duplicateFaces++;
+      continue;
+    }
+
+    f.setV1(reps[unique[0]]);
+    f.setV2(reps[unique[1]]);
+    f.setV3(reps[unique[2]]);
+    f.setT1(uniqueTex[0]);
+    f.setT2(uniqueTex[1]);
+    f.setT3(uniqueTex[2]);
+    f.setIsTriangle(n==3);
+    if(n==4){
+      f.setV4(reps[unique[3]]);
+      f.setT4(uniqueTex[3]);
+    }
+    for(int x=0; x<n; x++)
+      used[unique[x]]=1;
+    kept.push_back(f);
+  }
+  keptBefore[faces.size()] = kept.size();
+  faces.swap(kept);
+
+  //Compact: keep only representatives that a surviving face uses
+  VertexList compact;
+  for(size_t r=0; r<reps.size(); r++)
+    if(used[r])
+      compact.push_back(reps[r]);
+  vertices.swap(compact);
+
+  verticesAfter = vertices.size();
+  trianglesAfter = 0;
+  for(size_t i=0; i<faces.size(); i++)
+    trianglesAfter += faces[i].isTriangle() ? 1 : 2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Clean a whole mesh, keeping its object and material ranges in step
+void MeshCleaner::clean(Mesh& mesh){
+  clean(mesh.vertices, mesh.faces);
+  for(size_t i=0; i<mesh.objectFirstFace.size(); i++)
+    mesh.objectFirstFace[i] = remapFace(mesh.objectFirstFace[i]);
+  for(size_t i=0; i<mesh.materialFirstFace.size(); i++)
+    mesh.materialFirstFace[i] = remapFace(mesh.materialFirstFace[i]);
+}
+
+float MeshCleaner::getEpsilon(){return epsilon;};
+int MeshCleaner::getVerticesBefore(){return verticesBefore;};
+int MeshCleaner::getVerticesAfter(){return verticesAfter;};
+int MeshCleaner::getTrianglesBefore(){return trianglesBefore;};
+int MeshCleaner::getTrianglesAfter(){return trianglesAfter;};
+int MeshCleaner::getDegenerateFaces(){return degenerateFaces;};
+int MeshCleaner::getDuplicateFaces(){return duplicateFaces;};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Index a face of the uncleaned list maps to after cleaning
+///
+/// Removed faces map to the next surviving face, so ranges of faces (such as
+/// objects) stay contiguous.
+int MeshCleaner::remapFace(int oldIndex){
+  if(oldIndex < 0 || oldIndex >= int(keptBefore.size()))
+    return oldIndex;
+  return keptBefore[oldIndex];
+}
+
+void MeshCleaner::printReport(){
+  cout << "Mesh cleanup (epsilon " << epsilon << ")" << endl;
+  cout << "  Vertices:  " << verticesBefore << " -> " << verticesAfter << endl;
+  cout << "  Triangles: " << trianglesBefore << " -> " << trianglesAfter
+       << " (" << degenerateFaces << " degenerate, "
+       << duplicateFaces << " duplicate faces removed)" << endl;
+}
@@ -0,0 +1,41 @@
+// STL
+#ifndef MESHCLEANER_H
+#define MESHCLEANER_H
+
+#include <vector>
+#include "Mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Load-time cleanup pass for a parsed model
+///
+/// Welds positions closer than epsilon using a spatial hash grid, removes
+/// zero-area and duplicate faces (the same corners in the same winding, from
+/// any starting corner) and drops vertices no face references.
+class MeshCleaner{
+
+private:
+  float epsilon;
+  int verticesBefore;
+  int verticesAfter;
+  int trianglesBefore;
+  int trianglesAfter;
+  int degenerateFaces;
+  int duplicateFaces;
+  std::vector<int> keptBefore;
+
+public:
+  MeshCleaner(float eps);
+  void clean(VertexList& vertices, FaceList& faces);
+  void clean(Mesh& mesh);
+  float getEpsilon();
+  int getVerticesBefore();
+  int getVerticesAfter();
+  int getTrianglesBefore();
+  int getTrianglesAfter();
+  int getDegenerateFaces();
+  int getDuplicateFaces();
+  int remapFace(int oldIndex);
+  void printReport();
+
+};
+#endif
@@ -0,0 +1,241 @@
+#include "MeshGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include "MeshLoader.h"
+#include "Trace.h"
+using namespace std;
+
+namespace {
+
+  const float SPHERE_RADIUS = 3.f;
+  const float TERRAIN_SIZE = 8.f;
+  const float TERRAIN_GROUND = -1.5f;
+  const float INSTANCE_SPAN = 8.f;
+  const float INSTANCE_GAP = 1.2f;
+
+  Vertex vertexOf(float x, float y, float z){
+    Vertex v;
+    v.setX(x);
+    v.setY(y);
+    v.setZ(z);
+    return v;
+  }
+
+  //Unit normal of the plane through three points, or zero if they are in line
+  Normal planeNormal(Vertex a, Vertex b, Vertex c){
+    float u[3] = {b.getX()-a.getX(), b.getY()-a.getY(), b.getZ()-a.getZ()};
+    float v[3] = {c.getX()-a.getX(), c.getY()-a.getY(), c.getZ()-a.getZ()};
+    float n[3] = {u[1]*v[2]-u[2]*v[1], u[2]*v[0]-u[0]*v[2], u[0]*v[1]-u[1]*v[0]};
+    float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    Normal normal;
+    normal.setX(length > 0.f ? n[0]/length : 0.f);
+    normal.setY(length > 0.f ? n[1]/length : 0.f);
+    normal.setZ(length > 0.f ? n[2]/length : 0.f);
+    return normal;
+  }
+
+  void addTriangle(Mesh& mesh, Vertex a, Vertex b, Vertex c){
+    Normal normal = planeNormal(a, b, c);
+    Face face;
+    face.setV1(a);
+    face.setV2(b);
+    face.setV3(c);
+    face.setNormal(normal);
+    face.setIsTriangle(true);
+    face.setIsTexture(false);
+    mesh.normals.push_back(normal);
+    mesh.faces.push_back(face);
+  }
+
+  //Height of the terrain over the ground plane
+  float height(float x, float z){
+    return 0.6f*std::sin(0.9f*x+0.4f)*std::cos(0.7f*z-0.3f) + 0.25f*std::sin(2.3f*x+1.7f*z) +
+           0.08f*std::sin(6.1f*x-4.3f*z)*std::cos(5.2f*z+1.1f);
+  }
+
+  Vertex place(Vertex v, const float* center, float scale, float x, float z){
+    return vertexOf((v.getX()-center[0])*scale + x, (v.getY()-center[1])*scale,
+                    (v.getZ()-center[2])*scale + z);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Geodesic sphere: an icosahedron with each face cut into a grid
+/// @param triangles Rough triangle count; 20 times a square number is exact
+Mesh MeshGenerator::sphere(int triangles){
+  TRACE_ZONE("generate sphere");
+  const float t = 1.618034f;
+  const float corners[12][3] = {{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+                                {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+                                {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+  const int patches[20][3] = {{0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+                              {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+                              {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+                              {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}};
+  int k = std::max(1, int(std::lround(std::sqrt(std::max(1, triangles)/20.0))));
+  Mesh mesh;
+  mesh.faces.reserve(size_t(20)*k*k);
+  mesh.normals.reserve(size_t(20)*k*k);
+  mesh.vertices.reserve(size_t(20)*(k+1)*(k+2)/2);
+
+  //Points of a patch by row i and column j, with i+j <= k
+  vector<Vertex> grid;
+  for(int p=0; p<20; p++){
+    const float* a = corners[patches[p][0]];
+    const float* b = corners[patches[p][1]];
+    const float* c = corners[patches[p][2]];
+    grid.clear();
+    for(int i=0; i<=k; i++)
+      for(int j=0; j<=k-i; j++){
+        float q[3];
+        for(int d=0; d<3; d++)
+          q[d] = a[d] + (b[d]-a[d])*i/k + (c[d]-a[d])*j/k;
+        float scale = SPHERE_RADIUS/std::sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2]);
+        grid.push_back(vertexOf(q[0]*scale, q[1]*scale, q[2]*scale));
+      }
+    mesh.vertices.insert(mesh.vertices.end(), grid.begin(), grid.end());
+
+    //Row i starts after the longer rows above it
+    auto at = [&](int i, int j){return grid[i*(k+1) - i*(i-1)/2 + j];};
+    for(int i=0; i<k; i++)
+      for(int j=0; j<k-i; j++){
+        addTriangle(mesh, at(i, j), at(i+1, j), at(i, j+1));
+        if(i+j < k-1)
+          addTriangle(mesh, at(i+1, j), at(i+1, j+1), at(i, j+1));
+      }
+  }
+  mesh.objectNames.push_back("sphere");
+  mesh.objectFirstFace.push_back(0);
+  return mesh;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Square grid of quads displaced into rolling hills, with coordinates
+/// for a texture stretched over the whole grid
+/// @param triangles Rough triangle count; twice a square number is exact
+Mesh MeshGenerator::terrain(int triangles){
+  TRACE_ZONE("generate terrain");
+  int n = std::max(1, int(std::lround(std::sqrt(std::max(1, triangles)/2.0))));
+  Mesh mesh;
+  mesh.vertices.reserve(size_t(n+1)*(n+1));
+  mesh.textures.reserve(size_t(n+1)*(n+1));
+  mesh.faces.reserve(size_t(n)*n);
+  mesh.normals.reserve(size_t(n)*n);
+  for(int i=0; i<=n; i++)
+    for(int j=0; j<=n; j++){
+      float x = TERRAIN_SIZE*(float(i)/n - 0.5f);
+      float z = TERRAIN_SIZE*(float(j)/n - 0.5f);
+      mesh.vertices.push_back(vertexOf(x, TERRAIN_GROUND + height(x, z), z));
+      mesh.textures.push_back(Texture(float(i)/n, float(j)/n));
+    }
+
+  //Corners are in the order that makes the normals point up
+  for(int i=0; i<n; i++)
+    for(int j=0; j<n; j++){
+      size_t corner[4] = {size_t(i)*(n+1)+j, size_t(i)*(n+1)+j+1, size_t(i+1)*(n+1)+j+1,
+                          size_t(i+1)*(n+1)+j};
+      Vertex v[4];
+      for(int c=0; c<4; c++)
+        v[c] = mesh.vertices[corner[c]];
+      //Across the diagonals, since the corners need not lie in one plane
+      Vertex origin = vertexOf(0.f, 0.f, 0.f);
+      Vertex d1 = vertexOf(v[2].getX()-v[0].getX(), v[2].getY()-v[0].getY(), v[2].getZ()-v[0].getZ());
+      Vertex d2 = vertexOf(v[3].getX()-v[1].getX(), v[3].getY()-v[1].getY(), v[3].getZ()-v[1].getZ());
+      Normal normal = planeNormal(origin, d1, d2);
+      Face face;
+      face.setV1(v[0]);
+      face.setV2(v[1]);
+      face.setV3(v[2]);
+      face.setV4(v[3]);
+      face.setT1(mesh.textures[corner[0]]);
+      face.setT2(mesh.textures[corner[1]]);
+      face.setT3(mesh.textures[corner[2]]);
+      face.setT4(mesh.textures[corner[3]]);
+      face.setNormal(normal);
+      face.setIsTriangle(false);
+      face.setIsTexture(true);
+      mesh.normals.push_back(normal);
+      mesh.faces.push_back(face);
+    }
+  mesh.objectNames.push_back("terrain");
+  mesh.objectFirstFace.push_back(0);
+  return mesh;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Copies of a model on a square grid, scaled down to fit the view
+/// @param source Model to copy, with its materials
+/// @param triangles Rough triangle count; rounded up to whole copies
+///
+/// Every copy is an object of its own and keeps the source's material ranges.
+Mesh MeshGenerator::instances(Mesh& source, int triangles){
+  TRACE_ZONE("generate instances");
+  Mesh mesh;
+  int sourceTriangles = source.getTriangleCount();
+  if(sourceTriangles == 0)
+    return mesh;
+  int copies = std::max(1, int((std::max(1, triangles) + sourceTriangles - 1LL)/sourceTriangles));
+  int side = int(std::ceil(std::sqrt(double(copies))));
+
+  float lo[3] = {1e30f, 1e30f, 1e30f}, hi[3] = {-1e30f, -1e30f, -1e30f};
+  for(size_t f=0; f<source.faces.size(); f++){
+    Face& face = source.faces[f];
+    Vertex v[4] = {face.getV1(), face.getV2(), face.getV3(), face.getV4()};
+    for(int c=0; c<(face.isTriangle() ? 3 : 4); c++){
+      float p[3] = {v[c].getX(), v[c].getY(), v[c].getZ()};
+      for(int a=0; a<3; a++){
+        lo[a] = std::min(lo[a], p[a]);
+        hi[a] = std::max(hi[a], p[a]);
+      }
+    }
+  }
+  float center[3] = {0.5f*(lo[0]+hi[0]), 0.5f*(lo[1]+hi[1]), 0.5f*(lo[2]+hi[2])};
+  float spacing = INSTANCE_GAP*std::max(std::max(hi[0]-lo[0], hi[2]-lo[2]), 1e-6f);
+  float scale = INSTANCE_SPAN/(side*spacing);
+
+  size_t faces = source.faces.size();
+  mesh.faces.reserve(faces*copies);
+  mesh.vertices.reserve(source.vertices.size()*copies);
+  mesh.normals.reserve(source.normals.size()*copies);
+  mesh.textures.reserve(source.textures.size()*copies);
+  mesh.materialLibraries = source.materialLibraries;
+  mesh.materials = source.materials;
+  for(int n=0; n<copies; n++){
+    float x = ((n % side) - 0.5f*(side-1))*spacing*scale;
+    float z = ((n / side) - 0.5f*(side-1))*spacing*scale;
+    for(size_t i=0; i<source.vertices.size(); i++)
+      mesh.vertices.push_back(place(source.vertices[i], center, scale, x, z));
+    mesh.normals.insert(mesh.normals.end(), source.normals.begin(), source.normals.end());
+    mesh.textures.insert(mesh.textures.end(), source.textures.begin(), source.textures.end());
+    for(size_t r=0; r<source.materialFirstFace.size(); r++){
+      mesh.materialFirstFace.push_back(source.materialFirstFace[r] + int(n*faces));
+      mesh.materialIndex.push_back(source.materialIndex[r]);
+    }
+    mesh.objectNames.push_back("instance " + to_string(n));
+    mesh.objectFirstFace.push_back(int(n*faces));
+    for(size_t f=0; f<faces; f++){
+      Face face = source.faces[f];
+      face.setV1(place(face.getV1(), center, scale, x, z));
+      face.setV2(place(face.getV2(), center, scale, x, z));
+      face.setV3(place(face.getV3(), center, scale, x, z));
+      if(!face.isTriangle())
+        face.setV4(place(face.getV4(), center, scale, x, z));
+      mesh.faces.push_back(face);
+    }
+  }
+  return mesh;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Generates a shape by name
+/// @param shape sphere, terrain, or a model file to make copies of
+/// @param triangles Rough triangle count
+/// @return The mesh, or an empty mesh if the model cannot be loaded
+Mesh MeshGenerator::generate(std::string shape, int triangles){
+  if(shape == "sphere")
+    return sphere(triangles);
+  if(shape == "terrain")
+    return terrain(triangles);
+  Mesh source = MeshLoader::load(shape);
+  return instances(source, triangles);
+}
@@ -0,0 +1,24 @@
+// STL
+#ifndef MESHGENERATOR_H
+#define MESHGENERATOR_H
+
+#include <string>
+#include "Mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Procedural meshes of any size, for finding where the engine scales
+///
+/// Each shape is built as close to a requested triangle count as its pattern
+/// allows (quads count as two) and fits the viewer's orbit like the bundled
+/// models. Faces carry flat normals; corner positions are listed per patch, so
+/// points on patch seams repeat in the vertex list as they would in a file.
+class MeshGenerator{
+
+public:
+  static Mesh sphere(int triangles);
+  static Mesh terrain(int triangles);
+  static Mesh instances(Mesh& source, int triangles);
+  static Mesh generate(std::string shape, int triangles);
+
+};
+#endif
@@ -0,0 +1,93 @@
+#include "MeshLoader.h"
+#include "DecompressStream.h"
+#include "MeshCleaner.h"
+#include "ObjLoader.h"
+#include "PlyFile.h"
+#include "StlFile.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <dirent.h>
+#include <sys/stat.h>
+using namespace std;
+
+namespace {
+
+  //Lower case extension of a file name without its compression suffix
+  string extensionOf(string path){
+    string name = DecompressStream::uncompressedName(path);
+    size_t dot = name.find_last_of('.');
+    if(dot == string::npos || name.find('/', dot) != string::npos)
+      return "";
+    string extension = name.substr(dot+1);
+    for(size_t i=0; i<extension.size(); i++)
+      extension[i] = tolower(extension[i]);
+    return extension;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse a model file, and clean it if asked
+/// @param path OBJ, PLY or STL file to read, by extension; compressed files
+///             are decompressed as they are read
+/// @param options Cleanup to apply and whether to print its report
+/// @return The mesh, with no faces if the file could not be read
+Mesh MeshLoader::load(std::string path, LoadOptions options){
+  TRACE_ZONE("load");
+  Mesh mesh;
+  string extension = extensionOf(path);
+  bool read;
+  if(extension == "ply")
+    read = PlyFile::readFile(path, mesh);
+  else if(extension == "stl")
+    read = StlFile::readFile(path, mesh);
+  else
+    read = ObjLoader::readFile(path, mesh);
+  if(!read){
+    mesh.clear();
+    return mesh;
+  }
+  if(options.clean){
+    TRACE_ZONE("clean");
+    MeshCleaner cleaner(options.epsilon);
+    cleaner.clean(mesh);
+    if(options.report)
+      cleaner.printReport();
+  }
+  return mesh;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Whether load reads this kind of file, compressed or not
+bool MeshLoader::isModelFile(std::string path){
+  string extension = extensionOf(path);
+  return extension == "obj" || extension == "ply" || extension == "stl";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Add a file, or every model file of a directory, to an input list
+///
+/// Directories are scanned for the files isModelFile accepts, in name order.
+void MeshLoader::collectInputs(std::string path, std::vector<std::string>& inputs){
+  struct stat info;
+  if(stat(path.c_str(), &info) != 0){
+    cout << "Skipping missing input " << path << endl;
+    return;
+  }
+  if(!S_ISDIR(info.st_mode)){
+    inputs.push_back(path);
+    return;
+  }
+
+  DIR* dir = opendir(path.c_str());
+  if(!dir)
+    return;
+  vector<string> found;
+  while(dirent* entry = readdir(dir))
+    if(isModelFile(entry->d_name))
+      found.push_back(path + "/" + entry->d_name);
+  closedir(dir);
+  sort(found.begin(), found.end());
+  inputs.insert(inputs.end(), found.begin(), found.end());
+}
@@ -0,0 +1,33 @@
+// STL
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief What load does to a model after parsing it
+struct LoadOptions{
+  bool clean;
+  float epsilon;
+  bool report;
+
+  LoadOptions() : clean(false), epsilon(1e-4f), report(false) {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Entry point of the mesh library (libspidermesh.a)
+///
+/// Everything a load touches belongs to the call; memory and trace counters are
+/// atomic or per thread. Any number of threads may load at once, and nothing
+/// needs a window or GL context.
+class MeshLoader{
+
+public:
+  static Mesh load(std::string path, LoadOptions options = LoadOptions());
+  static bool isModelFile(std::string path);
+  static void collectInputs(std::string path, std::vector<std::string>& inputs);
+
+};
+#endif
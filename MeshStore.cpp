@@ -0,0 +1,214 @@
+#include "MeshStore.h"
+#include <cstring>
+#include <iostream>
+using namespace std;
+
+namespace {
+
+  //64 bit FNV-1a over the canonical values of a mesh
+  struct Hasher{
+    uint64_t value;
+
+    Hasher() : value(14695981039346656037ull) {}
+
+    void bytes(const void* data, size_t size){
+      const unsigned char* p = static_cast<const unsigned char*>(data);
+      for(size_t i=0; i<size; i++){
+        value ^= p[i];
+        value *= 1099511628211ull;
+      }
+    }
+
+    void number(float f){
+      if(f == 0.f)
+        f = 0.f;
+      uint32_t bits;
+      memcpy(&bits, &f, sizeof(bits));
+      bytes(&bits, sizeof(bits));
+    }
+
+    void number(int i){
+      int32_t v = i;
+      bytes(&v, sizeof(v));
+    }
+  };
+
+  bool sameNumber(float a, float b){
+    return a == b || (a != a && b != b);
+  }
+
+  bool samePoint(Vertex a, Vertex b){
+    return sameNumber(a.getX(), b.getX()) && sameNumber(a.getY(), b.getY()) &&
+           sameNumber(a.getZ(), b.getZ());
+  }
+
+  bool sameCoordinate(Texture a, Texture b){
+    return sameNumber(a.getX(), b.getX()) && sameNumber(a.getY(), b.getY());
+  }
+}
+
+MeshStore::MeshStore(){
+  lookups=0;
+  hits=0;
+  reusedBytes=0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Content hash of a mesh's faces and their object and material ranges
+uint64_t MeshStore::hash(Mesh& mesh){
+  Hasher h;
+  bool normals = mesh.hasNormals(), textures = mesh.hasTextures();
+  h.number(int(mesh.faces.size()));
+  h.number(int(normals) | int(textures) << 1);
+  for(size_t f=0; f<mesh.faces.size(); f++){
+    Face& face = mesh.faces[f];
+    int corners = face.isTriangle() ? 3 : 4;
+    Vertex v[4] = {face.getV1(), face.getV2(), face.getV3(), face.getV4()};
+    Texture t[4] = {face.getT1(), face.getT2(), face.getT3(), face.getT4()};
+    h.number(corners);
+    for(int k=0; k<corners; k++){
+      h.number(v[k].getX());
+      h.number(v[k].getY());
+      h.number(v[k].getZ());
+      if(textures){
+        h.number(t[k].getX());
+        h.number(t[k].getY());
+      }
+    }
+    if(normals){
+      h.number(face.getNormal().getX());
+      h.number(face.getNormal().getY());
+      h.number(face.getNormal().getZ());
+    }
+  }
+  for(size_t i=0; i<mesh.materialFirstFace.size(); i++){
+    h.number(mesh.materialFirstFace[i]);
+    h.number(mesh.materialIndex[i]);
+  }
+  for(size_t i=0; i<mesh.objectFirstFace.size(); i++){
+    h.number(mesh.objectFirstFace[i]);
+    h.bytes(mesh.objectNames[i].data(), mesh.objectNames[i].size()+1);
+  }
+  return h.value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Whether two meshes have everything the hash covers in common
+bool MeshStore::sameGeometry(Mesh& a, Mesh& b){
+  bool normals = a.hasNormals(), textures = a.hasTextures();
+  if(a.faces.size() != b.faces.size() || normals != b.hasNormals() || textures != b.hasTextures() ||
+     a.materialFirstFace != b.materialFirstFace || a.materialIndex != b.materialIndex ||
+     a.objectFirstFace != b.objectFirstFace || a.objectNames != b.objectNames)
+    return false;
+  for(size_t f=0; f<a.faces.size(); f++){
+    Face& fa = a.faces[f];
+    Face& fb = b.faces[f];
+    if(fa.isTriangle() != fb.isTriangle())
+      return false;
+    int corners = fa.isTriangle() ? 3 : 4;
+    Vertex va[4] = {fa.getV1(), fa.getV2(), fa.getV3(), fa.getV4()};
+    Vertex vb[4] = {fb.getV1(), fb.getV2(), fb.getV3(), fb.getV4()};
+    Texture ta[4] = {fa.getT1(), fa.getT2(), fa.getT3(), fa.getT4()};
+    Texture tb[4] = {fb.getT1(), fb.getT2(), fb.getT3(), fb.getT4()};
+    for(int k=0; k<corners; k++)
+      if(!samePoint(va[k], vb[k]) || (textures && !sameCoordinate(ta[k], tb[k])))
+        return false;
+    if(normals){
+      Normal na = fa.getNormal(), nb = fb.getNormal();
+      if(!sameNumber(na.getX(), nb.getX()) || !sameNumber(na.getY(), nb.getY()) ||
+         !sameNumber(na.getZ(), nb.getZ()))
+        return false;
+    }
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Stored geometry with the same content as a mesh, if any is loaded
+/// @param key hash of the mesh
+/// @param mesh Freshly parsed mesh, compared against stored ones on a match
+/// @return The shared geometry, or an empty pointer
+std::shared_ptr<Geometry> MeshStore::find(uint64_t key, Mesh& mesh){
+  std::lock_guard<std::mutex> guard(lock);
+  lookups++;
+  auto range = entries.equal_range(key);
+  for(auto it=range.first; it!=range.second;){
+    std::shared_ptr<Geometry> geometry = it->second.lock();
+    if(!geometry){
+      it = entries.erase(it);
+      continue;
+    }
+    if(sameGeometry(geometry->mesh, mesh)){
+      hits++;
+      reusedBytes += geometry->bytes;
+      return geometry;
+    }
+    ++it;
+  }
+  return std::shared_ptr<Geometry>();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Make built geometry available to later loads
+void MeshStore::insert(std::shared_ptr<Geometry> geometry){
+  std::lock_guard<std::mutex> guard(lock);
+  entries.insert(std::make_pair(geometry->hash, std::weak_ptr<Geometry>(geometry)));
+}
+
+int MeshStore::getGeometryCount(){
+  std::lock_guard<std::mutex> guard(lock);
+  int count = 0;
+  for(auto it=entries.begin(); it!=entries.end(); ++it)
+    count += !it->second.expired();
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Loaded models using stored geometry
+int MeshStore::getReferenceCount(){
+  std::lock_guard<std::mutex> guard(lock);
+  int count = 0;
+  for(auto it=entries.begin(); it!=entries.end(); ++it){
+    std::shared_ptr<Geometry> geometry = it->second.lock();
+    if(geometry)
+      count += geometry->models;
+  }
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Bytes of the geometry loaded, counting each shared copy once
+size_t MeshStore::getUniqueBytes(){
+  std::lock_guard<std::mutex> guard(lock);
+  size_t bytes = 0;
+  for(auto it=entries.begin(); it!=entries.end(); ++it){
+    std::shared_ptr<Geometry> geometry = it->second.lock();
+    if(geometry)
+      bytes += geometry->bytes;
+  }
+  return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Bytes that separate copies for each loaded model would add right now
+size_t MeshStore::getDeduplicatedBytes(){
+  std::lock_guard<std::mutex> guard(lock);
+  size_t bytes = 0;
+  for(auto it=entries.begin(); it!=entries.end(); ++it){
+    std::shared_ptr<Geometry> geometry = it->second.lock();
+    int models = geometry ? int(geometry->models) : 0;
+    if(models > 1)
+      bytes += geometry->bytes*(models-1);
+  }
+  return bytes;
+}
+
+int MeshStore::getLookups(){return lookups;};
+int MeshStore::getHits(){return hits;};
+
+void MeshStore::printReport(){
+  cout << "Mesh store: " << getGeometryCount() << " geometries, " << getReferenceCount()
+       << " models, " << getUniqueBytes()/1024.0 << " KB unique, "
+       << getDeduplicatedBytes()/1024.0 << " KB deduplicated (" << getHits() << " of "
+       << getLookups() << " loads were identical models, reusing " << size_t(reusedBytes)/1024.0 << " KB)" << endl;
+}
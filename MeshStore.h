@@ -0,0 +1,72 @@
+// STL
+#ifndef MESHSTORE_H
+#define MESHSTORE_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "BVH.h"
+#include "Mesh.h"
+#include "Meshlets.h"
+#include "Topology.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parsed geometry of a model and everything built from it at load time
+///
+/// Shared by every loaded model with the same content, and never changed once
+/// it is in the store. bytes is the CPU memory it holds; source is the first
+/// file it was loaded from. models counts the loaded models using it, apart
+/// from the packets, uploads and threads that also hold it for a while.
+struct Geometry{
+  uint64_t hash;
+  std::string source;
+  Mesh mesh;
+  BVH bvh;
+  Topology topology;
+  Meshlets meshlets;
+  size_t bytes;
+  std::atomic<int> models;
+
+  Geometry() : hash(0), bytes(0), models(0) {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Content addressed store that shares the geometry of identical models
+///
+/// A mesh is hashed from the values at the corners of its faces (positions,
+/// normals and texture coordinates, with -0 folded into 0) and its object and
+/// material ranges, so the order, duplicates and unused entries of the file's
+/// vertex lists do not matter. A later load with the same hash and the same
+/// faces reuses the stored geometry instead of building its own. The whole
+/// model is one entry: the BVH, meshlets and GPU upload are built over all of
+/// its faces, so a part repeated inside or across files is not shared on its
+/// own. The store only holds weak references: geometry is freed with the last
+/// model using it. Safe to use from any thread.
+class MeshStore{
+
+private:
+  std::multimap<uint64_t, std::weak_ptr<Geometry>> entries;
+  std::mutex lock;
+  std::atomic<int> lookups;
+  std::atomic<int> hits;
+  std::atomic<size_t> reusedBytes;
+
+public:
+  MeshStore();
+  static uint64_t hash(Mesh& mesh);
+  static bool sameGeometry(Mesh& a, Mesh& b);
+  std::shared_ptr<Geometry> find(uint64_t key, Mesh& mesh);
+  void insert(std::shared_ptr<Geometry> geometry);
+  int getGeometryCount();
+  int getReferenceCount();
+  size_t getUniqueBytes();
+  size_t getDeduplicatedBytes();
+  int getLookups();
+  int getHits();
+  void printReport();
+
+};
+#endif
@@ -0,0 +1,277 @@
+#include "Meshlets.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+using namespace std;
+
+namespace {
+
+  struct PointKey{
+    uint32_t x;
+    uint32_t y;
+    uint32_t z;
+    bool operator==(const PointKey& o) const {return x==o.x && y==o.y && z==o.z;}
+  };
+
+  struct PointKeyHash{
+    size_t operator()(const PointKey& k) const {
+      return size_t(k.x)*2654435761u ^ size_t(k.y)*40503u ^ size_t(k.z);
+    }
+  };
+
+  //Cost of a fully opposed normal, in new vertices
+  const float CONE_WEIGHT = 4.f;
+
+  //Largest 1-cos of the angle between a new normal and the cone axis
+  const float MAX_SPREAD = 0.5f;
+
+  void unitNormal(Vertex p[3], float n[3]){
+    float u[3] = {p[1].getX()-p[0].getX(), p[1].getY()-p[0].getY(), p[1].getZ()-p[0].getZ()};
+    float w[3] = {p[2].getX()-p[0].getX(), p[2].getY()-p[0].getY(), p[2].getZ()-p[0].getZ()};
+    n[0] = u[1]*w[2]-u[2]*w[1];
+    n[1] = u[2]*w[0]-u[0]*w[2];
+    n[2] = u[0]*w[1]-u[1]*w[0];
+    float len = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    for(int a=0; a<3; a++)
+      n[a] = len > 0.f ? n[a]/len : 0.f;
+  }
+}
+
+Meshlets::Meshlets(){
+  buildTime=0.f;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Corners of one triangle of a face
+/// @param face Face the triangle came from
+/// @param half 0 for a triangle or the first half of a quad, 1 for the second
+/// @param out The three corners, counter clockwise as in the face
+void Meshlets::corners(Face& face, int half, Vertex out[3]){
+  out[0] = face.getV1();
+  out[1] = half ? face.getV3() : face.getV2();
+  out[2] = half ? face.getV4() : face.getV3();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Cluster the faces of a model
+/// @param faces Faces of the model
+/// @param materialFirstFace First face of each material run
+/// @param materialIndex Material of each run
+void Meshlets::build(FaceList& faces, const std::vector<int>& materialFirstFace,
+                     const std::vector<int>& materialIndex){
+  using namespace std::chrono;
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  clear();
+
+  //Triangles as face*2+half, with the unique position of each corner
+  vector<int> source;
+  vector<unsigned int> corner;
+  vector<float> positions;
+  vector<float> normals;
+  vector<int> material;
+  size_t run = 0;
+  unordered_map<PointKey, unsigned int, PointKeyHash> index;
+  index.reserve(faces.size()*2);
+  for(size_t i=0; i<faces.size(); i++){
+    while(run < materialFirstFace.size() && materialFirstFace[run] <= int(i))
+      run++;
+    for(int half=0; half<(faces[i].isTriangle() ? 1 : 2); half++){
+      Vertex p[3];
+      corners(faces[i], half, p);
+      source.push_back(2*i+half);
+      material.push_back(run > 0 ? materialIndex[run-1] : -1);
+      float n[3];
+      unitNormal(p, n);
+      normals.insert(normals.end(), n, n+3);
+      for(int c=0; c<3; c++){
+        PointKey k;
+        float x=p[c].getX(), y=p[c].getY(), z=p[c].getZ();
+        memcpy(&k.x,&x,4);
+        memcpy(&k.y,&y,4);
+        memcpy(&k.z,&z,4);
+        auto it = index.find(k);
+        if(it == index.end()){
+          it = index.insert(make_pair(k, (unsigned int)(positions.size()/3))).first;
+          positions.push_back(x);
+          positions.push_back(y);
+          positions.push_back(z);
+        }
+        corner.push_back(it->second);
+      }
+    }
+  }
+  int triangleTotal = source.size();
+  int pointTotal = positions.size()/3;
+
+  //Triangles around each point, packed by point
+  vector<int> adjacencyStart(pointTotal+1, 0);
+  for(size_t c=0; c<corner.size(); c++)
+    adjacencyStart[corner[c]+1]++;
+  for(int p=0; p<pointTotal; p++)
+    adjacencyStart[p+1] += adjacencyStart[p];
+  vector<int> adjacency(corner.size());
+  vector<int> fill(adjacencyStart.begin(), adjacencyStart.end()-1);
+  for(size_t c=0; c<corner.size(); c++)
+    adjacency[fill[corner[c]]++] = c/3;
+
+  vector<char> assigned(triangleTotal, 0);
+  vector<int> owner(pointTotal, -1);
+  vector<int> candidates;
+  vector<int> members;
+  int seed = 0;
+  while(true){
+    while(seed < triangleTotal && assigned[seed])
+      seed++;
+    if(seed == triangleTotal)
+      break;
+
+    Meshlet m;
+    m.firstTriangle = triangles.size();
+    m.triangleCount = 0;
+    m.firstVertex = vertices.size();
+    m.vertexCount = 0;
+    m.material = material[seed];
+    int id = meshlets.size();
+    candidates.clear();
+    members.clear();
+    int next = seed;
+    float axis[3] = {0.f, 0.f, 0.f};
+
+    while(next >= 0){
+      assigned[next] = 1;
+      members.push_back(next);
+      for(int a=0; a<3; a++)
+        axis[a] += normals[3*next+a];
+      triangles.push_back(source[next]);
+      m.triangleCount++;
+      for(int c=0; c<3; c++){
+        unsigned int p = corner[3*next+c];
+        if(owner[p] != id){
+          owner[p] = id;
+          vertices.push_back(p);
+          m.vertexCount++;
+        }
+        for(int a=adjacencyStart[p]; a<adjacencyStart[p+1]; a++)
+          if(!assigned[adjacency[a]] && material[adjacency[a]] == m.material)
+            candidates.push_back(adjacency[a]);
+      }
+      if(m.triangleCount == MAX_TRIANGLES)
+        break;
+
+      //Neighbour adding the fewest vertices and bending the cone least
+      float axisLength = std::sqrt(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+      next = -1;
+      float best = 1e30f;
+      size_t kept = 0;
+      for(size_t i=0; i<candidates.size(); i++){
+        int t = candidates[i];
+        if(assigned[t])
+          continue;
+        candidates[kept++] = t;
+        int added = 0;
+        for(int c=0; c<3; c++)
+          added += owner[corner[3*t+c]] != id;
+        if(m.vertexCount+added > MAX_VERTICES)
+          continue;
+        const float* n = &normals[3*t];
+        float spread = axisLength > 0.f ? 1.f - (n[0]*axis[0] + n[1]*axis[1] + n[2]*axis[2])/axisLength : 0.f;
+        if(spread > MAX_SPREAD)
+          continue;
+        float score = added + CONE_WEIGHT*spread;
+        if(score < best){
+          best = score;
+          next = t;
+        }
+      }
+      candidates.resize(kept);
+    }
+
+    //Bounding sphere around the box centre
+    float lo[3] = {1e30f, 1e30f, 1e30f}, hi[3] = {-1e30f, -1e30f, -1e30f};
+    for(int v=0; v<m.vertexCount; v++){
+      const float* x = &positions[3*vertices[m.firstVertex+v]];
+      for(int a=0; a<3; a++){
+        lo[a] = std::min(lo[a], x[a]);
+        hi[a] = std::max(hi[a], x[a]);
+      }
+    }
+    for(int a=0; a<3; a++)
+      m.center[a] = 0.5f*(lo[a]+hi[a]);
+    float r2 = 0.f;
+    for(int v=0; v<m.vertexCount; v++){
+      const float* x = &positions[3*vertices[m.firstVertex+v]];
+      float dx=x[0]-m.center[0], dy=x[1]-m.center[1], dz=x[2]-m.center[2];
+      r2 = std::max(r2, dx*dx+dy*dy+dz*dz);
+    }
+    m.radius = std::sqrt(r2);
+
+    //Cone around the mean normal; degenerate triangles have none
+    float sum[3] = {0.f, 0.f, 0.f};
+    for(size_t i=0; i<members.size(); i++)
+      for(int a=0; a<3; a++)
+        sum[a] += normals[3*members[i]+a];
+    float len = std::sqrt(sum[0]*sum[0] + sum[1]*sum[1] + sum[2]*sum[2]);
+    float minDot = 1.f;
+    for(int a=0; a<3; a++)
+      m.axis[a] = len > 0.f ? sum[a]/len : 0.f;
+    for(size_t i=0; i<members.size(); i++){
+      const float* n = &normals[3*members[i]];
+      if(n[0]==0.f && n[1]==0.f && n[2]==0.f)
+        continue;
+      minDot = std::min(minDot, n[0]*m.axis[0] + n[1]*m.axis[1] + n[2]*m.axis[2]);
+    }
+    m.cutoff = len > 0.f && minDot > 0.f ? std::sqrt(1.f-minDot*minDot) : 1.f;
+    meshlets.push_back(m);
+  }
+  buildTime = duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+}
+
+void Meshlets::clear(){
+  meshlets.clear();
+  triangles.clear();
+  vertices.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Meshlets that may have a triangle facing the camera
+/// @param eye Camera position in model space
+/// @param visible Indices of the meshlets to draw
+/// @return Triangles in the visible meshlets
+///
+/// A meshlet is skipped when every direction from the eye to its bounding
+/// sphere is within 90 degrees minus the cone angle of the cone axis, so no
+/// triangle in it can face the eye.
+int Meshlets::cull(const float eye[3], std::vector<int>& visible) const{
+  visible.clear();
+  int drawnTriangles = 0;
+  for(size_t i=0; i<meshlets.size(); i++){
+    const Meshlet& m = meshlets[i];
+    float d[3] = {m.center[0]-eye[0], m.center[1]-eye[1], m.center[2]-eye[2]};
+    float distance = std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+    float along = d[0]*m.axis[0] + d[1]*m.axis[1] + d[2]*m.axis[2];
+    if(along > m.cutoff*distance + m.radius)
+      continue;
+    visible.push_back(i);
+    drawnTriangles += m.triangleCount;
+  }
+  return drawnTriangles;
+}
+
+int Meshlets::getFace(int triangle){return triangles[triangle]/2;};
+int Meshlets::getHalf(int triangle){return triangles[triangle]%2;};
+Meshlet& Meshlets::getMeshlet(int i){return meshlets[i];};
+int Meshlets::getMeshletCount(){return meshlets.size();};
+int Meshlets::getTriangleCount(){return triangles.size();};
+float Meshlets::getBuildTime(){return buildTime;};
+
+void Meshlets::printReport(){
+  cout << "Meshlets: " << getMeshletCount() << " clusters of up to " << MAX_VERTICES
+       << " vertices / " << MAX_TRIANGLES << " triangles over " << getTriangleCount()
+       << " triangles (" << (meshlets.empty() ? 0.f : float(vertices.size())/meshlets.size())
+       << " vertices, " << (meshlets.empty() ? 0.f : float(triangles.size())/meshlets.size())
+       << " triangles each) in " << buildTime*1000.f << " ms" << endl;
+}
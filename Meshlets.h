@@ -0,0 +1,63 @@
+// STL
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <vector>
+#include "Mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Small cluster of neighbouring triangles
+///
+/// The normal cone holds every triangle normal within the angle whose sine is
+/// cutoff around axis; a cutoff of 1 means the cluster can face any way.
+struct Meshlet{
+  float center[3];
+  float radius;
+  float axis[3];
+  float cutoff;
+  int firstTriangle;
+  int triangleCount;
+  int firstVertex;
+  int vertexCount;
+  int material;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Triangles of a model grouped into meshlets for cluster culling
+///
+/// Quads are split into two triangles. Each meshlet is grown from a seed
+/// triangle by adding the neighbour of the same material that brings in the
+/// fewest new vertices while keeping its normal within 60 degrees of the
+/// cluster's, up to
+/// MAX_VERTICES unique vertices and MAX_TRIANGLES triangles. A meshlet's
+/// triangles are contiguous in the triangle list and can be drawn as one
+/// range.
+class Meshlets{
+
+public:
+  static const int MAX_VERTICES = 64;
+  static const int MAX_TRIANGLES = 124;
+
+private:
+  TrackedVector<Meshlet, MEMORY_CACHE> meshlets;
+  TrackedVector<int, MEMORY_CACHE> triangles;
+  TrackedVector<unsigned int, MEMORY_CACHE> vertices;
+  float buildTime;
+
+public:
+  Meshlets();
+  void build(FaceList& faces, const std::vector<int>& materialFirstFace,
+             const std::vector<int>& materialIndex);
+  void clear();
+  int cull(const float eye[3], std::vector<int>& visible) const;
+  static void corners(Face& face, int half, Vertex out[3]);
+  int getFace(int triangle);
+  int getHalf(int triangle);
+  Meshlet& getMeshlet(int i);
+  int getMeshletCount();
+  int getTriangleCount();
+  float getBuildTime();
+  void printReport();
+
+};
+#endif
@@ -0,0 +1,327 @@
+#include "ObjLoader.h"
+#include "DecompressStream.h"
+#include "Memory.h"
+#include "Trace.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+using namespace std;
+
+namespace {
+
+  string trimmed(string s){
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return end == string::npos ? "" : s.substr(0, end+1);
+  }
+
+  string directoryOf(string path){
+    size_t slash = path.find_last_of('/');
+    return slash == string::npos ? "" : path.substr(0, slash+1);
+  }
+
+  //Position in the list of an index counting from 1, or back from -1 at the
+  //last element read so far
+  bool resolveIndex(long index, size_t count, size_t& position){
+    if(index > 0 && size_t(index) <= count)
+      position = index-1;
+    else if(index < 0 && size_t(-index) <= count)
+      position = count+index;
+    else
+      return false;
+    return true;
+  }
+
+  //Reads at least required and at most n numbers, leaving the rest zero
+  bool readFloats(const char* text, float* values, int required, int n){
+    for(int k=0; k<n; k++){
+      char* end;
+      float value = strtof(text, &end);
+      if(end == text){
+        values[k] = 0.f;
+        if(k < required)
+          return false;
+        continue;
+      }
+      values[k] = value;
+      text = end;
+    }
+    return true;
+  }
+
+  //A corner of a face: the vertex, and the texture and normal or -1
+  struct Corner{
+    size_t vertex;
+    long texture;
+    long normal;
+  };
+
+  //Reads a v, v/t, v//n or v/t/n corner and checks it against the lists
+  bool readCorner(const char*& text, Mesh& mesh, Corner& corner){
+    char* end;
+    long index = strtol(text, &end, 10);
+    if(end == text || !resolveIndex(index, mesh.vertices.size(), corner.vertex))
+      return false;
+    text = end;
+    corner.texture = corner.normal = -1;
+    size_t position;
+    if(*text != '/')
+      return true;
+    text++;
+    if(*text != '/'){
+      index = strtol(text, &end, 10);
+      if(end == text || !resolveIndex(index, mesh.textures.size(), position))
+        return false;
+      corner.texture = position;
+      text = end;
+    }
+    if(*text != '/')
+      return true;
+    text++;
+    index = strtol(text, &end, 10);
+    if(end == text || !resolveIndex(index, mesh.normals.size(), position))
+      return false;
+    corner.normal = position;
+    text = end;
+    return true;
+  }
+
+  //Adds a polygon as one face, or as a fan of triangles past four corners;
+  //the face takes the normal of its first corner, or none
+  bool readFace(const char* text, Mesh& mesh){
+    Corner corners[64];
+    int n = 0;
+    while(true){
+      while(*text == ' ' || *text == '\t' || *text == '\r')
+        text++;
+      if(!*text)
+        break;
+      if(n == 64 || !readCorner(text, mesh, corners[n]))
+        return false;
+      if(*text && *text != ' ' && *text != '\t' && *text != '\r')
+        return false;
+      n++;
+    }
+    if(n < 3)
+      return false;
+
+    Normal normal;
+    normal.setX(0.f);
+    normal.setY(0.f);
+    normal.setZ(0.f);
+    if(corners[0].normal >= 0)
+      normal = mesh.normals[corners[0].normal];
+    Texture none(0.f, 0.f, 0.f);
+    for(int first=1; first+1<n; first += (n == 4 ? 3 : 1)){
+      Corner* c[4] = {&corners[0], &corners[first], &corners[first+1], n == 4 ? &corners[3] : nullptr};
+      Face face;
+      face.setV1(mesh.vertices[c[0]->vertex]);
+      face.setV2(mesh.vertices[c[1]->vertex]);
+      face.setV3(mesh.vertices[c[2]->vertex]);
+      face.setT1(c[0]->texture >= 0 ? mesh.textures[c[0]->texture] : none);
+      face.setT2(c[1]->texture >= 0 ? mesh.textures[c[1]->texture] : none);
+      face.setT3(c[2]->texture >= 0 ? mesh.textures[c[2]->texture] : none);
+      face.setIsTriangle(!c[3]);
+      if(c[3]){
+        face.setV4(mesh.vertices[c[3]->vertex]);
+        face.setT4(c[3]->texture >= 0 ? mesh.textures[c[3]->texture] : none);
+      }
+      face.setNormal(normal);
+      mesh.faces.push_back(face);
+    }
+    return true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse an OBJ file into a mesh
+/// @param filename File to read; .obj.gz and .obj.zst are decompressed on a
+///                 thread of their own while they are parsed
+/// @param mesh Mesh the vertices, normals, textures and faces are added to
+/// @return Whether the file was accepted
+///
+/// Faces may list corners as v, v/t, v//n or v/t/n, with indices counted from
+/// the start or, when negative, back from the end. A malformed line or an
+/// index past what has been read fails the whole file.
+bool ObjLoader::readFile(std::string filename, Mesh& mesh){
+  TRACE_ZONE("parse");
+  ifstream inFile;
+  //Read buffer is the parse scratch accounted to MEMORY_PARSE
+  TrackedVector<char, MEMORY_PARSE> buffer(1 << 16);
+  inFile.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+
+  if(filename.find("obj") == std::string::npos){
+    cout << "File is not supported please provide an obj file" << endl;
+    return false;
+  }
+
+  unique_ptr<DecompressStream> compressed;
+  if(DecompressStream::isCompressed(filename))
+    compressed.reset(new DecompressStream(filename));
+  else{
+    inFile.open(filename.c_str());
+    if(!inFile.is_open()){
+      cout << "Could not open " << filename << endl;
+      return false;
+    }
+  }
+  istream& input = compressed ? static_cast<istream&>(*compressed) : inFile;
+  string line;
+  int lineNumber = 0;
+  while(getline(input, line)){
+    lineNumber++;
+    size_t start = line.find_first_not_of(" \t");
+    if(start == string::npos || line[start] == '#')
+      continue;
+    size_t space = line.find_first_of(" \t\r", start);
+    string keyword = line.substr(start, space == string::npos ? string::npos : space-start);
+    const char* rest = line.c_str() + (space == string::npos ? line.size() : space);
+    bool ok = true;
+
+    if(keyword == "f")
+      ok = readFace(rest, mesh);
+
+    //Case for the vertex
+    else if(keyword == "v"){
+      float point[3] = {0.f, 0.f, 0.f};
+      ok = readFloats(rest, point, 3, 3);
+      Vertex newVertex;
+      newVertex.setX(point[0]);
+      newVertex.setY(point[1]);
+      newVertex.setZ(point[2]);
+      mesh.vertices.push_back(newVertex);
+    }
+
+    //Case for texture
+    else if(keyword == "vt"){
+      float point[2] = {0.f, 0.f};
+      ok = readFloats(rest, point, 1, 2);
+      mesh.textures.push_back(Texture(point[0], point[1]));
+    }
+
+    //Case for normals
+    else if(keyword == "vn"){
+      float point[3] = {0.f, 0.f, 0.f};
+      ok = readFloats(rest, point, 3, 3);
+      Normal newNormal;
+      newNormal.setX(point[0]);
+      newNormal.setY(point[1]);
+      newNormal.setZ(point[2]);
+      mesh.normals.push_back(newNormal);
+    }
+
+    //Case for a material library, read relative to the model
+    else if(keyword == "mtllib"){
+      string library = trimmed(line.substr(start+7 < line.size() ? start+7 : line.size()));
+      mesh.materialLibraries.push_back(library);
+      readMaterials(directoryOf(filename) + library, mesh.materials);
+    }
+
+    //Case for a material used by the faces that follow
+    else if(keyword == "usemtl"){
+      string name = trimmed(line.substr(start+7 < line.size() ? start+7 : line.size()));
+      int index = -1;
+      for(size_t m=0; m<mesh.materials.size(); m++)
+        if(mesh.materials[m].name == name)
+          index = m;
+      //Unknown materials named after an image use it as their map
+      if(index < 0){
+        Material material;
+        material.name = name;
+        material.diffuse[0] = material.diffuse[1] = material.diffuse[2] = 1.f;
+        if(isImageFile(name))
+          material.diffuseMap = directoryOf(filename) + name;
+        index = mesh.materials.size();
+        mesh.materials.push_back(material);
+      }
+      if(!mesh.materialFirstFace.empty() && mesh.materialFirstFace.back() == int(mesh.faces.size()))
+        mesh.materialIndex.back() = index;
+      else{
+        mesh.materialFirstFace.push_back(mesh.faces.size());
+        mesh.materialIndex.push_back(index);
+      }
+    }
+
+    //Case for a named object
+    else if(keyword == "o"){
+      mesh.objectNames.push_back(line.substr(start+2 < line.size() ? start+2 : line.size()));
+      mesh.objectFirstFace.push_back(mesh.faces.size());
+    }
+
+    if(!ok){
+      cout << "Bad " << keyword << " on line " << lineNumber << " of " << filename << endl;
+      return false;
+    }
+  }
+  inFile.close();
+  if(compressed){
+    compressed->finish();
+    if(compressed->hasFailed())
+      return false;
+    printf("Decompressed %.1f MB to %.1f MB in %.1f ms alongside parsing, which waited %.1f ms for input\n",
+           compressed->getCompressedBytes()/1048576.0, compressed->getBytes()/1048576.0,
+           compressed->getDecompressSeconds()*1000.0, compressed->getWaitSeconds()*1000.0);
+  }
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse the materials of an MTL library
+/// @param filename Library to read
+/// @param materials Materials the library defines are added here
+/// @return Whether the library could be opened
+bool ObjLoader::readMaterials(std::string filename, std::vector<Material>& materials){
+  ifstream inFile(filename.c_str());
+  if(!inFile.is_open()){
+    cout << "Could not open " << filename << endl;
+    return false;
+  }
+  string line;
+  while(getline(inFile, line)){
+    line = trimmed(line);
+    size_t start = line.find_first_not_of(" \t");
+    if(start == string::npos)
+      continue;
+    line = line.substr(start);
+    istringstream in(line);
+    string keyword;
+    in >> keyword;
+    if(keyword == "newmtl"){
+      //A bare newmtl names its material with the empty string
+      Material material;
+      in >> ws;
+      getline(in, material.name);
+      material.diffuse[0] = material.diffuse[1] = material.diffuse[2] = 1.f;
+      materials.push_back(material);
+    }
+    else if(materials.empty())
+      continue;
+    else if(keyword == "Kd")
+      in >> materials.back().diffuse[0] >> materials.back().diffuse[1] >> materials.back().diffuse[2];
+    //Options such as -s or -bm come first, the image is the last word
+    else if(keyword == "map_Kd"){
+      string word, map;
+      while(in >> word)
+        map = word;
+      if(!map.empty())
+        materials.back().diffuseMap = directoryOf(filename) + map;
+    }
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Whether a file name has an image extension the textures can decode
+bool ObjLoader::isImageFile(std::string filename){
+  size_t dot = filename.find_last_of('.');
+  if(dot == string::npos)
+    return false;
+  string extension = filename.substr(dot+1);
+  for(size_t i=0; i<extension.size(); i++)
+    extension[i] = tolower(extension[i]);
+  return extension == "png" || extension == "tga" || extension == "ppm" || extension == "pgm";
+}
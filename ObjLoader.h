@@ -0,0 +1,18 @@
+// STL
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include <string>
+#include "Mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parser for Wavefront OBJ files and their MTL libraries
+class ObjLoader{
+
+public:
+  static bool readFile(std::string filename, Mesh& mesh);
+  static bool readMaterials(std::string filename, std::vector<Material>& materials);
+  static bool isImageFile(std::string filename);
+
+};
+#endif
@@ -0,0 +1,138 @@
+#include "ObjWriter.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+using namespace std;
+
+namespace {
+
+  struct AttributeKey{
+    uint32_t v[3];
+    bool operator==(const AttributeKey& o) const {
+      return v[0]==o.v[0] && v[1]==o.v[1] && v[2]==o.v[2];
+    }
+  };
+
+  struct AttributeKeyHash{
+    size_t operator()(const AttributeKey& k) const {
+      return size_t(k.v[0])*2654435761u ^ size_t(k.v[1])*40503u ^ size_t(k.v[2]);
+    }
+  };
+
+  //Index of an attribute value in out, appended on first use
+  class AttributeTable{
+  private:
+    unordered_map<AttributeKey, int, AttributeKeyHash> index;
+    vector<float>& out;
+    int width;
+
+  public:
+    AttributeTable(vector<float>& o, int w) : out(o), width(w) {}
+    int get(float x, float y, float z){
+      float values[3] = {x, y, z};
+      AttributeKey k{{0, 0, 0}};
+      memcpy(k.v, values, width*sizeof(float));
+      auto it = index.find(k);
+      if(it != index.end())
+        return it->second;
+      int i = out.size()/width;
+      for(int a=0; a<width; a++)
+        out.push_back(values[a]);
+      index[k] = i;
+      return i;
+    }
+  };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Deduplicate the attributes of a mesh and index its corners
+/// @param mesh Source mesh
+/// @param out Indexed mesh; attributes are ordered by first use so vertex
+///            data is read front to back while drawing
+void ObjWriter::optimize(Mesh& mesh, IndexedMesh& out){
+  out = IndexedMesh();
+  out.objectNames = mesh.objectNames;
+  out.objectFirstFace = mesh.objectFirstFace;
+  out.materialLibraries = mesh.materialLibraries;
+  out.materialFirstFace = mesh.materialFirstFace;
+  for(size_t i=0; i<mesh.materialIndex.size(); i++)
+    out.materialNames.push_back(mesh.materials[mesh.materialIndex[i]].name);
+  AttributeTable positions(out.positions, 3);
+  AttributeTable texcoords(out.texcoords, 2);
+  AttributeTable normals(out.normals, 3);
+  bool textured = mesh.hasTextures();
+  bool normaled = mesh.hasNormals();
+
+  out.corners.reserve(mesh.faces.size()*12);
+  out.faceSizes.reserve(mesh.faces.size());
+  for(size_t i=0; i<mesh.faces.size(); i++){
+    Face& f = mesh.faces[i];
+    int n = f.isTriangle() ? 3 : 4;
+    Vertex v[4] = {f.getV1(), f.getV2(), f.getV3(), f.getV4()};
+    Texture t[4] = {f.getT1(), f.getT2(), f.getT3(), f.getT4()};
+    int normal = -1;
+    if(normaled)
+      normal = normals.get(f.getNormal().getX(), f.getNormal().getY(), f.getNormal().getZ());
+    for(int c=0; c<n; c++){
+      out.corners.push_back(positions.get(v[c].getX(), v[c].getY(), v[c].getZ()));
+      out.corners.push_back(textured ? texcoords.get(t[c].getX(), t[c].getY(), 0.f) : -1);
+      out.corners.push_back(normal);
+    }
+    out.faceSizes.push_back(n);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write an indexed mesh as an OBJ file
+/// @param filename File to write
+/// @param mesh Mesh to write
+/// @return Whether the file could be written
+bool ObjWriter::writeFile(std::string filename, IndexedMesh& mesh){
+  FILE* file = fopen(filename.c_str(), "w");
+  if(!file){
+    cout << "Could not write " << filename << endl;
+    return false;
+  }
+
+  fprintf(file, "# Written by spiderling\n");
+  for(size_t i=0; i<mesh.materialLibraries.size(); i++)
+    fprintf(file, "mtllib %s\n", mesh.materialLibraries[i].c_str());
+  for(size_t i=0; i<mesh.positions.size(); i+=3)
+    fprintf(file, "v %.9g %.9g %.9g\n", mesh.positions[i], mesh.positions[i+1], mesh.positions[i+2]);
+  for(size_t i=0; i<mesh.texcoords.size(); i+=2)
+    fprintf(file, "vt %.9g %.9g\n", mesh.texcoords[i], mesh.texcoords[i+1]);
+  for(size_t i=0; i<mesh.normals.size(); i+=3)
+    fprintf(file, "vn %.9g %.9g %.9g\n", mesh.normals[i], mesh.normals[i+1], mesh.normals[i+2]);
+
+  size_t object=0;
+  size_t material=0;
+  size_t corner=0;
+  for(size_t i=0; i<mesh.faceSizes.size(); i++){
+    while(object < mesh.objectFirstFace.size() && mesh.objectFirstFace[object] <= int(i))
+      fprintf(file, "o %s\n", mesh.objectNames[object++].c_str());
+    while(material < mesh.materialFirstFace.size() && mesh.materialFirstFace[material] <= int(i))
+      fprintf(file, "usemtl %s\n", mesh.materialNames[material++].c_str());
+
+    fputc('f', file);
+    for(int c=0; c<mesh.faceSizes[i]; c++, corner+=3){
+      int p = mesh.corners[corner]+1;
+      int t = mesh.corners[corner+1]+1;
+      int n = mesh.corners[corner+2]+1;
+      if(t>0 && n>0)
+        fprintf(file, " %d/%d/%d", p, t, n);
+      else if(n>0)
+        fprintf(file, " %d//%d", p, n);
+      else if(t>0)
+        fprintf(file, " %d/%d", p, t);
+      else
+        fprintf(file, " %d", p);
+    }
+    fputc('\n', file);
+  }
+
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
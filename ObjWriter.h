@@ -0,0 +1,36 @@
+// STL
+#ifndef OBJWRITER_H
+#define OBJWRITER_H
+
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Mesh with shared, deduplicated attributes referenced by index
+///
+/// corners holds three indices per face corner (position, texcoord, normal),
+/// with -1 for an attribute the mesh does not have.
+struct IndexedMesh{
+  std::vector<float> positions;
+  std::vector<float> texcoords;
+  std::vector<float> normals;
+  std::vector<int> corners;
+  std::vector<int> faceSizes;
+  std::vector<std::string> objectNames;
+  std::vector<int> objectFirstFace;
+  std::vector<std::string> materialLibraries;
+  std::vector<std::string> materialNames;
+  std::vector<int> materialFirstFace;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Writer for optimized Wavefront OBJ files
+class ObjWriter{
+
+public:
+  static void optimize(Mesh& mesh, IndexedMesh& out);
+  static bool writeFile(std::string filename, IndexedMesh& mesh);
+
+};
+#endif
@@ -0,0 +1,208 @@
+#include "OcclusionCuller.h"
+#include "Camera.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+using namespace std;
+
+namespace {
+
+  void transformPoint(const float m[16], float x, float y, float z, float out[4]){
+    for(int r=0; r<4; r++)
+      out[r] = m[r]*x + m[4+r]*y + m[8+r]*z + m[12+r];
+  }
+}
+
+OcclusionCuller::OcclusionCuller(){
+  width=0;
+  height=0;
+  occluderTriangles=0;
+  tested=0;
+  occluded=0;
+  outside=0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Clear the depth buffer for a new view
+/// @param viewProjectionMatrix Column major projection*modelview of the camera
+/// @param w Width of the depth buffer in pixels
+/// @param h Height of the depth buffer in pixels
+void OcclusionCuller::beginFrame(const float viewProjectionMatrix[16], int w, int h){
+  for(int i=0; i<16; i++)
+    viewProjection[i] = viewProjectionMatrix[i];
+  if(w != width || h != height){
+    width = w;
+    height = h;
+    levels.clear();
+    levelWidth.clear();
+    levelHeight.clear();
+    int lw = width, lh = height;
+    while(true){
+      levels.push_back(DepthLevel(size_t(lw)*lh));
+      levelWidth.push_back(lw);
+      levelHeight.push_back(lh);
+      if(lw == 1 && lh == 1)
+        break;
+      lw = std::max(1, (lw+1)/2);
+      lh = std::max(1, (lh+1)/2);
+    }
+  }
+  std::fill(levels[0].begin(), levels[0].end(), FLT_MAX);
+  occluderTriangles=0;
+  tested=0;
+  occluded=0;
+  outside=0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Rasterize the faces of an occluder into the depth buffer
+/// @param faces Faces of the occluding model
+/// @param transform Column major model to world matrix of this instance
+void OcclusionCuller::addOccluder(FaceList& faces, const float transform[16]){
+  float m[16];
+  Camera::multiply(viewProjection, transform, m);
+  for(size_t f=0; f<faces.size(); f++){
+    Face& face = faces[f];
+    Vertex v[4] = {face.getV1(), face.getV2(), face.getV3(), face.getV4()};
+    float clip[4][4];
+    int corners = face.isTriangle() ? 3 : 4;
+    for(int k=0; k<corners; k++)
+      transformPoint(m, v[k].getX(), v[k].getY(), v[k].getZ(), clip[k]);
+    rasterizeTriangle(clip);
+    if(corners == 4){
+      float second[3][4];
+      for(int a=0; a<4; a++){
+        second[0][a] = clip[0][a];
+        second[1][a] = clip[2][a];
+        second[2][a] = clip[3][a];
+      }
+      rasterizeTriangle(second);
+    }
+  }
+}
+
+//Keeps the nearest view distance at each covered pixel centre. Triangles
+//reaching behind the near plane are left out; missing occluders only make
+//the test more conservative.
+void OcclusionCuller::rasterizeTriangle(const float clip[3][4]){
+  float x[3], y[3], invW[3];
+  for(int k=0; k<3; k++){
+    if(clip[k][3] < Camera::NEAR_PLANE)
+      return;
+    invW[k] = 1.f/clip[k][3];
+    x[k] = (clip[k][0]*invW[k]*0.5f + 0.5f)*width;
+    y[k] = (clip[k][1]*invW[k]*0.5f + 0.5f)*height;
+  }
+  float area = (x[1]-x[0])*(y[2]-y[0]) - (x[2]-x[0])*(y[1]-y[0]);
+  if(std::fabs(area) < 1e-6f)
+    return;
+  occluderTriangles++;
+
+  int x0 = std::max(0, int(std::floor(std::min(x[0], std::min(x[1], x[2])))));
+  int x1 = std::min(width-1, int(std::ceil(std::max(x[0], std::max(x[1], x[2])))));
+  int y0 = std::max(0, int(std::floor(std::min(y[0], std::min(y[1], y[2])))));
+  int y1 = std::min(height-1, int(std::ceil(std::max(y[0], std::max(y[1], y[2])))));
+  if(x0 > x1 || y0 > y1)
+    return;
+
+  //Edge k is opposite vertex k; its function is area times the barycentric
+  //coordinate of k and steps by a constant per pixel
+  float sign = area > 0.f ? 1.f : -1.f;
+  float stepX[3], stepY[3], rowStart[3];
+  float cx = x0+0.5f, cy = y0+0.5f;
+  for(int k=0; k<3; k++){
+    int a = (k+1)%3, b = (k+2)%3;
+    stepX[k] = -(y[b]-y[a])*sign;
+    stepY[k] = (x[b]-x[a])*sign;
+    rowStart[k] = ((x[b]-x[a])*(cy-y[a]) - (y[b]-y[a])*(cx-x[a]))*sign;
+  }
+  float invArea = 1.f/std::fabs(area);
+  DepthLevel& depth = levels[0];
+  for(int py=y0; py<=y1; py++){
+    float e[3] = {rowStart[0], rowStart[1], rowStart[2]};
+    float* row = &depth[size_t(py)*width];
+    for(int px=x0; px<=x1; px++){
+      if(e[0] >= 0.f && e[1] >= 0.f && e[2] >= 0.f){
+        float w = 1.f/((e[0]*invW[0] + e[1]*invW[1] + e[2]*invW[2])*invArea);
+        if(w < row[px])
+          row[px] = w;
+      }
+      for(int k=0; k<3; k++)
+        e[k] += stepX[k];
+    }
+    for(int k=0; k<3; k++)
+      rowStart[k] += stepY[k];
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Build the farthest depth pyramid once every occluder has been added
+void OcclusionCuller::buildPyramid(){
+  for(size_t l=1; l<levels.size(); l++){
+    DepthLevel& below = levels[l-1];
+    DepthLevel& level = levels[l];
+    int bw = levelWidth[l-1], bh = levelHeight[l-1];
+    for(int j=0; j<levelHeight[l]; j++){
+      int j0 = 2*j, j1 = std::min(2*j+1, bh-1);
+      for(int i=0; i<levelWidth[l]; i++){
+        int i0 = 2*i, i1 = std::min(2*i+1, bw-1);
+        level[size_t(j)*levelWidth[l]+i] =
+          std::max(std::max(below[size_t(j0)*bw+i0], below[size_t(j0)*bw+i1]),
+                   std::max(below[size_t(j1)*bw+i0], below[size_t(j1)*bw+i1]));
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Test a world space bounding box against the pyramid
+/// @return False if the box is outside the view or behind the occluders
+///
+/// Boxes reaching behind the near plane are always visible.
+bool OcclusionCuller::isVisible(const float boundsMin[3], const float boundsMax[3]){
+  tested++;
+  float nearest = FLT_MAX;
+  float sx0 = FLT_MAX, sx1 = -FLT_MAX, sy0 = FLT_MAX, sy1 = -FLT_MAX;
+  for(int c=0; c<8; c++){
+    float clip[4];
+    transformPoint(viewProjection, c&1 ? boundsMax[0] : boundsMin[0],
+                   c&2 ? boundsMax[1] : boundsMin[1], c&4 ? boundsMax[2] : boundsMin[2], clip);
+    if(clip[3] < Camera::NEAR_PLANE)
+      return true;
+    nearest = std::min(nearest, clip[3]);
+    float sx = (clip[0]/clip[3]*0.5f + 0.5f)*width;
+    float sy = (clip[1]/clip[3]*0.5f + 0.5f)*height;
+    sx0 = std::min(sx0, sx);
+    sx1 = std::max(sx1, sx);
+    sy0 = std::min(sy0, sy);
+    sy1 = std::max(sy1, sy);
+  }
+  if(sx1 < 0.f || sy1 < 0.f || sx0 > width || sy0 > height){
+    outside++;
+    return false;
+  }
+
+  //Smallest level where the rectangle spans at most two texels each way
+  int x0 = std::max(0, int(sx0)), x1 = std::min(width-1, int(sx1));
+  int y0 = std::max(0, int(sy0)), y1 = std::min(height-1, int(sy1));
+  size_t l = 0;
+  while(l+1 < levels.size() && ((x1>>l)-(x0>>l) > 1 || (y1>>l)-(y0>>l) > 1))
+    l++;
+  float farthest = 0.f;
+  for(int j=y0>>l; j<=y1>>l; j++)
+    for(int i=x0>>l; i<=x1>>l; i++)
+      farthest = std::max(farthest, levels[l][size_t(j)*levelWidth[l]+i]);
+  if(nearest > farthest){
+    occluded++;
+    return false;
+  }
+  return true;
+}
+
+int OcclusionCuller::getWidth(){return width;};
+int OcclusionCuller::getHeight(){return height;};
+int OcclusionCuller::getLevelCount(){return levels.size();};
+int OcclusionCuller::getOccluderTriangles(){return occluderTriangles;};
+int OcclusionCuller::getTested(){return tested;};
+int OcclusionCuller::getOccluded(){return occluded;};
+int OcclusionCuller::getOutside(){return outside;};
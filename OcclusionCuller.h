@@ -0,0 +1,51 @@
+// STL
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <vector>
+#include "Mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Hierarchical depth buffer for occlusion culling on the CPU
+///
+/// Each frame a few large occluders are rasterized into a small depth buffer
+/// holding the view distance of the nearest surface per pixel. Each level of
+/// the pyramid built from it keeps the farthest of the four texels below, so
+/// a screen rectangle is tested against at most four texels. An object is
+/// occluded when the nearest corner of its bounding box is farther than all of
+/// them. Occluders are sampled at pixel centres, like the GPU does.
+class OcclusionCuller{
+
+public:
+  typedef TrackedVector<float, MEMORY_CACHE> DepthLevel;
+
+private:
+  int width;
+  int height;
+  float viewProjection[16];
+  std::vector<DepthLevel> levels;
+  std::vector<int> levelWidth;
+  std::vector<int> levelHeight;
+  int occluderTriangles;
+  int tested;
+  int occluded;
+  int outside;
+
+  void rasterizeTriangle(const float clip[3][4]);
+
+public:
+  OcclusionCuller();
+  void beginFrame(const float viewProjectionMatrix[16], int w, int h);
+  void addOccluder(FaceList& faces, const float transform[16]);
+  void buildPyramid();
+  bool isVisible(const float boundsMin[3], const float boundsMax[3]);
+  int getWidth();
+  int getHeight();
+  int getLevelCount();
+  int getOccluderTriangles();
+  int getTested();
+  int getOccluded();
+  int getOutside();
+
+};
+#endif
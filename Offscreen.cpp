@@ -0,0 +1,189 @@
+#include "Offscreen.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+using namespace std;
+
+// GL
+#if   defined(OSX)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#include <OpenGL/gl3.h>
+#elif defined(LINUX)
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+Offscreen::Offscreen(){
+  width=0;
+  height=0;
+  framebuffer=0;
+  colorBuffer=0;
+  depthBuffer=0;
+  waitSeconds=0.f;
+}
+
+Offscreen::~Offscreen(){
+  release();
+}
+
+void Offscreen::release(){
+  if(!pixelBuffers.empty())
+    glDeleteBuffers(pixelBuffers.size(), pixelBuffers.data());
+  pixelBuffers.clear();
+  if(framebuffer){
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+  }
+  framebuffer=0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Make a GL 3.3 context current without a window
+/// @param core False for a compatibility context, which also runs the fixed
+/// function pipeline
+/// @return Whether one could be made; false where EGL is not available
+bool Offscreen::createContext(bool core){
+#if defined(LINUX)
+  //Mesa can render with no display at all; other drivers want the default one
+  EGLDisplay display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+  EGLint major, minor;
+  if(display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)){
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+      return false;
+  }
+  if(!eglBindAPI(EGL_OPENGL_API))
+    return false;
+
+  EGLint configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                               EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config;
+  EGLint configs = 0;
+  eglChooseConfig(display, configAttributes, &config, 1, &configs);
+  EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                core ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT :
+                                EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT, EGL_NONE};
+  EGLContext context = eglCreateContext(display, configs ? config : EGL_NO_CONFIG_KHR,
+                                        EGL_NO_CONTEXT, contextAttributes);
+  if(context == EGL_NO_CONTEXT)
+    return false;
+  return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+#else
+  return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Create the framebuffer and the ring of pixel buffers
+/// @param w Width in pixels
+/// @param h Height in pixels
+/// @param ringSize Number of pixel buffers; 1 reads every frame back at once,
+/// 0 leaves out readback
+///
+/// Can be called again to change the size.
+bool Offscreen::initialize(int w, int h, int ringSize){
+  release();
+  width = w;
+  height = h;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glGenRenderbuffers(1, &colorBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+  glGenRenderbuffers(1, &depthBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+  if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+    cout << "Offscreen framebuffer incomplete" << endl;
+    return false;
+  }
+
+  pixelBuffers.resize(std::max(0, ringSize));
+  if(!pixelBuffers.empty())
+    glGenBuffers(pixelBuffers.size(), pixelBuffers.data());
+  for(size_t i=0; i<pixelBuffers.size(); i++){
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, size_t(width)*height*4, nullptr, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glViewport(0, 0, width, height);
+  return true;
+}
+
+void Offscreen::bind(){
+  bind(width, height);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draw into the bottom left w by h pixels of the framebuffer
+void Offscreen::bind(int w, int h){
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(0, 0, w, h);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Stretch the bottom left w by h pixels over the window, filtered
+/// @param w Width drawn
+/// @param h Height drawn
+/// @param windowWidth Width of the window
+/// @param windowHeight Height of the window
+///
+/// Leaves the window's framebuffer bound, with a viewport covering it.
+void Offscreen::present(int w, int h, int windowWidth, int windowHeight){
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, w, h, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT,
+                    w == windowWidth && h == windowHeight ? GL_NEAREST : GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, windowWidth, windowHeight);
+}
+
+int Offscreen::getWidth(){return width;};
+int Offscreen::getHeight(){return height;};
+int Offscreen::getRingSize(){return pixelBuffers.size();};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Queue a copy of the framebuffer into a pixel buffer; does not wait
+void Offscreen::startReadback(int slot){
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Copy a pixel buffer out once its readback is done
+/// @param slot Pixel buffer given to startReadback
+/// @param image Bottom row first RGBA image of the frame
+void Offscreen::finishReadback(int slot, Image& image){
+  using namespace std::chrono;
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  size_t bytes = size_t(width)*height*4;
+  image.width = width;
+  image.height = height;
+  image.pixels.resize(bytes);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+  const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+  if(mapped){
+    memcpy(image.pixels.data(), mapped, bytes);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  waitSeconds += duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+}
+
+float Offscreen::getWaitSeconds(){return waitSeconds;};
+
+#if   defined(OSX)
+#pragma clang diagnostic pop
+#endif
@@ -0,0 +1,48 @@
+// STL
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <vector>
+#include "Image.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Render target in a framebuffer object, read back through pixel buffers
+///
+/// Frames are drawn into the framebuffer and copied into the next pixel buffer
+/// of a ring with startReadback, which returns at once. finishReadback maps a
+/// buffer started ring size - 1 frames earlier, so the copy overlaps the frames
+/// drawn since. createContext makes a GL 3.3 core (or compatibility) context
+/// without a display (EGL on Linux); where that is not available a hidden
+/// window works too.
+/// present stretches a frame drawn into part of the framebuffer over the
+/// window, for rendering below window resolution.
+class Offscreen{
+
+private:
+  int width;
+  int height;
+  unsigned int framebuffer;
+  unsigned int colorBuffer;
+  unsigned int depthBuffer;
+  std::vector<unsigned int> pixelBuffers;
+  float waitSeconds;
+
+  void release();
+
+public:
+  Offscreen();
+  ~Offscreen();
+  static bool createContext(bool core = true);
+  bool initialize(int w, int h, int ringSize);
+  void bind();
+  void bind(int w, int h);
+  void present(int w, int h, int windowWidth, int windowHeight);
+  int getWidth();
+  int getHeight();
+  int getRingSize();
+  void startReadback(int slot);
+  void finishReadback(int slot, Image& image);
+  float getWaitSeconds();
+
+};
+#endif
@@ -0,0 +1,690 @@
+#include "PlyFile.h"
+#include "BinaryReader.h"
+#include "ObjWriter.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+using namespace std;
+
+namespace {
+
+  enum PlyType{
+    PLY_INT8,
+    PLY_UINT8,
+    PLY_INT16,
+    PLY_UINT16,
+    PLY_INT32,
+    PLY_UINT32,
+    PLY_FLOAT32,
+    PLY_FLOAT64,
+    PLY_TYPES
+  };
+
+  const char* typeNames[PLY_TYPES] = {"char", "uchar", "short", "ushort", "int", "uint", "float", "double"};
+  const char* sizedTypeNames[PLY_TYPES] = {"int8", "uint8", "int16", "uint16", "int32", "uint32", "float32", "float64"};
+  const size_t typeSizes[PLY_TYPES] = {1, 1, 2, 2, 4, 4, 4, 8};
+
+  //Bounds on counts from the file, checked before anything is sized by them;
+  //compressed files have no size to check records against, only the cap
+  const long long MAX_RECORDS = 1LL << 25;
+  const double MAX_LIST = 1 << 16;
+
+  int typeOf(const string& name){
+    for(int t=0; t<PLY_TYPES; t++)
+      if(name == typeNames[t] || name == sizedTypeNames[t])
+        return t;
+    return PLY_TYPES;
+  }
+
+  struct Property{
+    string name;
+    int type;
+    //Type of the count of a list property, PLY_TYPES for a single value
+    int countType;
+    //Offset in the record, for elements without lists
+    size_t offset;
+  };
+
+  struct Element{
+    string name;
+    size_t count;
+    vector<Property> properties;
+    //Bytes of a binary record, 0 if it holds a list
+    size_t stride;
+
+    int find(const char* property) const {
+      for(size_t p=0; p<properties.size(); p++)
+        if(properties[p].name == property)
+          return p;
+      return -1;
+    }
+  };
+
+  //One value of a record decoded by property, lists kept separately
+  struct Record{
+    vector<double> values;
+    vector<vector<double>> lists;
+  };
+
+  //A binary value in file order, swapped if memory uses the other one
+  double binaryValue(const char* p, int type, bool swap){
+    unsigned char b[8];
+    size_t n = typeSizes[type];
+    for(size_t i=0; i<n; i++)
+      b[i] = p[swap ? n-1-i : i];
+    switch(type){
+      case PLY_INT8:   {int8_t v; memcpy(&v, b, n); return v;}
+      case PLY_UINT8:  {uint8_t v; memcpy(&v, b, n); return v;}
+      case PLY_INT16:  {int16_t v; memcpy(&v, b, n); return v;}
+      case PLY_UINT16: {uint16_t v; memcpy(&v, b, n); return v;}
+      case PLY_INT32:  {int32_t v; memcpy(&v, b, n); return v;}
+      case PLY_UINT32: {uint32_t v; memcpy(&v, b, n); return v;}
+      case PLY_FLOAT32:{float v; memcpy(&v, b, n); return v;}
+      default:         {double v; memcpy(&v, b, n); return v;}
+    }
+  }
+
+  bool decodeBinary(BinaryReader& reader, Element& element, bool swap, Record& record){
+    for(size_t p=0; p<element.properties.size(); p++){
+      Property& property = element.properties[p];
+      if(property.countType == PLY_TYPES){
+        const char* data = reader.peek(typeSizes[property.type]);
+        if(!data)
+          return false;
+        record.values[p] = binaryValue(data, property.type, swap);
+        reader.skip(typeSizes[property.type]);
+        continue;
+      }
+      const char* data = reader.peek(typeSizes[property.countType]);
+      if(!data)
+        return false;
+      double listCount = binaryValue(data, property.countType, swap);
+      if(listCount < 0.0 || listCount > MAX_LIST)
+        return false;
+      size_t count = size_t(listCount);
+      reader.skip(typeSizes[property.countType]);
+      size_t size = typeSizes[property.type];
+      data = reader.peek(count*size);
+      if(!data)
+        return false;
+      record.lists[p].resize(count);
+      for(size_t i=0; i<count; i++)
+        record.lists[p][i] = binaryValue(data+i*size, property.type, swap);
+      reader.skip(count*size);
+    }
+    return true;
+  }
+
+  bool decodeAscii(BinaryReader& reader, Element& element, Record& record){
+    string line;
+    if(!reader.getline(line))
+      return false;
+    const char* p = line.c_str();
+    char* next;
+    for(size_t i=0; i<element.properties.size(); i++){
+      if(element.properties[i].countType == PLY_TYPES){
+        record.values[i] = strtod(p, &next);
+        if(next == p)
+          return false;
+        p = next;
+        continue;
+      }
+      double count = strtod(p, &next);
+      if(next == p || !(count >= 0.0 && count <= MAX_LIST))
+        return false;
+      p = next;
+      record.lists[i].resize(size_t(count));
+      for(size_t k=0; k<record.lists[i].size(); k++){
+        record.lists[i][k] = strtod(p, &next);
+        if(next == p)
+          return false;
+        p = next;
+      }
+    }
+    return true;
+  }
+
+  //Where each attribute of a vertex record is, or -1
+  struct VertexLayout{
+    int position[3];
+    int normal[3];
+    int texcoord[2];
+
+    VertexLayout(const Element& vertex){
+      const char* normalNames[3] = {"nx", "ny", "nz"};
+      const char* positionNames[3] = {"x", "y", "z"};
+      for(int a=0; a<3; a++){
+        position[a] = vertex.find(positionNames[a]);
+        normal[a] = vertex.find(normalNames[a]);
+      }
+      const char* texcoordNames[4][2] = {{"s", "t"}, {"u", "v"}, {"texture_u", "texture_v"},
+                                         {"texture_s", "texture_t"}};
+      texcoord[0] = texcoord[1] = -1;
+      for(int n=0; n<4 && texcoord[0] < 0; n++)
+        if(vertex.find(texcoordNames[n][0]) >= 0 && vertex.find(texcoordNames[n][1]) >= 0){
+          texcoord[0] = vertex.find(texcoordNames[n][0]);
+          texcoord[1] = vertex.find(texcoordNames[n][1]);
+        }
+    }
+
+    bool hasNormals() const {return normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0;}
+    bool hasTexcoords() const {return texcoord[0] >= 0;}
+  };
+
+  void storeVertex(Mesh& mesh, size_t i, const VertexLayout& layout, const double* values){
+    mesh.vertices[i].setX(values[layout.position[0]]);
+    mesh.vertices[i].setY(values[layout.position[1]]);
+    mesh.vertices[i].setZ(values[layout.position[2]]);
+    if(layout.hasNormals()){
+      mesh.normals[i].setX(values[layout.normal[0]]);
+      mesh.normals[i].setY(values[layout.normal[1]]);
+      mesh.normals[i].setZ(values[layout.normal[2]]);
+    }
+    if(layout.hasTexcoords()){
+      mesh.textures[i].setX(values[layout.texcoord[0]]);
+      mesh.textures[i].setY(values[layout.texcoord[1]]);
+      mesh.textures[i].setZ(0.f);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @brief Reads the vertex element, as one block when it is just positions
+  bool readVertices(BinaryReader& reader, Element& element, bool binary, bool swap, Mesh& mesh){
+    TRACE_ZONE("ply vertices");
+    VertexLayout layout(element);
+    if(layout.position[0] < 0 || layout.position[1] < 0 || layout.position[2] < 0){
+      cout << "PLY vertices have no x, y and z" << endl;
+      return false;
+    }
+    mesh.vertices.resize(element.count);
+    if(layout.hasNormals())
+      mesh.normals.resize(element.count);
+    if(layout.hasTexcoords())
+      mesh.textures.resize(element.count);
+
+    static_assert(sizeof(Vertex) == 3*sizeof(float), "Vertex must be three packed floats");
+    bool floats = true;
+    for(size_t p=0; p<element.properties.size(); p++)
+      floats = floats && element.properties[p].type == PLY_FLOAT32;
+    if(binary && !swap && element.stride == sizeof(Vertex) && floats &&
+       layout.position[0] == 0 && layout.position[1] == 1 && layout.position[2] == 2)
+      return reader.read(mesh.vertices.data(), element.count*sizeof(Vertex));
+
+    //Fixed offsets into each record, floats copied as they are
+    if(binary && element.stride > 0){
+      double values[64];
+      if(element.properties.size() > 64)
+        return false;
+      for(size_t i=0; i<element.count; i++){
+        const char* record = reader.peek(element.stride);
+        if(!record)
+          return false;
+        for(size_t p=0; p<element.properties.size(); p++){
+          Property& property = element.properties[p];
+          if(property.type == PLY_FLOAT32 && !swap){
+            float value;
+            memcpy(&value, record+property.offset, sizeof(value));
+            values[p] = value;
+          }
+          else
+            values[p] = binaryValue(record+property.offset, property.type, swap);
+        }
+        storeVertex(mesh, i, layout, values);
+        reader.skip(element.stride);
+      }
+      return true;
+    }
+
+    Record record;
+    record.values.resize(element.properties.size());
+    record.lists.resize(element.properties.size());
+    for(size_t i=0; i<element.count; i++){
+      if(binary ? !decodeBinary(reader, element, swap, record) : !decodeAscii(reader, element, record))
+        return false;
+      storeVertex(mesh, i, layout, record.values.data());
+    }
+    return true;
+  }
+
+  //One face from up to four corners of a polygon
+  void addFace(Mesh& mesh, const int* index, const int* corner, int n, const float* texcoords,
+               Normal normal, bool vertexTexcoords){
+    Face face;
+    Vertex v[4];
+    Texture t[4];
+    for(int k=0; k<n; k++){
+      v[k] = mesh.vertices[index[corner[k]]];
+      if(texcoords)
+        t[k] = Texture(texcoords[2*corner[k]], texcoords[2*corner[k]+1], 0.f);
+      else if(vertexTexcoords)
+        t[k] = mesh.textures[index[corner[k]]];
+    }
+    face.setV1(v[0]);
+    face.setV2(v[1]);
+    face.setV3(v[2]);
+    if(n == 4)
+      face.setV4(v[3]);
+    if(texcoords || vertexTexcoords){
+      face.setT1(t[0]);
+      face.setT2(t[1]);
+      face.setT3(t[2]);
+      if(n == 4)
+        face.setT4(t[3]);
+    }
+    face.setNormal(normal);
+    face.setIsTriangle(n == 3);
+    mesh.faces.push_back(face);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @brief Add a polygon by vertex index, split into a fan past four corners
+  /// @param texcoords Two per corner from the face, or null
+  /// @param normal Normal from the face, or null for the first corner's
+  bool addPolygon(Mesh& mesh, const int* index, int corners, const float* texcoords,
+                  const Normal* normal, bool vertexNormals, bool vertexTexcoords){
+    int vertexCount = mesh.vertices.size();
+    for(int c=0; c<corners; c++)
+      if(index[c] < 0 || index[c] >= vertexCount)
+        return false;
+    if(corners < 3)
+      return true;
+    Normal faceNormal;
+    faceNormal.setX(0.f);
+    faceNormal.setY(0.f);
+    faceNormal.setZ(0.f);
+    if(normal)
+      faceNormal = *normal;
+    else if(vertexNormals)
+      faceNormal = mesh.normals[index[0]];
+    if(corners <= 4){
+      int corner[4] = {0, 1, 2, 3};
+      addFace(mesh, index, corner, corners, texcoords, faceNormal, vertexTexcoords);
+      return true;
+    }
+    for(int c=1; c+1<corners; c++){
+      int corner[3] = {0, c, c+1};
+      addFace(mesh, index, corner, 3, texcoords, faceNormal, vertexTexcoords);
+    }
+    return true;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  /// @brief Read the face element, walking binary triangle lists in place
+  bool readFaces(BinaryReader& reader, Element& element, bool binary, bool swap,
+                 bool vertexNormals, bool vertexTexcoords, Mesh& mesh){
+    TRACE_ZONE("ply faces");
+    int indices = element.find("vertex_indices");
+    if(indices < 0)
+      indices = element.find("vertex_index");
+    if(indices < 0 || element.properties[indices].countType == PLY_TYPES){
+      cout << "PLY faces have no vertex_indices list" << endl;
+      return false;
+    }
+    int normal[3] = {element.find("nx"), element.find("ny"), element.find("nz")};
+    bool faceNormals = normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0;
+    int texcoord = element.find("texcoord");
+    if(texcoord >= 0 && element.properties[texcoord].countType == PLY_TYPES)
+      texcoord = -1;
+    //A triangle takes at least 13 bytes in binary and 6 in ASCII, so the
+    //header cannot make a small or compressed file reserve more than it holds
+    size_t plausible = reader.getSize() >= 0 ? size_t(reader.getSize())/(binary ? 13 : 6) : 0;
+    size_t reserved = min(element.count, plausible);
+    mesh.faces.reserve(reserved);
+    if(faceNormals)
+      mesh.normals.reserve(mesh.normals.size()+reserved);
+    if(texcoord >= 0)
+      mesh.textures.reserve(mesh.textures.size()+3*reserved);
+
+    //Float values and lists of ints or floats with uchar counts are copied
+    //out of the buffer as they are
+    bool direct = binary && !swap;
+    for(size_t p=0; p<element.properties.size(); p++){
+      Property& property = element.properties[p];
+      if(property.countType == PLY_TYPES)
+        direct = direct && property.type == PLY_FLOAT32;
+      else
+        direct = direct && property.countType == PLY_UINT8 &&
+                 (property.type == PLY_INT32 || property.type == PLY_UINT32 || property.type == PLY_FLOAT32);
+    }
+    if(direct){
+      int index[256];
+      float texcoords[256];
+      vector<float> values(element.properties.size());
+      for(size_t f=0; f<element.count; f++){
+        int corners = 0, texcoordCount = 0;
+        for(size_t p=0; p<element.properties.size(); p++){
+          const char* data = reader.peek(element.properties[p].countType == PLY_TYPES ? 4 : 1);
+          if(!data)
+            return false;
+          if(element.properties[p].countType == PLY_TYPES){
+            memcpy(&values[p], data, sizeof(float));
+            reader.skip(sizeof(float));
+            continue;
+          }
+          int count = static_cast<unsigned char>(data[0]);
+          data = reader.peek(1+count*4);
+          if(!data)
+            return false;
+          if(int(p) == indices){
+            memcpy(index, data+1, count*sizeof(int));
+            corners = count;
+          }
+          else if(int(p) == texcoord && count <= 256){
+            memcpy(texcoords, data+1, count*sizeof(float));
+            texcoordCount = count;
+          }
+          reader.skip(1+count*4);
+        }
+        const float* faceTexcoords = nullptr;
+        if(texcoord >= 0 && texcoordCount == 2*corners){
+          faceTexcoords = texcoords;
+          for(int c=0; c<corners; c++)
+            mesh.textures.push_back(Texture(texcoords[2*c], texcoords[2*c+1], 0.f));
+        }
+        Normal faceNormal;
+        if(faceNormals){
+          faceNormal.setX(values[normal[0]]);
+          faceNormal.setY(values[normal[1]]);
+          faceNormal.setZ(values[normal[2]]);
+          mesh.normals.push_back(faceNormal);
+        }
+        if(!addPolygon(mesh, index, corners, faceTexcoords, faceNormals ? &faceNormal : nullptr,
+                       vertexNormals, vertexTexcoords))
+          return false;
+      }
+      return true;
+    }
+
+    Record record;
+    record.values.resize(element.properties.size());
+    record.lists.resize(element.properties.size());
+    vector<int> index;
+    vector<float> texcoords;
+    for(size_t f=0; f<element.count; f++){
+      if(binary ? !decodeBinary(reader, element, swap, record) : !decodeAscii(reader, element, record))
+        return false;
+      vector<double>& corners = record.lists[indices];
+      index.assign(corners.begin(), corners.end());
+      const float* faceTexcoords = nullptr;
+      if(texcoord >= 0 && record.lists[texcoord].size() == 2*corners.size()){
+        texcoords.assign(record.lists[texcoord].begin(), record.lists[texcoord].end());
+        faceTexcoords = texcoords.data();
+        for(size_t c=0; c<corners.size(); c++)
+          mesh.textures.push_back(Texture(texcoords[2*c], texcoords[2*c+1], 0.f));
+      }
+      Normal faceNormal;
+      if(faceNormals){
+        faceNormal.setX(record.values[normal[0]]);
+        faceNormal.setY(record.values[normal[1]]);
+        faceNormal.setZ(record.values[normal[2]]);
+        mesh.normals.push_back(faceNormal);
+      }
+      if(!addPolygon(mesh, index.data(), index.size(), faceTexcoords, faceNormals ? &faceNormal : nullptr,
+                     vertexNormals, vertexTexcoords))
+        return false;
+    }
+    return true;
+  }
+
+  bool skipElement(BinaryReader& reader, Element& element, bool binary, bool swap){
+    if(binary && element.stride > 0){
+      for(size_t i=0; i<element.count; i++){
+        if(!reader.peek(element.stride))
+          return false;
+        reader.skip(element.stride);
+      }
+      return true;
+    }
+    Record record;
+    record.values.resize(element.properties.size());
+    record.lists.resize(element.properties.size());
+    for(size_t i=0; i<element.count; i++)
+      if(binary ? !decodeBinary(reader, element, swap, record) : !decodeAscii(reader, element, record))
+        return false;
+    return true;
+  }
+
+  //Bytes of a value in little endian order
+  template<typename T>
+  void append(vector<char>& out, T value){
+    char bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    if(!BinaryReader::isLittleEndian())
+      for(size_t i=0; i<sizeof(T)/2; i++)
+        std::swap(bytes[i], bytes[sizeof(T)-1-i]);
+    out.insert(out.end(), bytes, bytes+sizeof(T));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse a PLY file into a mesh
+/// @param filename File to read, optionally .gz or .zst compressed
+/// @param mesh Mesh the vertices, normals, textures and faces are added to
+/// @return Whether the file could be read
+bool PlyFile::readFile(std::string filename, Mesh& mesh){
+  TRACE_ZONE("parse ply");
+  BinaryReader reader;
+  if(!reader.open(filename))
+    return false;
+
+  string line;
+  if(!reader.getline(line) || line != "ply"){
+    cout << filename << " is not a PLY file" << endl;
+    return false;
+  }
+  bool binary = false, swap = false;
+  vector<Element> elements;
+  while(true){
+    if(!reader.getline(line)){
+      cout << filename << " ends in its header" << endl;
+      return false;
+    }
+    istringstream in(line);
+    string keyword;
+    in >> keyword;
+    if(keyword == "end_header")
+      break;
+    if(keyword == "format"){
+      string format;
+      in >> format;
+      binary = format != "ascii";
+      if(binary && format != "binary_little_endian" && format != "binary_big_endian"){
+        cout << filename << " has unknown PLY format " << format << endl;
+        return false;
+      }
+      swap = binary && (format == "binary_little_endian") != BinaryReader::isLittleEndian();
+    }
+    else if(keyword == "element"){
+      Element element;
+      long long count = -1;
+      in >> element.name >> count;
+      if(!in || count < 0 || count > MAX_RECORDS){
+        cout << filename << " has a bad count for element " << element.name << endl;
+        return false;
+      }
+      element.count = count;
+      element.stride = 0;
+      elements.push_back(element);
+    }
+    else if(keyword == "property" && !elements.empty()){
+      Property property;
+      string type;
+      in >> type;
+      property.countType = PLY_TYPES;
+      if(type == "list"){
+        string countType;
+        in >> countType >> type;
+        property.countType = typeOf(countType);
+        if(property.countType == PLY_TYPES){
+          cout << filename << " has unknown PLY type " << countType << endl;
+          return false;
+        }
+      }
+      property.type = typeOf(type);
+      in >> property.name;
+      if(property.type == PLY_TYPES){
+        cout << filename << " has unknown PLY type " << type << endl;
+        return false;
+      }
+      elements.back().properties.push_back(property);
+    }
+  }
+  for(size_t e=0; e<elements.size(); e++){
+    size_t offset = 0;
+    bool fixed = true;
+    for(size_t p=0; p<elements[e].properties.size(); p++){
+      elements[e].properties[p].offset = offset;
+      offset += typeSizes[elements[e].properties[p].type];
+      fixed = fixed && elements[e].properties[p].countType == PLY_TYPES;
+    }
+    elements[e].stride = fixed ? offset : 0;
+  }
+
+  //Every record takes at least its count bytes and single values in binary,
+  //or a digit and a separator per property in ASCII
+  if(reader.getSize() >= 0){
+    double least = 0.0;
+    for(size_t e=0; e<elements.size(); e++){
+      size_t bytes = 0;
+      for(size_t p=0; p<elements[e].properties.size(); p++){
+        Property& property = elements[e].properties[p];
+        bytes += binary ? typeSizes[property.countType == PLY_TYPES ? property.type : property.countType] : 2;
+      }
+      least += double(elements[e].count)*bytes;
+    }
+    if(least > reader.getSize()){
+      cout << filename << " is too short for the element counts in its header" << endl;
+      return false;
+    }
+  }
+
+  bool haveVertices = false, vertexNormals = false, vertexTexcoords = false;
+  for(size_t e=0; e<elements.size(); e++){
+    Element& element = elements[e];
+    bool ok;
+    if(element.name == "vertex"){
+      ok = readVertices(reader, element, binary, swap, mesh);
+      haveVertices = true;
+      vertexNormals = mesh.hasNormals();
+      vertexTexcoords = mesh.hasTextures();
+    }
+    else if(element.name == "face"){
+      if(!haveVertices){
+        cout << filename << " has faces before vertices" << endl;
+        return false;
+      }
+      ok = readFaces(reader, element, binary, swap, vertexNormals, vertexTexcoords, mesh);
+    }
+    else
+      ok = skipElement(reader, element, binary, swap);
+    if(!ok){
+      cout << filename << " has a broken " << element.name << " element" << endl;
+      return false;
+    }
+  }
+  return reader.finish();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write a mesh as a PLY file
+/// @param filename File to write
+/// @param mesh Mesh to write; positions shared by faces are written once
+/// @param binary Little endian binary if true, ASCII otherwise
+/// @return Whether the file could be written
+bool PlyFile::writeFile(std::string filename, Mesh& mesh, bool binary){
+  TRACE_ZONE("write ply");
+  IndexedMesh indexed;
+  ObjWriter::optimize(mesh, indexed);
+  FILE* file = fopen(filename.c_str(), binary ? "wb" : "w");
+  if(!file){
+    cout << "Could not write " << filename << endl;
+    return false;
+  }
+  bool normals = mesh.hasNormals(), textures = mesh.hasTextures();
+  size_t vertexCount = indexed.positions.size()/3;
+  fprintf(file, "ply\nformat %s 1.0\ncomment Written by spiderling\n",
+          binary ? "binary_little_endian" : "ascii");
+  fprintf(file, "element vertex %zu\nproperty float x\nproperty float y\nproperty float z\n", vertexCount);
+  fprintf(file, "element face %zu\nproperty list uchar int vertex_indices\n", indexed.faceSizes.size());
+  if(normals)
+    fprintf(file, "property float nx\nproperty float ny\nproperty float nz\n");
+  if(textures)
+    fprintf(file, "property list uchar float texcoord\n");
+  fprintf(file, "end_header\n");
+
+  if(binary){
+    vector<char> out;
+    out.reserve(1 << 20);
+    if(BinaryReader::isLittleEndian())
+      fwrite(indexed.positions.data(), sizeof(float), indexed.positions.size(), file);
+    else{
+      for(size_t i=0; i<indexed.positions.size(); i++)
+        append(out, indexed.positions[i]);
+      fwrite(out.data(), 1, out.size(), file);
+      out.clear();
+    }
+    size_t corner = 0;
+    for(size_t f=0; f<indexed.faceSizes.size(); f++){
+      int n = indexed.faceSizes[f];
+      out.push_back(char(n));
+      for(int c=0; c<n; c++)
+        append(out, int32_t(indexed.corners[3*(corner+c)]));
+      if(normals){
+        int normal = indexed.corners[3*corner+2];
+        for(int a=0; a<3; a++)
+          append(out, indexed.normals[3*normal+a]);
+      }
+      if(textures){
+        out.push_back(char(2*n));
+        for(int c=0; c<n; c++){
+          int texcoord = indexed.corners[3*(corner+c)+1];
+          append(out, indexed.texcoords[2*texcoord]);
+          append(out, indexed.texcoords[2*texcoord+1]);
+        }
+      }
+      corner += n;
+      if(out.size() >= (1 << 20)){
+        fwrite(out.data(), 1, out.size(), file);
+        out.clear();
+      }
+    }
+    fwrite(out.data(), 1, out.size(), file);
+  }
+  else{
+    for(size_t v=0; v<vertexCount; v++)
+      fprintf(file, "%.9g %.9g %.9g\n", indexed.positions[3*v], indexed.positions[3*v+1],
+              indexed.positions[3*v+2]);
+    size_t corner = 0;
+    for(size_t f=0; f<indexed.faceSizes.size(); f++){
+      int n = indexed.faceSizes[f];
+      fprintf(file, "%d", n);
+      for(int c=0; c<n; c++)
+        fprintf(file, " %d", indexed.corners[3*(corner+c)]);
+      if(normals){
+        int normal = indexed.corners[3*corner+2];
+        fprintf(file, " %.9g %.9g %.9g", indexed.normals[3*normal], indexed.normals[3*normal+1],
+                indexed.normals[3*normal+2]);
+      }
+      if(textures){
+        fprintf(file, " %d", 2*n);
+        for(int c=0; c<n; c++){
+          int texcoord = indexed.corners[3*(corner+c)+1];
+          fprintf(file, " %.9g %.9g", indexed.texcoords[2*texcoord], indexed.texcoords[2*texcoord+1]);
+        }
+      }
+      fprintf(file, "\n");
+      corner += n;
+    }
+  }
+  bool ok = !ferror(file);
+  fclose(file);
+  if(!ok)
+    cout << "Could not write " << filename << endl;
+  return ok;
+}
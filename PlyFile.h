@@ -0,0 +1,25 @@
+// STL
+#ifndef PLYFILE_H
+#define PLYFILE_H
+
+#include <string>
+#include "Mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reader and writer for Stanford PLY files, binary or ASCII
+///
+/// Reads vertex positions, vertex normals and texture coordinates (s/t or u/v)
+/// and faces of any size, split into triangles past four corners, with
+/// optional face normals (nx, ny, nz) and corner texture coordinates
+/// (texcoord). Binary vertex blocks holding just float positions are read
+/// straight into the mesh; other binary layouts are read at fixed offsets.
+/// Faces must follow vertices. Writes positions shared between faces, face
+/// normals and corner texture coordinates, so a mesh read back is the same.
+class PlyFile{
+
+public:
+  static bool readFile(std::string filename, Mesh& mesh);
+  static bool writeFile(std::string filename, Mesh& mesh, bool binary);
+
+};
+#endif
@@ -0,0 +1,89 @@
+// STL
+#ifndef RENDERPACKET_H
+#define RENDERPACKET_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "DrawKernels.h"
+#include "MeshStore.h"
+#include "ShaderRenderer.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A loaded model: its geometry and the materials it is drawn with
+///
+/// Every load builds a new Model. Once it has been put in a render packet it
+/// is never changed again, so the simulation and render threads can both read
+/// it without locking; it is freed with the last packet that refers to it.
+/// The geometry may be shared with other models loaded with the same content;
+/// materials come from the model's own file. The fixed function pipeline
+/// draws each render mode with the kernel picked for it at load time. A model
+/// built from a file counts itself in its geometry's models while it lives.
+struct Model{
+  std::string name;
+  std::shared_ptr<Geometry> geometry;
+  std::vector<Material> materials;
+  std::vector<int> materialTextures;
+  int triangles;
+  DrawKernel kernels[RENDER_MODES];
+  bool counted;
+
+  Model() : geometry(std::make_shared<Geometry>()), triangles(0), counted(false) {
+    for(int mode=0; mode<RENDER_MODES; mode++)
+      kernels[mode] = DrawKernels::forMode(false, false, false, RenderMode(mode));
+  }
+  ~Model(){
+    if(counted)
+      geometry->models--;
+  }
+  Model(const Model&) = delete;
+  Model& operator=(const Model&) = delete;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief A copy of a model placed in a scene of several objects
+///
+/// transform is column major, model to world; the bounds are the model's
+/// bounding box carried through it, in world space.
+struct SceneInstance{
+  std::shared_ptr<Model> model;
+  float transform[16];
+  float boundsMin[3];
+  float boundsMax[3];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Everything the render side needs to draw one frame
+///
+/// Built by the simulation thread from the input it has applied so far and
+/// read, unchanged, by the render side. visibleClusters is the result of
+/// meshlet culling for this packet's camera and drawnTriangles the triangles
+/// in them; the shared meshlets are not written once built. inputFrame is the
+/// frame the newest applied input was queued in, or -1 before any.
+struct RenderPacket{
+  int sequence;
+  int inputFrame;
+  float theta;
+  float color[3];
+  float background[4];
+  float pointSize;
+  float lineSize;
+  unsigned short lineStyle;
+  RenderMode mode;
+  bool featureEdgesOnly;
+  bool clusterCulling;
+  bool showStats;
+  bool dynamicResolution;
+  bool quit;
+  int pickedFace;
+  std::shared_ptr<Model> model;
+  std::vector<int> visibleClusters;
+  int drawnTriangles;
+
+  RenderPacket() : sequence(0), inputFrame(-1), theta(0.f), color{0.5f, 0.5f, 0.5f},
+                   background{0.f, 0.f, 0.f, 0.f}, pointSize(1.f), lineSize(1.f),
+                   lineStyle(0xFFFF), mode(RENDER_SOLID), featureEdgesOnly(false),
+                   clusterCulling(true), showStats(false), dynamicResolution(false), quit(false),
+                   pickedFace(-1), drawnTriangles(0) {}
+};
+#endif
@@ -0,0 +1,355 @@
+#include "ShaderRenderer.h"
+#include "Camera.h"
+#include "Memory.h"
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+// GL
+#if   defined(OSX)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#include <OpenGL/gl3.h>
+#elif defined(LINUX)
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+namespace {
+
+  const char* vertexSource =
+    "#version 330 core\n"
+    "layout(location=0) in vec3 position;\n"
+    "layout(location=1) in vec3 normal;\n"
+    "layout(location=2) in vec3 barycentric;\n"
+    "layout(location=3) in vec2 texcoord;\n"
+    "uniform mat4 modelView;\n"
+    "uniform mat4 projection;\n"
+    "uniform float pointSize;\n"
+    "out vec3 eyeNormal;\n"
+    "out vec3 bary;\n"
+    "out vec2 uv;\n"
+    "void main(){\n"
+    "  eyeNormal = mat3(modelView)*normal;\n"
+    "  bary = barycentric;\n"
+    "  uv = texcoord;\n"
+    "  gl_PointSize = pointSize;\n"
+    "  gl_Position = projection*modelView*vec4(position, 1.0);\n"
+    "}\n";
+
+  // Lighting matches GL_COLOR_MATERIAL with the default 0.2 global ambient,
+  // a 0.2 light ambient and 0.8 diffuse. mode 1 is wireframe: fragments
+  // further than half the line width from an edge are discarded, and the
+  // 16 bit stipple pattern is indexed by pixels along the nearest edge.
+  // mode 2 is points, which carry no normal and are drawn unlit. Textured
+  // materials replace the flat colour with the diffuse map.
+  const char* fragmentSource =
+    "#version 330 core\n"
+    "uniform vec3 color;\n"
+    "uniform vec3 lightDirection;\n"
+    "uniform int mode;\n"
+    "uniform float lineWidth;\n"
+    "uniform int lineStyle;\n"
+    "uniform int textured;\n"
+    "uniform sampler2D diffuseMap;\n"
+    "in vec3 eyeNormal;\n"
+    "in vec3 bary;\n"
+    "in vec2 uv;\n"
+    "out vec4 fragColor;\n"
+    "void main(){\n"
+    "  if(mode == 1){\n"
+    "    vec3 d = bary/max(fwidth(bary), vec3(1e-6));\n"
+    "    int edge = d.x < d.y ? (d.x < d.z ? 0 : 2) : (d.y < d.z ? 1 : 2);\n"
+    "    if(d[edge] > 0.5*lineWidth)\n"
+    "      discard;\n"
+    "    float along = bary[(edge+1)%3];\n"
+    "    int bit = int(along/max(fwidth(along), 1e-6)) % 16;\n"
+    "    if(((lineStyle >> bit) & 1) == 0)\n"
+    "      discard;\n"
+    "  }\n"
+    "  if(mode == 2){\n"
+    "    fragColor = vec4(color, 1.0);\n"
+    "    return;\n"
+    "  }\n"
+    "  vec3 base = textured == 1 ? texture(diffuseMap, uv).rgb : color;\n"
+    "  float diffuse = max(dot(normalize(eyeNormal), lightDirection), 0.0);\n"
+    "  fragColor = vec4(base*min(0.4 + 0.8*diffuse, 1.0), 1.0);\n"
+    "}\n";
+
+  void pushVertex(vector<float>& out, Vertex p, const float n[3], float b0, float b1, float b2,
+                  Texture t){
+    out.push_back(p.getX());
+    out.push_back(p.getY());
+    out.push_back(p.getZ());
+    out.push_back(n[0]);
+    out.push_back(n[1]);
+    out.push_back(n[2]);
+    out.push_back(b0);
+    out.push_back(b1);
+    out.push_back(b2);
+    out.push_back(t.getX());
+    out.push_back(t.getY());
+  }
+}
+
+ShaderRenderer::ShaderRenderer(){
+  program=0;
+  vao=0;
+  vbo=0;
+  vertexCount=0;
+  pointVao=0;
+  pointVbo=0;
+  pointCount=0;
+  gpuBytes=0;
+  useRanges=false;
+  for(int i=0; i<16; i++)
+    transform[i] = i%5 == 0 ? 1.f : 0.f;
+}
+
+unsigned int ShaderRenderer::compile(unsigned int type, const char* source){
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+  GLint ok;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if(!ok){
+    char log[1024];
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    cout << "Shader compile failed: " << log << endl;
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Compile the program and create the vertex array
+/// @return Whether the path is usable; needs a current 3.3 core context
+bool ShaderRenderer::initialize(){
+  GLuint vs = compile(GL_VERTEX_SHADER, vertexSource);
+  GLuint fs = compile(GL_FRAGMENT_SHADER, fragmentSource);
+  if(vs==0 || fs==0)
+    return false;
+
+  program = glCreateProgram();
+  glAttachShader(program, vs);
+  glAttachShader(program, fs);
+  glLinkProgram(program);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  GLint ok;
+  glGetProgramiv(program, GL_LINK_STATUS, &ok);
+  if(!ok){
+    char log[1024];
+    glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+    cout << "Shader link failed: " << log << endl;
+    return false;
+  }
+
+  uModelView = glGetUniformLocation(program, "modelView");
+  uProjection = glGetUniformLocation(program, "projection");
+  uColor = glGetUniformLocation(program, "color");
+  uLightDirection = glGetUniformLocation(program, "lightDirection");
+  uMode = glGetUniformLocation(program, "mode");
+  uLineWidth = glGetUniformLocation(program, "lineWidth");
+  uLineStyle = glGetUniformLocation(program, "lineStyle");
+  uPointSize = glGetUniformLocation(program, "pointSize");
+  uTextured = glGetUniformLocation(program, "textured");
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "diffuseMap"), 0);
+  glUseProgram(0);
+
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &vbo);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  GLsizei stride = 11*sizeof(float);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3*sizeof(float)));
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(6*sizeof(float)));
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void*)(9*sizeof(float)));
+
+  glGenVertexArrays(1, &pointVao);
+  glGenBuffers(1, &pointVbo);
+  glBindVertexArray(pointVao);
+  glBindBuffer(GL_ARRAY_BUFFER, pointVbo);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+  glBindVertexArray(0);
+
+  glEnable(GL_PROGRAM_POINT_SIZE);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Upload the faces as flat shaded triangles
+/// @param faces Faces of the model
+/// @param fileNormals Use the normals from the file instead of computing them
+/// @param meshlets Clusters of the faces, which set the triangle order
+/// @param textured Whether the faces carry texture coordinates
+///
+/// Quads become two triangles; the shared diagonal gets a barycentric
+/// coordinate of 1 on both triangles so the wireframe never draws it.
+void ShaderRenderer::upload(FaceList& faces, bool fileNormals, bool textured, Meshlets& meshlets){
+  static const float triangleBary[9] = {1.f,0.f,0.f, 0.f,1.f,0.f, 0.f,0.f,1.f};
+  static const float quadBary[2][9] = {{1.f,1.f,0.f, 0.f,1.f,0.f, 0.f,1.f,1.f},
+                                       {1.f,0.f,1.f, 0.f,1.f,1.f, 0.f,0.f,1.f}};
+  Texture none;
+  none.setX(0.f);
+  none.setY(0.f);
+  vector<float> data;
+  data.reserve(meshlets.getTriangleCount()*3*11);
+  for(int t=0; t<meshlets.getTriangleCount(); t++){
+    Face& face = faces[meshlets.getFace(t)];
+    int half = meshlets.getHalf(t);
+    Vertex a = face.getV1(), b = face.getV2(), c = face.getV3();
+    float n[3];
+    if(fileNormals){
+      n[0] = face.getNormal().getX();
+      n[1] = face.getNormal().getY();
+      n[2] = face.getNormal().getZ();
+    }
+    else{
+      float u[3] = {b.getX()-a.getX(), b.getY()-a.getY(), b.getZ()-a.getZ()};
+      float w[3] = {c.getX()-a.getX(), c.getY()-a.getY(), c.getZ()-a.getZ()};
+      n[0] = u[1]*w[2]-u[2]*w[1];
+      n[1] = u[2]*w[0]-u[0]*w[2];
+      n[2] = u[0]*w[1]-u[1]*w[0];
+    }
+
+    Vertex p[3];
+    Texture uv[3] = {face.getT1(), half ? face.getT3() : face.getT2(), half ? face.getT4() : face.getT3()};
+    Meshlets::corners(face, half, p);
+    const float* bary = face.isTriangle() ? triangleBary : quadBary[half];
+    for(int k=0; k<3; k++)
+      pushVertex(data, p[k], n, bary[3*k], bary[3*k+1], bary[3*k+2],
+                 textured ? uv[k] : none);
+  }
+
+  vertexCount = data.size()/11;
+  MemoryTracker::release(MEMORY_GPU, gpuBytes);
+  gpuBytes = data.size()*sizeof(float);
+  MemoryTracker::record(MEMORY_GPU, gpuBytes);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, data.size()*sizeof(float), data.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Upload the unique points drawn in point mode
+/// @param points Packed xyz positions
+/// @param count Number of points
+void ShaderRenderer::uploadPoints(const float* points, int count){
+  MemoryTracker::release(MEMORY_GPU, size_t(pointCount)*3*sizeof(float));
+  pointCount = count;
+  MemoryTracker::record(MEMORY_GPU, size_t(pointCount)*3*sizeof(float));
+  glBindBuffer(GL_ARRAY_BUFFER, pointVbo);
+  glBufferData(GL_ARRAY_BUFFER, count*3*sizeof(float), points, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Limit solid drawing to some meshlets
+/// @param meshlets Meshlets the model was uploaded with
+/// @param visible Meshlets to draw, in increasing order
+///
+/// Neighbouring meshlets of the same material are merged into one range.
+void ShaderRenderer::setClusters(Meshlets& meshlets, const std::vector<int>& visible){
+  rangeFirst.clear();
+  rangeCount.clear();
+  rangeMaterial.clear();
+  for(size_t i=0; i<visible.size(); i++){
+    Meshlet& m = meshlets.getMeshlet(visible[i]);
+    if(!rangeFirst.empty() && rangeFirst.back()+rangeCount.back() == 3*m.firstTriangle &&
+       rangeMaterial.back() == m.material)
+      rangeCount.back() += 3*m.triangleCount;
+    else{
+      rangeFirst.push_back(3*m.firstTriangle);
+      rangeCount.push_back(3*m.triangleCount);
+      rangeMaterial.push_back(m.material);
+    }
+  }
+  useRanges=true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Textures to draw each material with
+/// @param textures GL texture per material index, 0 for an untextured one
+void ShaderRenderer::setTextures(const std::vector<unsigned int>& textures){
+  materialTextures = textures;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Place the model in the world for the draws that follow
+/// @param modelToWorld Column major matrix of a rotation, uniform scale and
+/// translation, so normals can share it
+void ShaderRenderer::setTransform(const float modelToWorld[16]){
+  for(int i=0; i<16; i++)
+    transform[i] = modelToWorld[i];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draw the uploaded model from the orbit camera
+void ShaderRenderer::draw(float theta, int width, int height, RenderMode mode,
+                          const float color[3], float lineWidth, float pointSize,
+                          unsigned short lineStyle){
+  float modelView[16], projection[16];
+  Camera::modelview(theta, modelView);
+  Camera::multiply(modelView, transform, modelView);
+  Camera::projection(float(width)/height, projection);
+
+  // Directional light fixed relative to the viewer
+  float light[3] = {0.5f, 1.0f, 1.5f};
+  float len = std::sqrt(light[0]*light[0] + light[1]*light[1] + light[2]*light[2]);
+
+  glUseProgram(program);
+  glUniformMatrix4fv(uModelView, 1, GL_FALSE, modelView);
+  glUniformMatrix4fv(uProjection, 1, GL_FALSE, projection);
+  glUniform3f(uColor, color[0], color[1], color[2]);
+  glUniform3f(uLightDirection, light[0]/len, light[1]/len, light[2]/len);
+  glUniform1i(uMode, mode==RENDER_WIRE ? 1 : (mode==RENDER_POINTS ? 2 : 0));
+  glUniform1f(uLineWidth, lineWidth);
+  glUniform1i(uLineStyle, lineStyle);
+  glUniform1f(uPointSize, pointSize);
+
+  if(mode==RENDER_POINTS){
+    glBindVertexArray(pointVao);
+    glDrawArrays(GL_POINTS, 0, pointCount);
+  }
+  else{
+    glBindVertexArray(vao);
+    if(mode==RENDER_SOLID && useRanges){
+      //One draw per run of ranges sharing a material
+      size_t r = 0;
+      while(r < rangeFirst.size()){
+        size_t end = r;
+        while(end < rangeFirst.size() && rangeMaterial[end] == rangeMaterial[r])
+          end++;
+        int material = rangeMaterial[r];
+        unsigned int texture = material >= 0 && material < int(materialTextures.size()) ?
+                               materialTextures[material] : 0;
+        glUniform1i(uTextured, texture != 0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glMultiDrawArrays(GL_TRIANGLES, &rangeFirst[r], &rangeCount[r], end-r);
+        r = end;
+      }
+      glUniform1i(uTextured, 0);
+      glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    else
+      glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+  }
+  glBindVertexArray(0);
+  glUseProgram(0);
+}
+
+int ShaderRenderer::getVertexCount(){return vertexCount;};
+
+#if   defined(OSX)
+#pragma clang diagnostic pop
+#endif
@@ -0,0 +1,72 @@
+// STL
+#ifndef SHADERRENDERER_H
+#define SHADERRENDERER_H
+
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "Meshlets.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Drawing style shared by the render paths
+enum RenderMode{
+  RENDER_SOLID,
+  RENDER_WIRE,
+  RENDER_POINTS,
+  RENDER_MODES
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Core profile (GLSL 3.30) render path
+///
+/// Draws the model from one vertex buffer with the same directional light and
+/// flat colour as the fixed function path. Wireframe is a single pass over the
+/// filled triangles using barycentric edge distance, and line stipple patterns
+/// are evaluated in the fragment shader. Triangles are uploaded in meshlet
+/// order so a set of visible meshlets can be drawn as a few ranges, each
+/// with the texture of its material. A model to world transform places
+/// copies of the model in a scene; it is the identity unless set.
+class ShaderRenderer{
+
+private:
+  unsigned int program;
+  unsigned int vao;
+  unsigned int vbo;
+  int vertexCount;
+  unsigned int pointVao;
+  unsigned int pointVbo;
+  int pointCount;
+  size_t gpuBytes;
+  int uModelView;
+  int uProjection;
+  int uColor;
+  int uLightDirection;
+  int uMode;
+  int uLineWidth;
+  int uLineStyle;
+  int uPointSize;
+  int uTextured;
+  std::vector<int> rangeFirst;
+  std::vector<int> rangeCount;
+  std::vector<int> rangeMaterial;
+  std::vector<unsigned int> materialTextures;
+  bool useRanges;
+  float transform[16];
+
+  unsigned int compile(unsigned int type, const char* source);
+
+public:
+  ShaderRenderer();
+  bool initialize();
+  void upload(FaceList& faces, bool fileNormals, bool textured, Meshlets& meshlets);
+  void uploadPoints(const float* points, int count);
+  void setClusters(Meshlets& meshlets, const std::vector<int>& visible);
+  void setTextures(const std::vector<unsigned int>& textures);
+  void setTransform(const float modelToWorld[16]);
+  void draw(float theta, int width, int height, RenderMode mode,
+            const float color[3], float lineWidth, float pointSize,
+            unsigned short lineStyle);
+  int getVertexCount();
+
+};
+#endif
@@ -0,0 +1,275 @@
+#include "StlFile.h"
+#include "BinaryReader.h"
+#include "Trace.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+namespace {
+
+  const size_t HEADER_BYTES = 80;
+  const size_t TRIANGLE_BYTES = 50;
+  //Bound on the header's triangle count, checked before anything is sized by
+  //it; compressed files have no size to check it against, only the cap
+  const uint32_t MAX_TRIANGLES = 1u << 25;
+
+  Vertex vertexOf(const float* p){
+    Vertex v;
+    v.setX(p[0]);
+    v.setY(p[1]);
+    v.setZ(p[2]);
+    return v;
+  }
+
+  //Unit normal of a triangle, or zero if it has no area
+  Normal facetNormal(Vertex a, Vertex b, Vertex c){
+    float u[3] = {b.getX()-a.getX(), b.getY()-a.getY(), b.getZ()-a.getZ()};
+    float v[3] = {c.getX()-a.getX(), c.getY()-a.getY(), c.getZ()-a.getZ()};
+    float n[3] = {u[1]*v[2]-u[2]*v[1], u[2]*v[0]-u[0]*v[2], u[0]*v[1]-u[1]*v[0]};
+    float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    Normal normal;
+    normal.setX(length > 0.f ? n[0]/length : 0.f);
+    normal.setY(length > 0.f ? n[1]/length : 0.f);
+    normal.setZ(length > 0.f ? n[2]/length : 0.f);
+    return normal;
+  }
+
+  //Adds a triangle from its facet normal and three corners, twelve floats
+  void addTriangle(Mesh& mesh, const float* values){
+    Vertex v[3] = {vertexOf(values+3), vertexOf(values+6), vertexOf(values+9)};
+    Normal normal;
+    if(values[0] != 0.f || values[1] != 0.f || values[2] != 0.f){
+      normal.setX(values[0]);
+      normal.setY(values[1]);
+      normal.setZ(values[2]);
+    }
+    else
+      normal = facetNormal(v[0], v[1], v[2]);
+    Face face;
+    face.setV1(v[0]);
+    face.setV2(v[1]);
+    face.setV3(v[2]);
+    face.setNormal(normal);
+    face.setIsTriangle(true);
+    mesh.vertices.push_back(v[0]);
+    mesh.vertices.push_back(v[1]);
+    mesh.vertices.push_back(v[2]);
+    mesh.normals.push_back(normal);
+    mesh.faces.push_back(face);
+  }
+
+  bool readBinary(BinaryReader& reader, uint32_t count, Mesh& mesh){
+    TRACE_ZONE("stl triangles");
+    bool swap = !BinaryReader::isLittleEndian();
+    //Compressed files grow as they are read rather than trust the header
+    size_t reserved = reader.getSize() >= 0 ? count : 0;
+    mesh.vertices.reserve(mesh.vertices.size() + reserved*3);
+    mesh.normals.reserve(mesh.normals.size() + reserved);
+    mesh.faces.reserve(mesh.faces.size() + reserved);
+    float values[12];
+    for(uint32_t t=0; t<count; t++){
+      const char* record = reader.peek(TRIANGLE_BYTES);
+      if(!record)
+        return false;
+      memcpy(values, record, sizeof(values));
+      if(swap)
+        for(int i=0; i<12; i++){
+          char* b = reinterpret_cast<char*>(values+i);
+          std::swap(b[0], b[3]);
+          std::swap(b[1], b[2]);
+        }
+      addTriangle(mesh, values);
+      reader.skip(TRIANGLE_BYTES);
+    }
+    return true;
+  }
+
+  //Numbers after the first word of a line
+  int readNumbers(const string& line, float* out, int count){
+    const char* p = line.c_str();
+    while(*p == ' ' || *p == '\t')
+      p++;
+    while(*p && *p != ' ' && *p != '\t')
+      p++;
+    int read = 0;
+    char* next;
+    while(read < count){
+      float value = strtof(p, &next);
+      if(next == p)
+        break;
+      out[read++] = value;
+      p = next;
+    }
+    return read;
+  }
+
+  bool readAscii(BinaryReader& reader, Mesh& mesh){
+    TRACE_ZONE("stl text");
+    string line;
+    float values[12] = {0.f};
+    int corners = 0;
+    while(reader.getline(line)){
+      size_t start = line.find_first_not_of(" \t");
+      if(start == string::npos)
+        continue;
+      const char* word = line.c_str()+start;
+      if(strncmp(word, "facet", 5) == 0){
+        corners = 0;
+        //facet normal nx ny nz
+        float normal[4] = {0.f, 0.f, 0.f, 0.f};
+        readNumbers(line.substr(start+5), normal, 3);
+        values[0] = normal[0];
+        values[1] = normal[1];
+        values[2] = normal[2];
+      }
+      else if(strncmp(word, "vertex", 6) == 0){
+        if(corners >= 3 || readNumbers(line, values+3+3*corners, 3) != 3)
+          return false;
+        corners++;
+      }
+      else if(strncmp(word, "endfacet", 8) == 0){
+        if(corners != 3)
+          return false;
+        addTriangle(mesh, values);
+      }
+    }
+    return true;
+  }
+
+  //Bytes of a value in little endian order
+  template<typename T>
+  void append(vector<char>& out, T value){
+    char bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    if(!BinaryReader::isLittleEndian())
+      for(size_t i=0; i<sizeof(T)/2; i++)
+        std::swap(bytes[i], bytes[sizeof(T)-1-i]);
+    out.insert(out.end(), bytes, bytes+sizeof(T));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Parse an STL file into a mesh
+/// @param filename File to read, optionally .gz or .zst compressed
+/// @param mesh Mesh the vertices, normals and faces are added to
+/// @return Whether the file could be read
+///
+/// A file is ASCII if it starts with "solid" and, when its size is known, is
+/// not exactly the size its triangle count makes a binary file, or otherwise
+/// has a facet in its first line or two.
+bool StlFile::readFile(std::string filename, Mesh& mesh){
+  TRACE_ZONE("parse stl");
+  BinaryReader reader;
+  if(!reader.open(filename))
+    return false;
+  const char* header = reader.peek(HEADER_BYTES+4);
+  bool binary = header != nullptr;
+  uint32_t count = 0;
+  if(binary){
+    memcpy(&count, header+HEADER_BYTES, sizeof(count));
+    if(!BinaryReader::isLittleEndian())
+      count = (count >> 24) | ((count >> 8) & 0xff00) | ((count << 8) & 0xff0000) | (count << 24);
+    if(strncmp(header, "solid", 5) == 0){
+      if(reader.getSize() >= 0)
+        binary = reader.getSize() == long(HEADER_BYTES+4+size_t(count)*TRIANGLE_BYTES);
+      else{
+        string start(header, HEADER_BYTES+4);
+        binary = start.find("facet") == string::npos && start.find("endsolid") == string::npos;
+      }
+    }
+  }
+  else if(!reader.peek(5) || strncmp(reader.peek(5), "solid", 5) != 0){
+    cout << filename << " is not an STL file" << endl;
+    return false;
+  }
+
+  bool ok;
+  if(binary){
+    if((reader.getSize() >= 0 && reader.getSize() < long(HEADER_BYTES+4+size_t(count)*TRIANGLE_BYTES)) ||
+       count > MAX_TRIANGLES){
+      cout << filename << " claims " << count << " triangles, more than it can hold" << endl;
+      return false;
+    }
+    reader.skip(HEADER_BYTES+4);
+    ok = readBinary(reader, count, mesh);
+  }
+  else
+    ok = readAscii(reader, mesh);
+  if(!ok){
+    cout << filename << " has broken triangles" << endl;
+    return false;
+  }
+  return reader.finish();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write a mesh as an STL file, splitting quads into triangles
+/// @param filename File to write
+/// @param mesh Mesh to write; its face normals are used if it has them
+/// @param binary Little endian binary if true, ASCII otherwise
+/// @return Whether the file could be written
+bool StlFile::writeFile(std::string filename, Mesh& mesh, bool binary){
+  TRACE_ZONE("write stl");
+  FILE* file = fopen(filename.c_str(), binary ? "wb" : "w");
+  if(!file){
+    cout << "Could not write " << filename << endl;
+    return false;
+  }
+  bool normals = mesh.hasNormals();
+  vector<char> out;
+  out.reserve(1 << 20);
+  if(binary){
+    char header[HEADER_BYTES];
+    memset(header, 0, sizeof(header));
+    snprintf(header, sizeof(header), "Written by spiderling");
+    out.insert(out.end(), header, header+HEADER_BYTES);
+    append(out, uint32_t(mesh.getTriangleCount()));
+  }
+  else
+    fprintf(file, "solid spiderling\n");
+
+  for(size_t f=0; f<mesh.faces.size(); f++){
+    Face& face = mesh.faces[f];
+    Vertex v[4] = {face.getV1(), face.getV2(), face.getV3(), face.getV4()};
+    int triangles = face.isTriangle() ? 1 : 2;
+    for(int t=0; t<triangles; t++){
+      Vertex corner[3] = {v[0], v[t+1], v[t+2]};
+      Normal normal = normals ? face.getNormal() : facetNormal(corner[0], corner[1], corner[2]);
+      if(binary){
+        append(out, normal.getX());
+        append(out, normal.getY());
+        append(out, normal.getZ());
+        for(int k=0; k<3; k++){
+          append(out, corner[k].getX());
+          append(out, corner[k].getY());
+          append(out, corner[k].getZ());
+        }
+        append(out, uint16_t(0));
+        if(out.size() >= (1 << 20)){
+          fwrite(out.data(), 1, out.size(), file);
+          out.clear();
+        }
+        continue;
+      }
+      fprintf(file, "facet normal %.9g %.9g %.9g\n  outer loop\n", normal.getX(), normal.getY(),
+              normal.getZ());
+      for(int k=0; k<3; k++)
+        fprintf(file, "    vertex %.9g %.9g %.9g\n", corner[k].getX(), corner[k].getY(), corner[k].getZ());
+      fprintf(file, "  endloop\nendfacet\n");
+    }
+  }
+  if(binary)
+    fwrite(out.data(), 1, out.size(), file);
+  else
+    fprintf(file, "endsolid spiderling\n");
+  bool ok = !ferror(file);
+  fclose(file);
+  if(!ok)
+    cout << "Could not write " << filename << endl;
+  return ok;
+}
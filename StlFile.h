@@ -0,0 +1,22 @@
+// STL
+#ifndef STLFILE_H
+#define STLFILE_H
+
+#include <string>
+#include "Mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reader and writer for STL files, binary or ASCII
+///
+/// STL holds separate triangles with a facet normal each, so every triangle
+/// gets vertices of its own; -clean welds them. Binary triangles are copied
+/// out of the read buffer 50 bytes at a time. Facet normals of zero length
+/// are computed from the triangle instead.
+class StlFile{
+
+public:
+  static bool readFile(std::string filename, Mesh& mesh);
+  static bool writeFile(std::string filename, Mesh& mesh, bool binary);
+
+};
+#endif
@@ -0,0 +1,241 @@
+#include "TextureCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include "Trace.h"
+using namespace std;
+
+// GL
+#if   defined(OSX)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#include <OpenGL/gl3.h>
+#elif defined(LINUX)
+#include <GL/gl.h>
+#endif
+
+TextureCache::TextureCache(){
+  stopping=false;
+  budget=128 << 20;
+  residentBytes=0;
+  frame=0;
+  decodes=0;
+  uploads=0;
+  evictions=0;
+  decodeSeconds=0.f;
+}
+
+TextureCache::~TextureCache(){
+  {
+    lock_guard<mutex> guard(lock);
+    stopping=true;
+  }
+  wake.notify_all();
+  for(size_t i=0; i<workers.size(); i++)
+    workers[i].join();
+}
+
+void TextureCache::setBudget(size_t bytes){budget=bytes;};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Texture for an image file, queued for decoding if it is new
+/// @param path Image to load
+/// @return Handle for getTexture
+int TextureCache::request(std::string path){
+  lock_guard<mutex> guard(lock);
+  for(size_t i=0; i<entries.size(); i++)
+    if(entries[i]->path == path)
+      return i;
+
+  //Workers start with the first texture; one core is left for drawing
+  if(workers.empty()){
+    int threads = std::max(1, std::min(4, int(thread::hardware_concurrency())-1));
+    for(int t=0; t<threads; t++)
+      workers.push_back(thread(&TextureCache::work, this));
+  }
+
+  unique_ptr<Entry> entry(new Entry());
+  entry->path = path;
+  entry->id = 0;
+  entry->bytes = 0;
+  entry->lastUsed = frame;
+  entries.push_back(std::move(entry));
+  enqueue(entries.size()-1);
+  return entries.size()-1;
+}
+
+//Called with the lock held
+void TextureCache::enqueue(int handle){
+  entries[handle]->state = TEXTURE_QUEUED;
+  queue.push_back(handle);
+  wake.notify_one();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Worker loop: decode queued images and build their mip chains
+void TextureCache::work(){
+  using namespace std::chrono;
+  Trace::setThreadName("texture worker");
+  while(true){
+    int handle;
+    string path;
+    {
+      unique_lock<mutex> guard(lock);
+      wake.wait(guard, [this](){return stopping || !queue.empty();});
+      if(stopping)
+        return;
+      handle = queue.front();
+      queue.pop_front();
+      path = entries[handle]->path;
+    }
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    vector<Image> levels(1);
+    bool ok;
+    {
+      TRACE_ZONE("texture decode");
+      ok = Image::load(path, levels[0]);
+    }
+    if(ok){
+      TRACE_ZONE("texture mips");
+      while(levels.back().width > 1 || levels.back().height > 1){
+        Image next;
+        levels.back().halve(next);
+        levels.push_back(std::move(next));
+      }
+    }
+    float seconds = duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+
+    lock_guard<mutex> guard(lock);
+    Entry& entry = *entries[handle];
+    entry.state = ok ? TEXTURE_DECODED : TEXTURE_FAILED;
+    entry.levels.swap(levels);
+    decodes++;
+    decodeSeconds += seconds;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Upload decoded textures and evict over budget; call once per frame
+/// @param uploadBytes Bytes to upload this frame; at least one texture is
+///                    uploaded when any is waiting
+void TextureCache::update(size_t uploadBytes){
+  frame++;
+  //Entries may be added from another thread; each one stays where it is
+  vector<Entry*> decoded;
+  vector<Entry*> all;
+  {
+    lock_guard<mutex> guard(lock);
+    for(size_t i=0; i<entries.size(); i++){
+      all.push_back(entries[i].get());
+      if(entries[i]->state == TEXTURE_DECODED)
+        decoded.push_back(entries[i].get());
+    }
+  }
+
+  size_t uploaded = 0;
+  for(size_t i=0; i<decoded.size() && (uploaded == 0 || uploaded < uploadBytes); i++){
+    TRACE_ZONE("texture upload");
+    Entry& entry = *decoded[i];
+    glGenTextures(1, &entry.id);
+    glBindTexture(GL_TEXTURE_2D, entry.id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    entry.bytes = 0;
+    for(size_t l=0; l<entry.levels.size(); l++){
+      Image& level = entry.levels[l];
+      glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8, level.width, level.height, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, level.pixels.data());
+      entry.bytes += level.getBytes();
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry.levels.size()-1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    MemoryTracker::record(MEMORY_GPU, entry.bytes);
+    residentBytes += entry.bytes;
+    uploaded += entry.bytes;
+    uploads++;
+
+    lock_guard<mutex> guard(lock);
+    vector<Image>().swap(entry.levels);
+    entry.state = TEXTURE_RESIDENT;
+    entry.lastUsed = frame;
+  }
+
+  //Least recently drawn first; anything drawn last frame stays
+  while(residentBytes > budget){
+    Entry* oldest = nullptr;
+    lock_guard<mutex> guard(lock);
+    for(size_t i=0; i<all.size(); i++){
+      Entry& entry = *all[i];
+      if(entry.state == TEXTURE_RESIDENT && entry.lastUsed < frame-1 &&
+         (!oldest || entry.lastUsed < oldest->lastUsed))
+        oldest = &entry;
+    }
+    if(!oldest)
+      break;
+    glDeleteTextures(1, &oldest->id);
+    oldest->id = 0;
+    MemoryTracker::release(MEMORY_GPU, oldest->bytes);
+    residentBytes -= oldest->bytes;
+    evictions++;
+    oldest->state = TEXTURE_EVICTED;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief GL texture to draw with, or 0 while it is not uploaded
+/// @param handle Handle from request, or -1 for none
+///
+/// Marks the texture as drawn this frame; an evicted texture is queued for
+/// decoding again.
+unsigned int TextureCache::getTexture(int handle){
+  lock_guard<mutex> guard(lock);
+  if(handle < 0 || handle >= int(entries.size()))
+    return 0;
+  Entry& entry = *entries[handle];
+  entry.lastUsed = frame;
+  if(entry.state == TEXTURE_EVICTED)
+    enqueue(handle);
+  return entry.state == TEXTURE_RESIDENT ? entry.id : 0;
+}
+
+int TextureCache::getState(int handle){
+  lock_guard<mutex> guard(lock);
+  return entries[handle]->state;
+}
+
+size_t TextureCache::getBudget(){return budget;};
+size_t TextureCache::getResidentBytes(){return residentBytes;};
+
+int TextureCache::getResidentCount(){
+  lock_guard<mutex> guard(lock);
+  int count = 0;
+  for(size_t i=0; i<entries.size(); i++)
+    count += entries[i]->state == TEXTURE_RESIDENT;
+  return count;
+}
+
+int TextureCache::getPendingCount(){
+  lock_guard<mutex> guard(lock);
+  int count = 0;
+  for(size_t i=0; i<entries.size(); i++)
+    count += entries[i]->state == TEXTURE_QUEUED || entries[i]->state == TEXTURE_DECODED;
+  return count;
+}
+
+int TextureCache::getEvictions(){return evictions;};
+
+void TextureCache::printReport(){
+  lock_guard<mutex> guard(lock);
+  printf("Textures: %zu requested, %d decoded in %.1f ms, %d uploaded, %d evicted, %.1f of %.1f MB resident\n",
+         entries.size(), decodes, decodeSeconds*1000.f, uploads, evictions,
+         residentBytes/1048576.0, budget/1048576.0);
+}
+
+#if   defined(OSX)
+#pragma clang diagnostic pop
+#endif
@@ -0,0 +1,77 @@
+// STL
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Image.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Textures shared by every material, decoded in the background
+///
+/// Requests for the same path share one texture. Worker threads decode the
+/// image and build its mip chain on the CPU; the GL thread uploads finished
+/// textures a few per frame in update, so loading never stalls drawing.
+/// When the uploaded textures exceed the budget the least recently drawn
+/// ones are deleted and decoded again if they are needed later. Textures
+/// may be requested from any thread.
+class TextureCache{
+
+public:
+  enum TextureState{
+    TEXTURE_QUEUED,
+    TEXTURE_DECODED,
+    TEXTURE_RESIDENT,
+    TEXTURE_EVICTED,
+    TEXTURE_FAILED
+  };
+
+private:
+  struct Entry{
+    std::string path;
+    int state;
+    unsigned int id;
+    size_t bytes;
+    int lastUsed;
+    std::vector<Image> levels;
+  };
+
+  std::vector<std::unique_ptr<Entry>> entries;
+  std::deque<int> queue;
+  std::mutex lock;
+  std::condition_variable wake;
+  std::vector<std::thread> workers;
+  bool stopping;
+  size_t budget;
+  size_t residentBytes;
+  int frame;
+  int decodes;
+  int uploads;
+  int evictions;
+  float decodeSeconds;
+
+  void work();
+  void enqueue(int handle);
+
+public:
+  TextureCache();
+  ~TextureCache();
+  void setBudget(size_t bytes);
+  int request(std::string path);
+  void update(size_t uploadBytes);
+  unsigned int getTexture(int handle);
+  int getState(int handle);
+  size_t getBudget();
+  size_t getResidentBytes();
+  int getResidentCount();
+  int getPendingCount();
+  int getEvictions();
+  void printReport();
+
+};
+#endif
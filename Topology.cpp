@@ -0,0 +1,151 @@
+#include "Topology.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+using namespace std;
+
+namespace {
+
+  struct PointKey{
+    uint32_t x;
+    uint32_t y;
+    uint32_t z;
+    bool operator==(const PointKey& o) const {return x==o.x && y==o.y && z==o.z;}
+  };
+
+  struct PointKeyHash{
+    size_t operator()(const PointKey& k) const {
+      return size_t(k.x)*2654435761u ^ size_t(k.y)*40503u ^ size_t(k.z);
+    }
+  };
+
+  //Faces touching an edge; the normal of the first two is kept for the angle
+  struct EdgeInfo{
+    int faces;
+    float n0[3];
+    float n1[3];
+  };
+
+  void faceNormal(Face& f, float n[3]){
+    Vertex a=f.getV1(), b=f.getV2(), c=f.getV3();
+    float u[3] = {b.getX()-a.getX(), b.getY()-a.getY(), b.getZ()-a.getZ()};
+    float w[3] = {c.getX()-a.getX(), c.getY()-a.getY(), c.getZ()-a.getZ()};
+    n[0] = u[1]*w[2]-u[2]*w[1];
+    n[1] = u[2]*w[0]-u[0]*w[2];
+    n[2] = u[0]*w[1]-u[1]*w[0];
+    float len = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    if(len > 0.f)
+      for(int a=0; a<3; a++)
+        n[a] /= len;
+  }
+}
+
+Topology::Topology(){
+  featureAngle=0.f;
+  corners=0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Extract the unique points and edges of the faces
+/// @param faces Faces of the model
+/// @param featureAngleDegrees Dihedral angle above which an edge is a feature
+void Topology::build(FaceList& faces, float featureAngleDegrees){
+  clear();
+  featureAngle = featureAngleDegrees;
+
+  unordered_map<PointKey, unsigned int, PointKeyHash> index;
+  index.reserve(faces.size()*2);
+  auto pointOf = [&](Vertex p){
+    PointKey k;
+    float x=p.getX(), y=p.getY(), z=p.getZ();
+    memcpy(&k.x,&x,4);
+    memcpy(&k.y,&y,4);
+    memcpy(&k.z,&z,4);
+    auto it = index.find(k);
+    if(it != index.end())
+      return it->second;
+    unsigned int i = points.size()/3;
+    points.push_back(x);
+    points.push_back(y);
+    points.push_back(z);
+    index[k] = i;
+    return i;
+  };
+
+  //Key of an undirected edge is its two point indices, smaller first
+  unordered_map<uint64_t, EdgeInfo> edgeFaces;
+  edgeFaces.reserve(faces.size()*2);
+  for(size_t i=0; i<faces.size(); i++){
+    unsigned int c[4];
+    int n = faces[i].isTriangle() ? 3 : 4;
+    c[0]=pointOf(faces[i].getV1());
+    c[1]=pointOf(faces[i].getV2());
+    c[2]=pointOf(faces[i].getV3());
+    if(n==4)
+      c[3]=pointOf(faces[i].getV4());
+    corners += n;
+
+    float normal[3];
+    faceNormal(faces[i], normal);
+    for(int e=0; e<n; e++){
+      unsigned int a=c[e], b=c[(e+1)%n];
+      if(a==b)
+        continue;
+      uint64_t key = a<b ? (uint64_t(a)<<32 | b) : (uint64_t(b)<<32 | a);
+      auto it = edgeFaces.find(key);
+      if(it == edgeFaces.end()){
+        EdgeInfo info;
+        info.faces = 1;
+        memcpy(info.n0, normal, sizeof(normal));
+        edgeFaces[key] = info;
+        edges.push_back(a);
+        edges.push_back(b);
+      }
+      else{
+        if(it->second.faces == 1)
+          memcpy(it->second.n1, normal, sizeof(normal));
+        it->second.faces++;
+      }
+    }
+  }
+
+  float cosLimit = std::cos(featureAngle*3.14159265f/180.f);
+  for(size_t e=0; e<edges.size(); e+=2){
+    unsigned int a=edges[e], b=edges[e+1];
+    uint64_t key = a<b ? (uint64_t(a)<<32 | b) : (uint64_t(b)<<32 | a);
+    EdgeInfo& info = edgeFaces[key];
+    bool feature = info.faces != 2;
+    if(!feature){
+      float d = info.n0[0]*info.n1[0] + info.n0[1]*info.n1[1] + info.n0[2]*info.n1[2];
+      feature = d < cosLimit;
+    }
+    if(feature){
+      featureEdges.push_back(a);
+      featureEdges.push_back(b);
+    }
+  }
+}
+
+void Topology::clear(){
+  points.clear();
+  edges.clear();
+  featureEdges.clear();
+  corners=0;
+}
+
+Topology::PointList& Topology::getPoints(){return points;};
+Topology::EdgeList& Topology::getEdges(){return edges;};
+Topology::EdgeList& Topology::getFeatureEdges(){return featureEdges;};
+int Topology::getPointCount(){return points.size()/3;};
+int Topology::getEdgeCount(){return edges.size()/2;};
+int Topology::getFeatureEdgeCount(){return featureEdges.size()/2;};
+int Topology::getCornerCount(){return corners;};
+float Topology::getFeatureAngle(){return featureAngle;};
+
+void Topology::printReport(){
+  cout << "Topology: " << getPointCount() << " points from " << corners << " corners, "
+       << getEdgeCount() << " edges (" << getFeatureEdgeCount() << " above "
+       << featureAngle << " degrees)" << endl;
+}
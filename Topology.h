@@ -0,0 +1,43 @@
+// STL
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <vector>
+#include "Mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Unique points and edges of a model for point and wireframe modes
+///
+/// Corners sharing a position become one point and an edge shared by several
+/// faces is stored once, so each is drawn once per frame. Feature edges are
+/// the subset on a boundary, shared by more than two faces or with a dihedral
+/// angle above a threshold.
+class Topology{
+
+public:
+  typedef TrackedVector<float, MEMORY_CACHE> PointList;
+  typedef TrackedVector<unsigned int, MEMORY_CACHE> EdgeList;
+
+private:
+  PointList points;
+  EdgeList edges;
+  EdgeList featureEdges;
+  float featureAngle;
+  int corners;
+
+public:
+  Topology();
+  void build(FaceList& faces, float featureAngleDegrees);
+  void clear();
+  PointList& getPoints();
+  EdgeList& getEdges();
+  EdgeList& getFeatureEdges();
+  int getPointCount();
+  int getEdgeCount();
+  int getFeatureEdgeCount();
+  int getCornerCount();
+  float getFeatureAngle();
+  void printReport();
+
+};
+#endif
@@ -0,0 +1,199 @@
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+namespace {
+
+  const size_t BUFFER_EVENTS = 1 << 16;
+
+  struct Event{
+    const char* name;
+    long long start;
+    long long end;
+  };
+
+  //Written only by its own thread; count is published with release so the
+  //exporter sees complete events without locking the writer
+  struct ThreadBuffer{
+    int id;
+    const char* name;
+    Event events[BUFFER_EVENTS];
+    atomic<size_t> count;
+    atomic<size_t> dropped;
+  };
+
+  //Events of a thread that has finished, kept until the trace is written
+  struct RetiredThread{
+    int id;
+    const char* name;
+    vector<Event> events;
+    size_t dropped;
+  };
+
+  atomic<bool> enabled{false};
+  mutex registryLock;
+  vector<ThreadBuffer*> buffers;
+  vector<ThreadBuffer*> freeBuffers;
+  vector<RetiredThread> retired;
+  int nextId = 1;
+  const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+
+  //Hands the buffer of an exiting thread back for the next new thread, so
+  //threads started per load or per build do not leave a buffer each
+  struct BufferOwner{
+    ThreadBuffer* buffer = nullptr;
+    ~BufferOwner(){
+      if(!buffer)
+        return;
+      lock_guard<mutex> guard(registryLock);
+      size_t count = buffer->count.load(memory_order_acquire);
+      if(count || buffer->dropped){
+        RetiredThread thread;
+        thread.id = buffer->id;
+        thread.name = buffer->name;
+        thread.events.assign(buffer->events, buffer->events+count);
+        thread.dropped = buffer->dropped;
+        retired.push_back(std::move(thread));
+      }
+      buffers.erase(find(buffers.begin(), buffers.end(), buffer));
+      freeBuffers.push_back(buffer);
+    }
+  };
+
+  //Kept apart from the buffer so naming a thread allocates nothing while
+  //tracing is off
+  thread_local const char* threadName = nullptr;
+  thread_local BufferOwner owner;
+
+  ThreadBuffer* threadBuffer(){
+    if(!owner.buffer){
+      lock_guard<mutex> guard(registryLock);
+      if(freeBuffers.empty())
+        owner.buffer = new ThreadBuffer();
+      else{
+        owner.buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+      }
+      owner.buffer->id = nextId++;
+      owner.buffer->name = threadName;
+      owner.buffer->count = 0;
+      owner.buffer->dropped = 0;
+      buffers.push_back(owner.buffer);
+    }
+    return owner.buffer;
+  }
+
+  void writeName(FILE* file, const char* name){
+    for(const char* c=name; *c; c++){
+      if(*c == '"' || *c == '\\')
+        fputc('\\', file);
+      fputc(*c, file);
+    }
+  }
+
+  void writeEvents(FILE* file, bool& first, int id, const char* name, const Event* events, size_t count){
+    if(name){
+      fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"",
+              first ? "" : ",\n", id);
+      writeName(file, name);
+      fprintf(file, "\"}}");
+      first = false;
+    }
+    for(size_t i=0; i<count; i++){
+      const Event& e = events[i];
+      fprintf(file, "%s{\"name\":\"", first ? "" : ",\n");
+      writeName(file, e.name);
+      fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}",
+              id, e.start, e.end-e.start);
+      first = false;
+    }
+  }
+}
+
+void Trace::setEnabled(bool on){enabled.store(on);};
+bool Trace::isEnabled(){return enabled.load(memory_order_relaxed);};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Label the calling thread in the exported trace
+void Trace::setThreadName(const char* name){
+  threadName = name;
+  if(owner.buffer)
+    owner.buffer->name = name;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Microseconds since the process started tracing
+long long Trace::now(){
+  return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now()-epoch).count();
+}
+
+void Trace::record(const char* name, long long start, long long end){
+  ThreadBuffer* buffer = threadBuffer();
+  size_t i = buffer->count.load(memory_order_relaxed);
+  if(i >= BUFFER_EVENTS){
+    buffer->dropped.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+  buffer->events[i].name = name;
+  buffer->events[i].start = start;
+  buffer->events[i].end = end;
+  buffer->count.store(i+1, memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write all recorded events as a Chrome/Perfetto JSON trace
+/// @param filename File to write
+/// @return Whether the file could be written
+bool Trace::write(std::string filename){
+  FILE* file = fopen(filename.c_str(), "w");
+  if(!file){
+    cout << "Could not write trace " << filename << endl;
+    return false;
+  }
+
+  //Held throughout, so no thread can retire or reuse a buffer being written
+  lock_guard<mutex> guard(registryLock);
+  fprintf(file, "{\"traceEvents\":[\n");
+  bool first = true;
+  size_t total = 0, dropped = 0;
+  for(size_t t=0; t<retired.size(); t++){
+    RetiredThread& thread = retired[t];
+    writeEvents(file, first, thread.id, thread.name, thread.events.data(), thread.events.size());
+    total += thread.events.size();
+    dropped += thread.dropped;
+  }
+  for(size_t t=0; t<buffers.size(); t++){
+    ThreadBuffer* buffer = buffers[t];
+    size_t count = buffer->count.load(memory_order_acquire);
+    writeEvents(file, first, buffer->id, buffer->name, buffer->events, count);
+    total += count;
+    dropped += buffer->dropped.load();
+  }
+  fprintf(file, "\n]}\n");
+  bool ok = !ferror(file);
+  fclose(file);
+
+  cout << "Wrote " << total << " trace events from " << retired.size()+buffers.size() << " threads to "
+       << filename;
+  if(dropped)
+    cout << " (" << dropped << " dropped, buffers full)";
+  cout << endl;
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Forget recorded events; only call while no zones are being recorded
+void Trace::clear(){
+  lock_guard<mutex> guard(registryLock);
+  for(size_t t=0; t<buffers.size(); t++){
+    buffers[t]->count = 0;
+    buffers[t]->dropped = 0;
+  }
+  retired.clear();
+}
@@ -0,0 +1,51 @@
+// STL
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Scoped timing zones exported in the Chrome trace event format
+///
+/// Every thread records into its own fixed size buffer, so recording takes no
+/// locks; a full buffer drops further events and counts them. When a thread
+/// exits its events are copied aside and its buffer goes to the next new
+/// thread, so short lived workers cost memory for their events only. While
+/// tracing is off a zone costs one relaxed atomic load. Zone names must be
+/// string literals or otherwise outlive the trace.
+class Trace{
+
+public:
+  static void setEnabled(bool enabled);
+  static bool isEnabled();
+  static void setThreadName(const char* name);
+  static bool write(std::string filename);
+  static void clear();
+
+  static long long now();
+  static void record(const char* name, long long start, long long end);
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Records the time between construction and destruction
+class TraceZone{
+
+private:
+  const char* name;
+  long long start;
+
+public:
+  TraceZone(const char* zoneName) : name(zoneName), start(Trace::isEnabled() ? Trace::now() : -1) {}
+  ~TraceZone(){
+    if(start >= 0)
+      Trace::record(name, start, Trace::now());
+  }
+
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+
+#endif
@@ -0,0 +1,56 @@
+// STL
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Lock-free hand-off of whole values from one writer to one reader
+///
+/// The writer fills the back slot and publishes it; the reader takes the most
+/// recently published slot with update and reads it as the front. The third
+/// slot sits between them, so neither side ever waits on the other or sees a
+/// slot the other is still using. A value published before the reader took
+/// the previous one simply replaces it.
+template <typename T>
+class TripleBuffer{
+
+private:
+  static const int FRESH = 4;
+
+  T slots[3];
+  std::atomic<int> middle;
+  int back;
+  int front;
+  int published;
+  int dropped;
+
+public:
+  TripleBuffer() : middle(1), back(0), front(2), published(0), dropped(0) {}
+
+  //Writer side
+  T& getBack(){return slots[back];}
+
+  void publish(){
+    int previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+    back = previous & 3;
+    published++;
+    if(previous & FRESH)
+      dropped++;
+  }
+
+  int getPublished(){return published;}
+  int getDropped(){return dropped;}
+
+  //Reader side; returns whether a newer value was taken
+  bool update(){
+    if(!(middle.load(std::memory_order_acquire) & FRESH))
+      return false;
+    front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+    return true;
+  }
+
+  T& getFront(){return slots[front];}
+
+};
+#endif
@@ -11,17 +11,56 @@
 // Includes
 
 // STL
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cfloat>
 #include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "BoundedQueue.h"
+#include "DynamicResolution.h"
 #include "Vertex.h"
 #include "Texture.h"
 #include "Normal.h"
 #include "Face.h"
+#include "FrameStats.h"
+#include "GLState.h"
+#include "InputRecorder.h"
+#include "Memory.h"
+#include "Mesh.h"
+#include "MeshGenerator.h"
+#include "MeshLoader.h"
+#include "ObjWriter.h"
+#include "PlyFile.h"
+#include "StlFile.h"
+#include "MeshStore.h"
+#include "Meshlets.h"
+#include "OcclusionCuller.h"
+#include "Offscreen.h"
+#include "BVH.h"
+#include "Camera.h"
+#include "RenderPacket.h"
+#include "ShaderRenderer.h"
+#include "TextureCache.h"
+#include "Topology.h"
+#include "Trace.h"
+#include "TripleBuffer.h"
 using namespace std;
 
 // GL
@@ -31,6 +70,7 @@ using namespace std;
 #include <GLUT/glut.h>
 #elif defined(LINUX)
 #include <GL/glut.h>
+#include <GL/freeglut_ext.h>
 #endif
 
 #ifdef __APPLE__
@@ -87,21 +127,92 @@ std::chrono::high_resolution_clock::time_point g_frameTime{
 //Line Style
   GLshort lineStyle=0xFFFF;
 
-//Creating the variables for the vectors for face, Normals, Textures, and Vertexs
-  vector <Vertex> v;
-  int currentIndexVertex=0;
-  vector <Normal> normals;
-  int currentIndexNormals=0;
-  vector<Face> faces;
-  int currentIndexFaces=0;
-  vector<Texture >textures;
-  int currentIndexTextures=0;
-  int numVertex=0;
-  int numIndicies=0;
+//Drawing style of the model
   bool wireFrame=false; 
   bool pointModel=false;
   bool solidModel=true;
-  bool textureHere=true;
+
+//Load-time mesh cleanup (-clean [epsilon] on the command line, 'c' toggles)
+  bool cleanOnLoad=false;
+  float cleanEpsilon=1e-4f;
+
+//Ray queries against the BVH of the model and the picking state
+  int pickedFace=-1;
+  bool measureMode=false;
+  bool haveMeasurePoint=false;
+  float measurePoint[3];
+
+//Geometry shared between loaded models with identical content
+  MeshStore meshStore;
+
+//Unique points and edges for point and wire models ('f' toggles feature edges)
+  float featureAngle=30.f;
+  bool featureEdgesOnly=false;
+
+//Textures of the model's materials (-textureBudget MB)
+  TextureCache textureCache;
+  const size_t TEXTURE_UPLOAD_BYTES = 8 << 20;
+
+//Meshlets of the model; solid mode skips those facing away ('b' toggles)
+  bool clusterCulling=true;
+
+//Stats overlay ('i' toggles)
+  bool showStats=false;
+
+//Trace output (-trace [file] records from startup, 't' writes it out)
+  std::string traceFile="trace.json";
+
+//Core profile render path (-glsl on the command line)
+  bool useShaders=false;
+  ShaderRenderer shaderRenderer;
+
+//Dynamic resolution (-dynamicResolution [ms], 'r' toggles): the scene is drawn
+//into an offscreen target at a scale picked from the frame times and
+//stretched over the window
+  bool dynamicResolution=false;
+  DynamicResolution resolution;
+  Offscreen sceneTarget;
+  bool scalingActive=false;
+  float g_frameWork{0.f};
+
+//Shadow of GL state, so unchanged state is not sent again every frame
+  GLState glState;
+  std::shared_ptr<Geometry> uploadedGeometry;
+  bool statsPrinted=false;
+
+//Simulation thread: applies input queued by the GLUT callbacks to the state
+//above and publishes one render packet per frame; the GLUT thread owns the GL
+//context and only draws packets
+  struct SimulationInput{
+    InputEvent event;
+    int x;
+    int y;
+    int width;
+    int height;
+  };
+  std::shared_ptr<Model> model;
+  bool quitRequested=false;
+  TripleBuffer<RenderPacket> packets;
+  std::thread simulationThread;
+  std::mutex inputLock;
+  std::condition_variable inputWake;
+  std::deque<SimulationInput> inputQueue;
+  bool packetTaken=false;
+  bool simulationStopping=false;
+  //Newest input applied by the simulation, and published with its packet
+  int appliedInputFrame=-1;
+  int publishedInputFrame=-1;
+  std::condition_variable packetWake;
+
+//Input recording (-record file) and frame by frame replay (-replay file)
+  InputRecorder recorder;
+  FrameStats replayStats;
+  int g_frame{0};
+  int replayInputFrame{-1};
+  std::chrono::high_resolution_clock::time_point g_startTime{
+    std::chrono::high_resolution_clock::now()};
+  std::string replayJsonFile;
+  const int REPLAY_TAIL_FRAMES = 60;
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -111,9 +222,16 @@ std::chrono::high_resolution_clock::time_point g_frameTime{
 /// @brief Initialize GL settings
   void
   initialize() {
-    glClearColor(0.f, 0.4f, 0.6f, 0.f);
-    glEnable(GL_COLOR_MATERIAL);
-    glEnable(GL_DEPTH_TEST);
+    glState.setClearColor(0.f, 0.4f, 0.6f, 0.f);
+    glState.enable(GL_DEPTH_TEST);
+    if(useShaders){
+      if(!shaderRenderer.initialize()){
+        std::cout << "Core profile path unavailable" << std::endl;
+        exit(1);
+      }
+    }
+    else
+      glState.enable(GL_COLOR_MATERIAL);
   }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -128,23 +246,33 @@ std::chrono::high_resolution_clock::time_point g_frameTime{
   // Viewport
     glViewport(0, 0, g_width, g_height);
 
-  // Projection
+  // Projection (the shader path builds its own)
+    if(useShaders)
+      return;
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     gluPerspective(45.f, GLfloat(g_width)/g_height, 0.01f, 100.f);
   }
 
+void replayInput();
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Timer function to fix framerate in a GLUT application
 /// @param _v Value (not used here)
 ///
-/// Note, this is rudametary and fragile.
+/// Note, this is rudametary and fragile. A replay applies the recorded input
+/// due this frame and asks for the next frame straight away.
   void
   timer(int _v) {
+    if(recorder.isReplaying()){
+      replayInput();
+      if(g_frame > recorder.getLastFrame() + REPLAY_TAIL_FRAMES)
+        exit(0);
+    }
     if(g_window != 0) {
       glutPostRedisplay();
 
-      g_delay = std::max(0.f, 1.f/FPS - g_frameRate);
+      g_delay = recorder.isReplaying() ? 0.f : std::max(0.f, 1.f/FPS - g_frameRate);
       glutTimerFunc((unsigned int)(1000.f*g_delay), timer, 0);
     }
     else
@@ -152,122 +280,403 @@ std::chrono::high_resolution_clock::time_point g_frameTime{
   }
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Draw function for single frame
+/// @brief Draws each unique point or edge of the model once
+///
+/// Uses client vertex arrays over the lists built at load time. Lighting is
+/// off since points and edges have no single face normal.
   void
-  draw() {
-    using namespace std::chrono;
-
-  //////////////////////////////////////////////////////////////////////////////
-  // Clear
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glClearColor(backgroudRed,backgroundGreen,backgroundBlue,backgroundAplha);
+  drawTopology(RenderPacket& packet) {
+    glState.disable(GL_LIGHTING);
+    DrawSpan span = {packet.model->geometry.get(), nullptr, 0, packet.featureEdgesOnly};
+    packet.model->kernels[packet.mode](span);
+  }
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Draw
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draws the triangles of the visible meshlets
+///
+/// Each run of clusters with one material goes to the model's solid kernel
+/// in one call. Textured materials are drawn white so the texture shows
+/// unchanged under the light; the rest use the model colour.
+  void
+  drawClusters(RenderPacket& packet) {
+    Model& m = *packet.model;
+    Meshlets& meshlets = m.geometry->meshlets;
+    vector<int>& visible = packet.visibleClusters;
+    DrawSpan span = {m.geometry.get(), nullptr, 0, false};
+    for(size_t c=0; c<visible.size();){
+      int material = meshlets.getMeshlet(visible[c]).material;
+      size_t end = c+1;
+      while(end < visible.size() && meshlets.getMeshlet(visible[end]).material == material)
+        end++;
+      unsigned int texture = material >= 0 ? textureCache.getTexture(m.materialTextures[material]) : 0;
+      if(texture){
+        glState.enable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glColor3f(1.f, 1.f, 1.f);
+      }
+      else{
+        glState.disable(GL_TEXTURE_2D);
+        glColor3fv(packet.color);
+      }
+      span.clusters = visible.data()+c;
+      span.clusterCount = int(end-c);
+      m.kernels[RENDER_SOLID](span);
+      c = end;
+    }
+    glState.disable(GL_TEXTURE_2D);
+    glColor3fv(packet.color);
+  }
 
-  // Single directional light
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Sets up the single directional light, fixed relative to the viewer
+///
+/// Leaves the modelview matrix at identity.
+  void
+  setupLight() {
     static GLfloat lightPosition[] = { 0.5f, 1.0f, 1.5f, 0.0f };
     static GLfloat whiteLight[] = { 0.8f, 0.8f, 0.8f, 1.0f };
     static GLfloat darkLight[] = { 0.2f, 0.2f, 0.2f, 1.0f };
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0);
-    glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
-    glLightfv(GL_LIGHT0, GL_AMBIENT, darkLight);
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, whiteLight);
-
-  // Camera
+    glState.enable(GL_LIGHT0);
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
-    gluLookAt(10*std::sin(g_theta), 0.f, 10*std::cos(g_theta),
+    //Set in eye space, so the light stays fixed relative to the viewer
+    glState.setLight(GL_LIGHT0, GL_POSITION, lightPosition);
+    glState.setLight(GL_LIGHT0, GL_AMBIENT, darkLight);
+    glState.setLight(GL_LIGHT0, GL_DIFFUSE, whiteLight);
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draws the model with the fixed function pipeline
+  void
+  drawFixedFunction(RenderPacket& packet) {
+  // Single directional light
+    glState.enable(GL_LIGHTING);
+    setupLight();
+
+  // Camera
+    gluLookAt(10*std::sin(packet.theta), 0.f, 10*std::cos(packet.theta),
       0.f, 0.f, 0.f, 0.f, 1.f, 0.f);
 
   // Model of cube
-    glColor3f(red, green, blue);
-
-    //Enables the basic drawing functions using user input functions
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    glEnable(GL_LINE_SMOOTH);
-    glEnable(GL_LINE_STIPPLE);
-    glLineStipple(1,lineStyle);
-    glLineWidth(lineSize);
-    glPointSize(pointSize);
+    glColor3fv(packet.color);
+
+//Point and wire models draw the unique points and edges of the model
+    if(packet.mode != RENDER_SOLID){
+      glState.enable(GL_LINE_SMOOTH);
+      glState.enable(GL_LINE_STIPPLE);
+      glState.setLineStipple(1,packet.lineStyle);
+      glState.setLineWidth(packet.lineSize);
+      glState.setPointSize(packet.pointSize);
+      drawTopology(packet);
+    }
 
 
-//If the user wants a wire frame
-    if(wireFrame){
-     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-     glBegin(GL_LINES);
-   }
+//Solid models draw the visible clusters, grouped by material
+  if(packet.mode == RENDER_SOLID){
+   glState.disable(GL_LINE_SMOOTH);
+   glState.disable(GL_LINE_STIPPLE);
+   glState.setPolygonMode(GL_FILL);
+   drawClusters(packet);
+  }
 
+//Highlights the face picked with the mouse
+FaceList& faces = packet.model->geometry->mesh.faces;
+int pickedFace = packet.pickedFace;
+if(pickedFace>=0 && pickedFace<int(faces.size())){
+  glState.disable(GL_LIGHTING);
+  glState.disable(GL_LINE_STIPPLE);
+  glState.setDepthFunc(GL_LEQUAL);
+  glState.setPolygonMode(GL_FILL);
+  glColor3f(1.f, 1.f, 0.f);
+  glBegin(faces[pickedFace].isTriangle() ? GL_TRIANGLES : GL_QUADS);
+  glVertex3f(faces[pickedFace].getV1().getX(),faces[pickedFace].getV1().getY(),faces[pickedFace].getV1().getZ());
+  glVertex3f(faces[pickedFace].getV2().getX(),faces[pickedFace].getV2().getY(),faces[pickedFace].getV2().getZ());
+  glVertex3f(faces[pickedFace].getV3().getX(),faces[pickedFace].getV3().getY(),faces[pickedFace].getV3().getZ());
+  if(!(faces[pickedFace].isTriangle()))
+    glVertex3f(faces[pickedFace].getV4().getX(),faces[pickedFace].getV4().getY(),faces[pickedFace].getV4().getZ());
+  glEnd();
+  glState.setDepthFunc(GL_LESS);
+}
+}
 
-//If the user wants the points model
-   if(pointModel){
-    glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
-    glBegin(GL_POINTS);
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Lines of the stats overlay: frame rate and memory of the model
+vector<std::string>
+statsLines(RenderPacket& packet) {
+  Model& m = *packet.model;
+  Geometry& g = *m.geometry;
+  vector<std::string> lines;
+  char line[128];
+  snprintf(line, sizeof(line), "%s  %zu faces  %.1f fps", m.name.c_str(),
+           g.mesh.faces.size(), g_framesPerSecond);
+  lines.push_back(line);
+  if(packet.clusterCulling && packet.mode == RENDER_SOLID)
+    snprintf(line, sizeof(line), "clusters %zu / %d drawn  triangles %d / %d",
+             packet.visibleClusters.size(), g.meshlets.getMeshletCount(),
+             packet.drawnTriangles, g.meshlets.getTriangleCount());
+  else
+    snprintf(line, sizeof(line), "clusters %d, culling off", g.meshlets.getMeshletCount());
+  lines.push_back(line);
+  if(packet.dynamicResolution){
+    snprintf(line, sizeof(line), "resolution %.0f%% (%dx%d)  min %.0f%%  mean %.0f%% over %zu frames",
+             100.f*resolution.getScale(), resolution.scaled(g_width), resolution.scaled(g_height),
+             100.f*resolution.getMinScale(), 100.f*resolution.getMeanScale(),
+             resolution.getHistory().size());
+    lines.push_back(line);
+    snprintf(line, sizeof(line), "over budget %d / %d frames  %.0f ms past %.1f ms budget",
+             resolution.getOverBudgetFrames(), resolution.getFrames(),
+             1000.f*resolution.getOverBudgetSeconds(), 1000.f*resolution.getBudget());
   }
+  else
+    snprintf(line, sizeof(line), "resolution 100%%, dynamic scaling off");
+  lines.push_back(line);
+  snprintf(line, sizeof(line), "gl state %d calls issued  %d elided last frame",
+           glState.getIssued(), glState.getElided());
+  lines.push_back(line);
+  snprintf(line, sizeof(line), "mesh store %d geometries  %d models  %.1f KB unique  %.1f KB deduplicated",
+           meshStore.getGeometryCount(), meshStore.getReferenceCount(),
+           meshStore.getUniqueBytes()/1024.0, meshStore.getDeduplicatedBytes()/1024.0);
+  lines.push_back(line);
+  snprintf(line, sizeof(line), "textures %d resident  %.1f / %.1f MB  %d pending  %d evicted",
+           textureCache.getResidentCount(), textureCache.getResidentBytes()/1048576.0,
+           textureCache.getBudget()/1048576.0, textureCache.getPendingCount(),
+           textureCache.getEvictions());
+  lines.push_back(line);
+  for(int s=0; s<MEMORY_SUBSYSTEMS; s++){
+    snprintf(line, sizeof(line), "%-6s %9.1f KB  peak %9.1f KB  %zu allocs",
+             MemoryTracker::getName(s), MemoryTracker::getCurrent(s)/1024.0,
+             MemoryTracker::getPeak(s)/1024.0, MemoryTracker::getAllocations(s));
+    lines.push_back(line);
+  }
+  snprintf(line, sizeof(line), "total  %9.1f KB  peak %9.1f KB  model %.1f B/tri",
+           MemoryTracker::getTotalCurrent()/1024.0, MemoryTracker::getTotalPeak()/1024.0,
+           m.triangles > 0 ? double(m.geometry->bytes)/m.triangles : 0.0);
+  lines.push_back(line);
+  return lines;
+}
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draws the stats overlay in the top left corner
+  void
+  drawStats(RenderPacket& packet) {
+    vector<std::string> lines = statsLines(packet);
+    glState.disable(GL_LIGHTING);
+    glState.disable(GL_DEPTH_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, g_width, 0, g_height);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glColor3f(1.f, 1.f, 1.f);
+    for(size_t i=0; i<lines.size(); i++){
+      glRasterPos2i(10, g_height-20-15*i);
+      for(size_t c=0; c<lines[i].size(); c++)
+        glutBitmapCharacter(GLUT_BITMAP_8_BY_13, lines[i][c]);
+    }
 
-//If the user wants a normal model looking if triangular faces or Quads
-  if(solidModel){
-   glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-   if(!(faces[1].isTriangle())){
-    glBegin(GL_QUADS);
+    //Scale of the recent frames under the text, full resolution at the top
+    if(packet.dynamicResolution){
+      const std::deque<float>& history = resolution.getHistory();
+      int top = g_height-20-15*lines.size();
+      glState.disable(GL_LINE_STIPPLE);
+      glState.disable(GL_LINE_SMOOTH);
+      glState.setLineWidth(1.f);
+      glColor3f(0.4f, 0.4f, 0.4f);
+      glBegin(GL_LINE_LOOP);
+      glVertex2i(10, top);
+      glVertex2i(10+2*DynamicResolution::HISTORY, top);
+      glVertex2i(10+2*DynamicResolution::HISTORY, top-40);
+      glVertex2i(10, top-40);
+      glEnd();
+      glColor3f(0.2f, 1.f, 0.4f);
+      glBegin(GL_LINE_STRIP);
+      for(size_t i=0; i<history.size(); i++)
+        glVertex2f(10.f+2.f*i, top-40.f+40.f*history[i]);
+      glEnd();
+    }
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glState.enable(GL_DEPTH_TEST);
   }
-  else{
-   glBegin(GL_TRIANGLES);
- }
- }
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Takes the newest render packet and lets the simulation build the next
+///
+/// The simulation thread starts on the following packet as soon as this one is
+/// taken, so it runs while this frame is being submitted.
+  RenderPacket&
+  takePacket() {
+    if(packets.update()){
+      std::lock_guard<std::mutex> guard(inputLock);
+      packetTaken = true;
+      inputWake.notify_one();
+    }
+    //A replay draws nothing until the input queued for this frame has been
+    //applied, however long that takes, so every event lands on its frame
+    while(packets.getFront().inputFrame < replayInputFrame){
+      TRACE_ZONE("wait for replayed input");
+      {
+        std::unique_lock<std::mutex> guard(inputLock);
+        packetWake.wait(guard, [](){
+          return simulationStopping || publishedInputFrame >= replayInputFrame;});
+        if(simulationStopping)
+          break;
+      }
+      if(packets.update()){
+        std::lock_guard<std::mutex> guard(inputLock);
+        packetTaken = true;
+        inputWake.notify_one();
+      }
+    }
+    return packets.getFront();
+  }
 
-//Loops through and constructs all the faces of the model
- for(int i=0; i<currentIndexFaces; i++){ 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draws one render packet into the current framebuffer
+///
+/// Reads nothing but the packet, which no other thread writes. The stats are
+/// drawn separately by drawOverlay.
+  void
+  renderPacket(RenderPacket& packet) {
+  //////////////////////////////////////////////////////////////////////////////
+  // Clear
+    glState.beginFrame();
+    {
+      TRACE_ZONE("clear");
+      glState.setClearColor(packet.background[0], packet.background[1], packet.background[2],
+                            packet.background[3]);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
 
-        //Calculates the normals if not given in File
-        if(currentIndexNormals==0){
-          Normal *n;
-          n->calculateNormal(faces[i].getV1(),faces[i].getV2(),faces[i].getV3());
-           glNormal3f(n->getX(), n->getY(),n->getZ());
-          
-        }
+  //////////////////////////////////////////////////////////////////////////////
+  // Upload textures decoded since the last frame
+    textureCache.update(TEXTURE_UPLOAD_BYTES);
 
-        else{
-        glNormal3f(faces[i].getNormal().getX(), faces[i].getNormal().getY(),faces[i].getNormal().getZ());
+  //////////////////////////////////////////////////////////////////////////////
+  // Draw
+    Model& m = *packet.model;
+    Geometry& g = *m.geometry;
+    if(useShaders){
+      //Models sharing geometry share its upload too
+      if(uploadedGeometry != m.geometry){
+        TRACE_ZONE("upload");
+        shaderRenderer.upload(g.mesh.faces, g.mesh.hasNormals(), g.mesh.hasTextures(), g.meshlets);
+        shaderRenderer.uploadPoints(g.topology.getPoints().data(), g.topology.getPointCount());
+        uploadedGeometry = m.geometry;
       }
+      TRACE_ZONE("draw shaders");
+      shaderRenderer.setClusters(g.meshlets, packet.visibleClusters);
+      vector<unsigned int> textures(m.materialTextures.size());
+      for(size_t t=0; t<textures.size(); t++)
+        textures[t] = textureCache.getTexture(m.materialTextures[t]);
+      shaderRenderer.setTextures(textures);
+      shaderRenderer.draw(packet.theta, g_width, g_height, packet.mode, packet.color,
+                          packet.lineSize, packet.pointSize, packet.lineStyle);
+    }
+    else{
+      TRACE_ZONE("draw fixed function");
+      drawFixedFunction(packet);
+    }
+  }
 
-        glTexCoord2f(faces[i].getT1().getX(),faces[i].getT1().getY());
-        glVertex3f(faces[i].getV1().getX(),faces[i].getV1().getY(),faces[i].getV1().getZ());
-        glTexCoord2f(faces[i].getT2().getX(),faces[i].getT2().getY());
-        glVertex3f(faces[i].getV2().getX(),faces[i].getV2().getY(),faces[i].getV2().getZ());
-        glTexCoord2f(faces[i].getT3().getX(),faces[i].getT3().getY());
-        glVertex3f(faces[i].getV3().getX(),faces[i].getV3().getY(),faces[i].getV3().getZ());
-
-        if(!(faces[i].isTriangle())){
-          glTexCoord2f(faces[i].getT4().getX(),faces[i].getT4().getY());
-          glVertex3f(faces[i].getV4().getX(),faces[i].getV4().getY(),faces[i].getV4().getZ());
-        }
-
-}
-glEnd();
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draws the stats over the frame, at window resolution
+  void
+  drawOverlay(RenderPacket& packet) {
+    if(useShaders){
+      //The core profile has no bitmap fonts, so the stats go to the console
+      if(packet.showStats && !statsPrinted){
+        vector<std::string> lines = statsLines(packet);
+        for(size_t i=0; i<lines.size(); i++)
+          std::cout << lines[i] << std::endl;
+      }
+      statsPrinted = packet.showStats;
+    }
+    else if(packet.showStats){
+      TRACE_ZONE("stats overlay");
+      drawStats(packet);
+    }
+  }
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draw function for single frame
+  void
+  draw() {
+    using namespace std::chrono;
+    TRACE_ZONE("frame");
+    RenderPacket& packet = takePacket();
+    if(packet.quit){
+      std::cout << "Destroying window: " << g_window << std::endl;
+      glutDestroyWindow(g_window);
+      g_window = 0;
+      return;
+    }
+    high_resolution_clock::time_point workStart = high_resolution_clock::now();
 
+  //////////////////////////////////////////////////////////////////////////////
+  // Render, below window resolution when scaling dynamically
+    //A frame that (re)creates the target is not a fair sample of the scale
+    bool retarget = packet.dynamicResolution &&
+      (!scalingActive || sceneTarget.getWidth() != g_width || sceneTarget.getHeight() != g_height);
+    if(packet.dynamicResolution && !scalingActive)
+      resolution.reset();
+    if(retarget)
+      scalingActive = sceneTarget.initialize(g_width, g_height, 0);
+    else if(!packet.dynamicResolution)
+      scalingActive = false;
+    int renderWidth = scalingActive ? resolution.scaled(g_width) : g_width;
+    int renderHeight = scalingActive ? resolution.scaled(g_height) : g_height;
+    if(scalingActive)
+      sceneTarget.bind(renderWidth, renderHeight);
+    renderPacket(packet);
+    if(scalingActive){
+      TRACE_ZONE("upscale");
+      sceneTarget.present(renderWidth, renderHeight, g_width, g_height);
+    }
+    drawOverlay(packet);
 
-glDisable(GL_LINE_STIPPLE);
-glDisable(GL_LINE_SMOOTH);
   //////////////////////////////////////////////////////////////////////////////
   // Show
-glutSwapBuffers();
+    {
+      TRACE_ZONE("swap");
+      glutSwapBuffers();
+    }
 
   //////////////////////////////////////////////////////////////////////////////
   // Record frame time
 high_resolution_clock::time_point time = high_resolution_clock::now();
+//Work of this frame up to the swap, which waits when the GPU falls behind;
+//the time between frames also holds the timer's wait
+g_frameWork = duration_cast<duration<float>>(time - workStart).count();
+if(scalingActive && !retarget)
+  resolution.update(g_frameWork);
 g_frameRate = duration_cast<duration<float>>(time - g_frameTime).count();
 g_frameTime = time;
 g_framesPerSecond = 1.f/(g_delay + g_frameRate);
+//The first frame also counts the time spent starting up
+if(recorder.isReplaying() && g_frame > 0)
+  replayStats.add(g_frameRate);
+g_frame++;
   //printf("FPS: %6.2f\n", g_framesPerSecond);
 
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Log an input event when recording
+/// @param type key, special or menu
+/// @param code Key code or menu choice
+/// @param menu Name of the menu for menu events
+void recordInput(std::string type, int code, std::string menu) {
+  using namespace std::chrono;
+  float ms = duration_cast<duration<float, std::milli>>(high_resolution_clock::now()-g_startTime).count();
+  recorder.record(g_frame, ms, type, code, menu);
+}
+
 //Helper Methods used to change between the types of models
 void changeToPoints(){
   wireFrame=false; 
@@ -297,9 +706,7 @@ void keyPressed(GLubyte _key, GLint _x, GLint _y) {
   switch(_key) {
     // Escape key : quit application
     case 27:
-    std::cout << "Destroying window: " << g_window << std::endl;
-    glutDestroyWindow(g_window);
-    g_window = 0;
+    quitRequested = true;
     break;
     case 112:
     std::cout << "Changing to point model" << endl;
@@ -315,6 +722,40 @@ void keyPressed(GLubyte _key, GLint _x, GLint _y) {
     std::cout << "Changing to Solid Modle" << endl;
     changeToSolid();
     break;
+
+    case 99:
+    cleanOnLoad = !cleanOnLoad;
+    std::cout << "Mesh cleanup on load " << (cleanOnLoad ? "on" : "off") << endl;
+    break;
+
+    case 102:
+    featureEdgesOnly = !featureEdgesOnly;
+    std::cout << (featureEdgesOnly ? "Feature edges only" : "All edges") << endl;
+    break;
+
+    case 105:
+    showStats = !showStats;
+    break;
+
+    case 116:
+    Trace::write(traceFile);
+    break;
+
+    case 98:
+    clusterCulling = !clusterCulling;
+    std::cout << "Cluster culling " << (clusterCulling ? "on" : "off") << endl;
+    break;
+
+    case 114:
+    dynamicResolution = !dynamicResolution;
+    std::cout << "Dynamic resolution " << (dynamicResolution ? "on" : "off") << endl;
+    break;
+
+    case 109:
+    measureMode = !measureMode;
+    haveMeasurePoint = false;
+    std::cout << "Measure mode " << (measureMode ? "on" : "off") << endl;
+    break;
     // Unhandled
     default:
     std::cout << "Unhandled key: " << (int)(_key) << std::endl;
@@ -346,159 +787,167 @@ specialKeyPressed(GLint _key, GLint _x, GLint _y) {
   }
 }
 
-//Parser Method that takes the filename in and parses as needed
-void readFile(std::string filename){
-  ifstream inFile;
-
-  if(filename.find("obj") == std::string::npos){
-    cout << "File is not supported please provide an obj file" << endl;
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Name of the object a face belongs to
+/// @param face Index of the face
+std::string objectOfFace(int face){
+  std::string name = "(unnamed)";
+  Mesh& mesh = model->geometry->mesh;
+  for(size_t i=0; i<mesh.objectFirstFace.size() && mesh.objectFirstFace[i]<=face; i++)
+    name = mesh.objectNames[i];
+  return name;
+}
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Picks the face under the cursor
+/// @param _x X position of mouse
+/// @param _y Y position of mouse
+/// @param _width Width of the window when the button was pressed
+/// @param _height Height of the window when the button was pressed
+///
+/// Casts a ray through the cursor and picks the closest face. In measure
+/// mode, every second pick prints the distance to the one before.
+void
+pickFace(GLint _x, GLint _y, GLint _width, GLint _height) {
+  using namespace std::chrono;
+
+  // Unproject the cursor with the camera of the packets being drawn
+  GLdouble modelview[16], projection[16];
+  GLint viewport[4] = {0, 0, _width, _height};
+  float view[16], proj[16];
+  Camera::modelview(g_theta, view);
+  Camera::projection(GLfloat(_width)/_height, proj);
+  for(int i=0; i<16; i++){
+    modelview[i] = view[i];
+    projection[i] = proj[i];
+  }
+  GLdouble nx, ny, nz, fx, fy, fz;
+  gluUnProject(_x, viewport[3]-_y, 0.0, modelview, projection, viewport, &nx, &ny, &nz);
+  gluUnProject(_x, viewport[3]-_y, 1.0, modelview, projection, viewport, &fx, &fy, &fz);
+  float origin[3] = {float(nx), float(ny), float(nz)};
+  float direction[3] = {float(fx-nx), float(fy-ny), float(fz-nz)};
+
+  Hit hit;
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  bool found = model->geometry->bvh.intersect(origin, direction, hit);
+  float micro = duration_cast<duration<float, std::micro>>(high_resolution_clock::now()-start).count();
+
+  if(!found){
+    pickedFace = -1;
+    std::cout << "Picked nothing (" << micro << " us)" << std::endl;
+    return;
+  }
+  pickedFace = hit.face;
+  std::cout << "Picked face " << hit.face << " of object " << objectOfFace(hit.face)
+            << " at (" << hit.point[0] << ", " << hit.point[1] << ", " << hit.point[2]
+            << ") in " << micro << " us" << std::endl;
+
+  if(measureMode){
+    if(haveMeasurePoint){
+      float dx = hit.point[0]-measurePoint[0];
+      float dy = hit.point[1]-measurePoint[1];
+      float dz = hit.point[2]-measurePoint[2];
+      std::cout << "Distance: " << std::sqrt(dx*dx+dy*dy+dz*dz) << std::endl;
+      haveMeasurePoint = false;
+    }
+    else{
+      for(int a=0; a<3; a++)
+        measurePoint[a] = hit.point[a];
+      haveMeasurePoint = true;
+    }
   }
+}
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Makes a model of a parsed mesh, building or sharing its geometry
+/// @param mesh Parsed mesh, moved into the geometry if it is new
+/// @param filename File the mesh came from
+/// @param before Mesh and cache bytes in use before the mesh was parsed
+/// @return The model, empty if the mesh has no faces
+std::shared_ptr<Model> buildModel(Mesh& mesh, std::string filename, size_t before){
+  std::shared_ptr<Model> loaded = std::make_shared<Model>();
+  Model& m = *loaded;
+  if(mesh.faces.empty())
+    return loaded;
+
+  //Geometry already loaded from another file is shared rather than built again
+  uint64_t key;
+  {
+    TRACE_ZONE("hash");
+    key = MeshStore::hash(mesh);
+  }
+  m.materials = mesh.materials;
+  std::shared_ptr<Geometry> shared = meshStore.find(key, mesh);
+  if(shared){
+    m.geometry = std::move(shared);
+    cout << "Sharing the geometry of " << m.geometry->source << " ("
+         << m.geometry->bytes/1024.0 << " KB)" << endl;
+  }
   else{
-          inFile.open(filename.c_str());
-          string line;
-          GLfloat point;
-
-      while (getline(inFile,line))
-      {        
-            if(line.substr(0,1).compare("f")==0){
-
-                          int vertex1;
-                          int texture1;
-                          int normal1;
-                          line = line.substr(2);
-                          int count=0;                       
-                          Face newFace;
-                          //Counts how many pairs are there
-                          for(int i=0; i<line.size(); i++){
-                            if(line[i]=='/')
-                              count++;
-                          }                 
-                        
-                          for(int x=0; x<2; x++){
-                               vertex1 = std::stoi(line.substr(0,line.find("/")));
-                               line = line.substr(line.find("/")+1);
-
-                               if(textureHere){
-                                 texture1 = std::stoi(line.substr(0,line.find("/")));
-                                }
-
-                               line = line.substr(line.find("/")+1);
-                               normal1 =std::stoi(line.substr(0,line.find(" ")));
-                               line = line.substr(line.find(" ")+1);
-                            
-                                if(x==0){
-                                  newFace.setV1(v[vertex1-1]);
-                                  if(textureHere){
-                                     newFace.setT1(textures[texture1-1]);
-                                  }
-                                   newFace.setNormal(normals[normal1-1]);
-                               }
-
-                               if(x==1){
-                                  newFace.setV2(v[vertex1-1]);
-                                if(textureHere){
-                                  newFace.setT2(textures[texture1-1]);
-                                }
-                              }
-
-                           }
-
-                          vertex1 = std::stoi(line.substr(0,line.find("/")));
-                          line = line.substr(line.find("/")+1);
-                          if(textureHere){
-                              texture1 = std::stoi(line.substr(0,line.find("/")));
-                             newFace.setT3(textures[texture1-1]);
-                          }
-                           normal1 =std::stoi(line.substr(line.find("/")+1));
-                          newFace.setV3(v[vertex1-1]);
-                          newFace.setIsTriangle(true);
-                        
-                        if(count>6){    
-                          newFace.setIsTriangle(false);
-                          line = line.substr(line.find(" ")+1);
-                          vertex1 = std::stoi(line.substr(0,line.find("/")));
-                        line = line.substr(line.find("/")+1);
-                        if(textureHere){
-                          texture1 = std::stoi(line.substr(0,line.find("/")));
-                          newFace.setT4(textures[texture1-1]);
-                        }
-                        normal1 =std::stoi(line.substr(line.find("/")+1));
-                         newFace.setV4(v[vertex1-1]);
-                        }
-
-                        faces.push_back(newFace);
-                        currentIndexFaces++;
-                        numIndicies++;
-          
-                 }
-
-            //Case for texture
-        else if (line.substr(0,2).compare("vt")==0){
-                  textureHere=true;
-                  Texture newText;
-                  line = line.substr(3);
-                  std::istringstream in(line);
-                  float point;
-
-                  in>>point;
-                  newText.setX(point);   
-                  in>>point;
-                  newText.setY(point);
-                  textures.push_back(newText);
-                  currentIndexTextures++;
-
-          }
-
-             //Case for normals
-          else if (line.substr(0,2).compare("vn")==0){
-                  Normal newNormal;
-                  line = line.substr(3);
-                  std::istringstream in(line);
-                  float point;
-                  for(int x=0; x<2; x++){
-
-                    if(x==0){
-                      in >>point;
-                      newNormal.setX(point);
-                    }
-                    if(x==1){
-                      in >>point;
-                      newNormal.setY(point);
-                    }
-                  }
-                  in>>point;
-                  newNormal.setZ(point);
-                  normals.push_back(newNormal);
-                  currentIndexNormals++;
-          }
-
-              //Case for the vertex
-          else if(line.substr(0,1).compare("v")==0){
-                    Vertex newVertex;
-                    line = line.substr(2);
-                    std::istringstream in(line);
-                    float point;
-                    for(int x=0; x< 2; x++){
-                      if(x==0){
-                        in>>point;
-                        newVertex.setX(point);
-                      }
-                      if(x==1){
-                       in>>point;
-                       newVertex.setY(point);
-                     }
-                   }
-                   in>>point;
-                   newVertex.setZ(point);
-                   v.push_back(newVertex);                   
-                   currentIndexVertex++;
-                   numVertex++;
-         }
-        }
-  inFile.close();
+    Geometry& g = *m.geometry;
+    g.mesh = std::move(mesh);
+    {
+      TRACE_ZONE("bvh build");
+      g.bvh.build(g.mesh.faces, std::max(1u, std::thread::hardware_concurrency()));
+    }
+    cout << "BVH: " << g.bvh.getNodeCount() << " nodes over " << g.bvh.getTriangleCount()
+         << " triangles in " << g.bvh.getBuildTime()*1000.f << " ms" << endl;
+    {
+      TRACE_ZONE("topology");
+      g.topology.build(g.mesh.faces, featureAngle);
+    }
+    g.topology.printReport();
+    {
+      TRACE_ZONE("meshlets");
+      g.meshlets.build(g.mesh.faces, g.mesh.materialFirstFace, g.mesh.materialIndex);
     }
+    g.meshlets.printReport();
+    g.hash = key;
+    g.source = filename;
+    g.bytes = MemoryTracker::getCurrent(MEMORY_MESH) + MemoryTracker::getCurrent(MEMORY_CACHE) - before;
+    meshStore.insert(m.geometry);
+  }
+  m.geometry->models++;
+  m.counted = true;
+
+  //Textures decode in the background and appear once they are uploaded
+  m.materialTextures.assign(m.materials.size(), -1);
+  if(m.geometry->mesh.hasTextures())
+    for(size_t i=0; i<m.materials.size(); i++)
+      if(!m.materials[i].diffuseMap.empty())
+        m.materialTextures[i] = textureCache.request(m.materials[i].diffuseMap);
+
+  //Texture coordinates are only sent for materials that can use them
+  Mesh& drawn = m.geometry->mesh;
+  bool quads = false, textured = false;
+  for(size_t f=0; f<drawn.faces.size() && !quads; f++)
+    quads = !drawn.faces[f].isTriangle();
+  for(size_t i=0; i<m.materials.size(); i++)
+    textured = textured || (drawn.hasTextures() && !m.materials[i].diffuseMap.empty());
+  for(int mode=0; mode<RENDER_MODES; mode++)
+    m.kernels[mode] = DrawKernels::forMode(drawn.hasNormals(), textured, quads, RenderMode(mode));
+  cout << "Draw kernel: " << DrawKernels::name(drawn.hasNormals(), textured,
+                                               quads ? DRAW_QUADS : DRAW_TRIANGLES, true) << endl;
+
+  m.name = filename;
+  m.triangles = m.geometry->mesh.getTriangleCount();
+  MemoryTracker::printReport(filename, m.triangles, m.geometry->bytes);
+  meshStore.printReport();
+  return loaded;
+}
+
+//Parser Method that takes the filename in and parses as needed
+//Returns an empty model when the file cannot be read
+std::shared_ptr<Model> readFile(std::string filename){
+  TRACE_ZONE("readFile");
+  MemoryTracker::resetPeak();
+  size_t before = MemoryTracker::getCurrent(MEMORY_MESH) + MemoryTracker::getCurrent(MEMORY_CACHE);
+  LoadOptions options;
+  options.clean = cleanOnLoad;
+  options.epsilon = cleanEpsilon;
+  options.report = true;
+  Mesh mesh = MeshLoader::load(filename, options);
+  return buildModel(mesh, filename, before);
 }
 
 //Creates the Main Menu
@@ -525,7 +974,6 @@ void mainMenuHandler(int choice){
 
 //SubMenu for Model Color
 void submenuColor(int choice){
-
   switch(choice){
     case 0: 
     cout << "Red" << endl;
@@ -574,7 +1022,6 @@ void submenuColor(int choice){
 
 //SubMenu for Point Size
 void submenuPointSize(int choice){
-
  switch(choice){
    case 0:
    cout << "point size 1.0" << endl;
@@ -627,7 +1074,6 @@ void submenuPointSize(int choice){
 
 //SubMenu for Line Width
 void submenuLineWidth(int choice){
-
  switch(choice){
    case 0:
    cout << "Line size 1.0" << endl;
@@ -706,7 +1152,6 @@ void submenuLineStyle(int choice){
 
 //SubMenu for Background Color
 void submenuBackgroundColor(int choice){
-
   switch(choice){
     case 0: 
     cout << "Red" << endl;
@@ -753,53 +1198,1235 @@ void submenuBackgroundColor(int choice){
   }
 }
 
+//Path of a model converted to binary PLY or STL next to it, written on first use
+std::string convertedModel(std::string source, std::string extension){
+  std::string target = source.substr(0, source.find_last_of('.')) + "." + extension;
+  struct stat info;
+  if(stat(target.c_str(), &info) == 0)
+    return target;
+  Mesh mesh = MeshLoader::load(source);
+  bool written = extension == "ply" ? PlyFile::writeFile(target, mesh, true) :
+                                      StlFile::writeFile(target, mesh, true);
+  if(written)
+    cout << "Wrote " << target << endl;
+  return target;
+}
+
 //SubMenu for Which Model
 void submenuModel(int choice){
-  v.clear();
-    currentIndexVertex=0;
-    normals.clear();
-    currentIndexNormals=0;
-    faces.clear();
-    currentIndexFaces=0;
-    textures.clear();
-    currentIndexTextures=0;
-    numVertex=0;
-    numIndicies=0;
-    textureHere=false;
+  //Packets still being drawn keep the old model alive until they are replaced
+  model = std::make_shared<Model>();
+  pickedFace=-1;
+  haveMeasurePoint=false;
   switch(choice){
     case 0:
     cout << "Bench Model" << endl;
-    readFile("theBench.obj");
+    model = readFile("theBench.obj");
     break;
 
     case 1:
     cout << "Cube Model" << endl;
-    readFile("cube.obj");
+    model = readFile("cube.obj");
     break;
 
     case 2:
     cout << "Skull Model" << endl;
-    readFile("skull.obj");
+    model = readFile("skull.obj");
     break;
 
     case 3:
     cout << "Tree Model" << endl;
-    readFile("tree.obj");
+    model = readFile("tree.obj");
     break;
 
     case 4:
     cout << "Pencil Model" << endl;
-    readFile("pencil.obj");
+    model = readFile("pencil.obj");
     break;
 
     case 5:
     cout << "Palm Model" << endl;
-    readFile("palm.obj");
+    model = readFile("palm.obj");
+    break;
+
+    case 6:
+    cout << "Skull Model (PLY)" << endl;
+    model = readFile(convertedModel("Skull.obj", "ply"));
+    break;
+
+    case 7:
+    cout << "Skull Model (STL)" << endl;
+    model = readFile(convertedModel("Skull.obj", "stl"));
     break;
 
   }
 }
 
+//Menus that can be recorded and replayed, by name
+struct MenuHandler{
+  const char* name;
+  void (*handler)(int);
+};
+
+enum MenuIndex{
+  MENU_COLOR,
+  MENU_BACKGROUND,
+  MENU_LINE_WIDTH,
+  MENU_POINT_SIZE,
+  MENU_LINE_STYLE,
+  MENU_MODEL,
+  MENU_COUNT
+};
+
+MenuHandler menuHandlers[MENU_COUNT] = {
+  {"color", submenuColor},
+  {"background", submenuBackgroundColor},
+  {"lineWidth", submenuLineWidth},
+  {"pointSize", submenuPointSize},
+  {"lineStyle", submenuLineStyle},
+  {"model", submenuModel}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Hands an input event to the simulation thread
+/// @param type key, special, menu or mouse
+/// @param code Key code, menu choice or mouse button
+/// @param menu Name of the menu for menu events
+/// @param _x X position of mouse
+/// @param _y Y position of mouse
+void
+queueInput(std::string type, int code, std::string menu, int _x, int _y) {
+  SimulationInput input;
+  input.event.frame = g_frame;
+  input.event.time = 0.f;
+  input.event.type = type;
+  input.event.code = code;
+  input.event.menu = menu;
+  input.x = _x;
+  input.y = _y;
+  input.width = g_width;
+  input.height = g_height;
+  std::lock_guard<std::mutex> guard(inputLock);
+  inputQueue.push_back(input);
+  inputWake.notify_one();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief GLUT callbacks: record the input and queue it for the simulation
+void
+queueKey(GLubyte _key, GLint _x, GLint _y) {
+  recordInput("key", _key, "");
+  queueInput("key", _key, "", _x, _y);
+}
+
+void
+queueSpecialKey(GLint _key, GLint _x, GLint _y) {
+  recordInput("special", _key, "");
+  queueInput("special", _key, "", _x, _y);
+}
+
+void
+queueMouse(GLint _button, GLint _state, GLint _x, GLint _y) {
+  if(_button == GLUT_LEFT_BUTTON && _state == GLUT_DOWN)
+    queueInput("mouse", _button, "", _x, _y);
+}
+
+template <int MENU>
+void
+queueMenu(int choice) {
+  recordInput("menu", choice, menuHandlers[MENU].name);
+  queueInput("menu", choice, menuHandlers[MENU].name, 0, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Queues the recorded events due this frame as if they just arrived
+void
+replayInput() {
+  InputEvent event;
+  while(recorder.nextEvent(g_frame, event)){
+    queueInput(event.type, event.code, event.menu, 0, 0);
+    replayInputFrame = g_frame;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Applies one input event to the simulation state
+void
+applyInput(SimulationInput& input) {
+  InputEvent& event = input.event;
+  if(event.type == "key")
+    keyPressed(GLubyte(event.code), input.x, input.y);
+  else if(event.type == "special")
+    specialKeyPressed(event.code, input.x, input.y);
+  else if(event.type == "mouse")
+    pickFace(input.x, input.y, input.width, input.height);
+  else if(event.type == "menu"){
+    for(int m=0; m<MENU_COUNT; m++)
+      if(event.menu == menuHandlers[m].name)
+        menuHandlers[m].handler(event.code);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Fills a render packet from the simulation state
+///
+/// Meshlet culling happens here, so the render side only submits.
+void
+fillPacket(RenderPacket& packet) {
+  packet.theta = g_theta;
+  packet.color[0] = red;
+  packet.color[1] = green;
+  packet.color[2] = blue;
+  packet.background[0] = backgroudRed;
+  packet.background[1] = backgroundGreen;
+  packet.background[2] = backgroundBlue;
+  packet.background[3] = backgroundAplha;
+  packet.pointSize = pointSize;
+  packet.lineSize = lineSize;
+  packet.lineStyle = lineStyle;
+  packet.mode = wireFrame ? RENDER_WIRE : (pointModel ? RENDER_POINTS : RENDER_SOLID);
+  packet.featureEdgesOnly = featureEdgesOnly;
+  packet.clusterCulling = clusterCulling;
+  packet.showStats = showStats;
+  packet.dynamicResolution = dynamicResolution;
+  packet.quit = quitRequested;
+  packet.pickedFace = pickedFace;
+  packet.model = model;
+
+  Meshlets& meshlets = model->geometry->meshlets;
+  if(solidModel && clusterCulling){
+    TRACE_ZONE("cluster cull");
+    float eye[3];
+    Camera::eye(g_theta, eye);
+    packet.drawnTriangles = meshlets.cull(eye, packet.visibleClusters);
+  }
+  else{
+    packet.visibleClusters.resize(meshlets.getMeshletCount());
+    for(size_t i=0; i<packet.visibleClusters.size(); i++)
+      packet.visibleClusters[i] = i;
+    packet.drawnTriangles = meshlets.getTriangleCount();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Builds the next render packet and publishes it to the render side
+void
+publishPacket() {
+  TRACE_ZONE("build packet");
+  RenderPacket& packet = packets.getBack();
+  packet.sequence = packets.getPublished()+1;
+  packet.inputFrame = appliedInputFrame;
+  fillPacket(packet);
+  packets.publish();
+  std::lock_guard<std::mutex> guard(inputLock);
+  publishedInputFrame = appliedInputFrame;
+  packetWake.notify_one();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Simulation thread: applies queued input, then builds the next packet
+///
+/// Wakes when the render side takes a packet or input arrives, so it stays one
+/// frame ahead of drawing without spinning.
+void
+simulate() {
+  Trace::setThreadName("simulation");
+  deque<SimulationInput> inputs;
+  while(true){
+    {
+      std::unique_lock<std::mutex> guard(inputLock);
+      inputWake.wait(guard, [](){
+        return simulationStopping || packetTaken || !inputQueue.empty();});
+      if(simulationStopping)
+        return;
+      inputs.swap(inputQueue);
+      packetTaken = false;
+    }
+    for(size_t i=0; i<inputs.size(); i++){
+      applyInput(inputs[i]);
+      appliedInputFrame = std::max(appliedInputFrame, inputs[i].event.frame);
+    }
+    inputs.clear();
+    publishPacket();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Stops the simulation thread before the application exits
+void
+stopSimulation() {
+  {
+    std::lock_guard<std::mutex> guard(inputLock);
+    simulationStopping = true;
+    inputWake.notify_one();
+    packetWake.notify_one();
+  }
+  if(simulationThread.joinable())
+    simulationThread.join();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Prints the frame times of a replay when the application exits
+void
+printReplaySummary() {
+  replayStats.printSummary("Replay");
+  if(!replayJsonFile.empty()){
+    ofstream out(replayJsonFile.c_str());
+    out << "{\"model\": \"" << model->name << "\", \"replay\": " << replayStats.toJson()
+        << ",\n \"memory\": " << MemoryTracker::toJson(model->triangles, model->geometry->bytes) << "}" << std::endl;
+    std::cout << "Wrote " << replayJsonFile << std::endl;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Headless ray throughput benchmark
+/// @param filename Model to build the BVH over
+/// @param count Number of rays to cast
+/// @param jsonFile If not empty, results and memory use are also written here
+///
+/// Rays start on a sphere around the model and aim at random points inside its
+/// bounds, so most of them hit. Reports single and multi-threaded rays/sec.
+void
+benchmarkRays(std::string filename, int count, std::string jsonFile) {
+  using namespace std::chrono;
+  std::shared_ptr<Model> loaded = readFile(filename);
+  BVH& bvh = loaded->geometry->bvh;
+  if(bvh.isEmpty()){
+    std::cout << "Nothing to benchmark in " << filename << std::endl;
+    return;
+  }
+
+  float lo[3], hi[3], center[3];
+  bvh.getBounds(lo, hi);
+  float radius = 0.f;
+  for(int a=0; a<3; a++){
+    center[a] = 0.5f*(lo[a]+hi[a]);
+    radius += (hi[a]-lo[a])*(hi[a]-lo[a]);
+  }
+  radius = std::sqrt(radius);
+
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  vector<float> rays(6*count);
+  for(int i=0; i<count; i++){
+    float z = 2.f*unit(rng)-1.f;
+    float phi = 6.2831853f*unit(rng);
+    float r = std::sqrt(1.f-z*z);
+    float o[3] = {center[0]+radius*r*std::cos(phi), center[1]+radius*r*std::sin(phi), center[2]+radius*z};
+    for(int a=0; a<3; a++){
+      rays[6*i+a] = o[a];
+      rays[6*i+3+a] = lo[a] + (hi[a]-lo[a])*unit(rng) - o[a];
+    }
+  }
+
+  int hits = 0;
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  for(int i=0; i<count; i++){
+    Hit hit;
+    hits += bvh.intersect(&rays[6*i], &rays[6*i+3], hit);
+  }
+  float single = duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  vector<std::thread> workers;
+  start = high_resolution_clock::now();
+  for(int t=0; t<threads; t++)
+    workers.push_back(std::thread([&, t](){
+      for(int i=t; i<count; i+=threads){
+        Hit hit;
+        bvh.intersect(&rays[6*i], &rays[6*i+3], hit);
+      }
+    }));
+  for(size_t t=0; t<workers.size(); t++)
+    workers[t].join();
+  float multi = duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+
+  std::cout << "Rays: " << count << " (" << hits << " hits)" << std::endl;
+  std::cout << "  1 thread:  " << count/single << " rays/sec, "
+            << 1e6f*single/count << " us/ray" << std::endl;
+  std::cout << "  " << threads << " threads: " << count/multi << " rays/sec" << std::endl;
+
+  if(!jsonFile.empty()){
+    ofstream out(jsonFile.c_str());
+    out << "{\"model\": \"" << filename << "\", \"rays\": " << count
+        << ", \"hits\": " << hits << ", \"bvhBuildSeconds\": " << bvh.getBuildTime()
+        << ", \"raysPerSecond\": " << count/single
+        << ", \"threads\": " << threads << ", \"raysPerSecondThreaded\": " << count/multi
+        << ",\n \"memory\": " << MemoryTracker::toJson(bvh.getTriangleCount(), loaded->geometry->bytes) << "}" << std::endl;
+    std::cout << "Wrote " << jsonFile << std::endl;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Load time of one model saved as OBJ, PLY and STL
+/// @param filename Model to convert
+/// @param runs Loads of each file; the median is reported
+/// @param jsonFile If not empty, results are also written here
+/// @return Whether the model could be loaded and converted
+///
+/// The model is written to formats/ as indexed OBJ, binary and ASCII PLY and
+/// binary and ASCII STL, and each file and the original are loaded through
+/// MeshLoader::load. Speedups are against the original OBJ.
+bool
+benchmarkFormats(std::string filename, int runs, std::string jsonFile) {
+  using namespace std::chrono;
+  Mesh mesh = MeshLoader::load(filename);
+  if(mesh.faces.empty()){
+    std::cout << "Nothing to benchmark in " << filename << std::endl;
+    return false;
+  }
+  mkdir("formats", 0755);
+  std::string name = filename.substr(filename.find_last_of('/')+1);
+  std::string stem = "formats/" + name.substr(0, name.find_last_of('.'));
+
+  struct Format{
+    const char* label;
+    std::string file;
+    long bytes = 0;
+    float seconds = 0.f;
+    int triangles = 0;
+  };
+  vector<Format> formats = {{"obj", filename}, {"obj indexed", stem + ".obj"},
+                            {"ply binary", stem + ".ply"}, {"ply ascii", stem + "_ascii.ply"},
+                            {"stl binary", stem + ".stl"}, {"stl ascii", stem + "_ascii.stl"}};
+  IndexedMesh indexed;
+  ObjWriter::optimize(mesh, indexed);
+  if(!ObjWriter::writeFile(formats[1].file, indexed) ||
+     !PlyFile::writeFile(formats[2].file, mesh, true) || !PlyFile::writeFile(formats[3].file, mesh, false) ||
+     !StlFile::writeFile(formats[4].file, mesh, true) || !StlFile::writeFile(formats[5].file, mesh, false))
+    return false;
+
+  for(size_t f=0; f<formats.size(); f++){
+    struct stat info;
+    formats[f].bytes = stat(formats[f].file.c_str(), &info) == 0 ? long(info.st_size) : 0;
+    vector<float> times;
+    for(int r=0; r<runs; r++){
+      high_resolution_clock::time_point start = high_resolution_clock::now();
+      Mesh loaded = MeshLoader::load(formats[f].file);
+      times.push_back(duration_cast<duration<float>>(high_resolution_clock::now()-start).count());
+      formats[f].triangles = loaded.getTriangleCount();
+    }
+    std::sort(times.begin(), times.end());
+    formats[f].seconds = times[times.size()/2];
+  }
+
+  printf("%s: %d triangles, median of %d loads\n", filename.c_str(), mesh.getTriangleCount(), runs);
+  printf("  %-12s %10s %10s %10s %14s %8s\n", "format", "MB", "ms", "MB/s", "triangles/s", "speedup");
+  for(size_t f=0; f<formats.size(); f++)
+    printf("  %-12s %10.2f %10.2f %10.1f %14.0f %7.1fx\n", formats[f].label, formats[f].bytes/1048576.0,
+           formats[f].seconds*1000.f, formats[f].bytes/1048576.0/formats[f].seconds,
+           formats[f].triangles/formats[f].seconds, formats[0].seconds/formats[f].seconds);
+
+  if(!jsonFile.empty()){
+    ofstream out(jsonFile.c_str());
+    out << "{\"model\": \"" << filename << "\", \"triangles\": " << mesh.getTriangleCount()
+        << ", \"runs\": " << runs << ", \"formats\": [";
+    for(size_t f=0; f<formats.size(); f++)
+      out << (f ? ",\n  " : "\n  ") << "{\"format\": \"" << formats[f].label << "\", \"file\": \""
+          << formats[f].file << "\", \"bytes\": " << formats[f].bytes << ", \"seconds\": "
+          << formats[f].seconds << ", \"triangles\": " << formats[f].triangles
+          << ", \"speedup\": " << formats[0].seconds/formats[f].seconds << "}";
+    out << "]}" << std::endl;
+    std::cout << "Wrote " << jsonFile << std::endl;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Makes a core profile context current for a headless mode
+/// @param w Width of a window, if one is needed
+/// @param h Height of a window, if one is needed
+/// @param title Title of a window, if one is needed
+/// @param _argc Command line argument count, for GLUT
+/// @param _argv Command line arguments
+/// @param core False for a compatibility context, which can draw with the
+/// fixed function pipeline too
+///
+/// Uses EGL where it can make a context without a display, otherwise a hidden
+/// GLUT window.
+bool
+createHeadlessContext(int w, int h, const char* title, int& _argc, char** _argv, bool core = true) {
+  if(!Offscreen::createContext(core)){
+    std::cout << "No headless GL context, using a hidden window" << std::endl;
+    glutInit(&_argc, _argv);
+#if   defined(OSX)
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH | (core ? GLUT_3_2_CORE_PROFILE : 0));
+#else
+    if(core){
+      glutInitContextVersion(3, 3);
+      glutInitContextProfile(GLUT_CORE_PROFILE);
+    }
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
+#endif
+    glutInitWindowSize(w, h);
+    glutCreateWindow(title);
+    glutHideWindow();
+  }
+  useShaders = core;
+  return true;
+}
+
+//A frame read back and waiting to be written out
+struct Thumbnail{
+  std::string path;
+  Image image;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Headless turntable thumbnails
+/// @param files Models to render
+/// @param angles Number of orbit angles per model
+/// @param size Width and height of the images in pixels
+/// @param outDir Directory the PNG files are written to
+/// @param jsonFile If not empty, results are also written here
+/// @param _argc Command line argument count, for GLUT if a window is needed
+/// @param _argv Command line arguments
+/// @return Application success status
+///
+/// Renders each model at evenly spaced angles of the viewer's orbit into a
+/// framebuffer object. Pixels come back through a ring of pixel buffers and a
+/// worker thread writes the PNG files, so readback and encoding overlap the
+/// renders that follow. Reports images/sec, not counting model loading.
+int
+renderThumbnails(vector<std::string> files, int angles, int size, std::string outDir,
+                 std::string jsonFile, int& _argc, char** _argv) {
+  using namespace std::chrono;
+  const int RING = 3;
+
+  if(!createHeadlessContext(size, size, "Spiderling thumbnails", _argc, _argv))
+    return 1;
+  if(!shaderRenderer.initialize()){
+    std::cout << "Core profile path unavailable" << std::endl;
+    return 1;
+  }
+  glState.enable(GL_DEPTH_TEST);
+  Offscreen offscreen;
+  if(!offscreen.initialize(size, size, RING))
+    return 1;
+  g_width = size;
+  g_height = size;
+  mkdir(outDir.c_str(), 0755);
+
+  BoundedQueue<unique_ptr<Thumbnail>> encodeQueue(2*RING);
+  std::atomic<int> failures{0};
+  std::thread encoder([&](){
+    Trace::setThreadName("encoder");
+    unique_ptr<Thumbnail> thumbnail;
+    while(encodeQueue.pop(thumbnail)){
+      TRACE_ZONE("encode");
+      if(!Image::save(thumbnail->path, thumbnail->image))
+        failures++;
+    }
+  });
+
+  vector<std::string> names(RING);
+  auto collect = [&](int frame){
+    TRACE_ZONE("readback");
+    unique_ptr<Thumbnail> thumbnail(new Thumbnail());
+    thumbnail->path = names[frame % RING];
+    offscreen.finishReadback(frame % RING, thumbnail->image);
+    encodeQueue.push(std::move(thumbnail));
+  };
+
+  RenderPacket packet;
+  int frames = 0;
+  float loadSeconds = 0.f;
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  for(size_t f=0; f<files.size(); f++){
+    high_resolution_clock::time_point loadStart = high_resolution_clock::now();
+    model = readFile(files[f]);
+    if(model->geometry->mesh.faces.empty()){
+      failures++;
+      continue;
+    }
+    //Every angle should show the textures, so wait for them once per model
+    while(textureCache.getPendingCount() > 0){
+      textureCache.update(TEXTURE_UPLOAD_BYTES);
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+    loadSeconds += duration_cast<duration<float>>(high_resolution_clock::now()-loadStart).count();
+
+    std::string base = files[f].substr(files[f].find_last_of('/')+1);
+    base = base.substr(0, base.find_last_of('.'));
+    for(int a=0; a<angles; a++){
+      TRACE_ZONE("thumbnail");
+      g_theta = 6.2831853f*a/angles;
+      fillPacket(packet);
+      offscreen.bind();
+      renderPacket(packet);
+      char name[32];
+      snprintf(name, sizeof(name), "_%03d.png", a);
+      names[frames % RING] = outDir + "/" + base + name;
+      offscreen.startReadback(frames % RING);
+      if(frames >= RING-1)
+        collect(frames-(RING-1));
+      frames++;
+    }
+  }
+  for(int frame=std::max(0, frames-(RING-1)); frame<frames; frame++)
+    collect(frame);
+  encodeQueue.close();
+  encoder.join();
+  float seconds = duration_cast<duration<float>>(high_resolution_clock::now()-start).count() - loadSeconds;
+
+  std::cout << "Thumbnails: " << frames << " images of " << size << "x" << size << " ("
+            << angles << " angles) in " << seconds << " s, " << frames/seconds << " images/sec" << std::endl;
+  std::cout << "  readback waited " << offscreen.getWaitSeconds()*1000.f << " ms over a ring of "
+            << RING << " pixel buffers, " << int(failures) << " failed" << std::endl;
+
+  if(!jsonFile.empty()){
+    ofstream out(jsonFile.c_str());
+    out << "{\"images\": " << frames << ", \"size\": " << size << ", \"angles\": " << angles
+        << ", \"seconds\": " << seconds << ", \"imagesPerSecond\": " << frames/seconds
+        << ", \"readbackWaitSeconds\": " << offscreen.getWaitSeconds()
+        << ", \"failures\": " << int(failures) << "}" << std::endl;
+    std::cout << "Wrote " << jsonFile << std::endl;
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Places a copy of a model in a scene
+/// @param m Model to place
+/// @param x Position of the centre of the model on the ground
+/// @param ground Height the bottom of the model stands on
+/// @param z Position of the centre of the model on the ground
+/// @param angle Rotation about the vertical axis
+SceneInstance
+placeInstance(std::shared_ptr<Model> m, float x, float ground, float z, float angle) {
+  SceneInstance instance;
+  instance.model = m;
+  float lo[3], hi[3];
+  m->geometry->bvh.getBounds(lo, hi);
+  float c = std::cos(angle), s = std::sin(angle);
+  float* t = instance.transform;
+  for(int i=0; i<16; i++)
+    t[i] = 0.f;
+  t[0] = c; t[2] = -s; t[5] = 1.f; t[8] = s; t[10] = c; t[15] = 1.f;
+  float pivot[3] = {0.5f*(lo[0]+hi[0]), lo[1], 0.5f*(lo[2]+hi[2])};
+  t[12] = x - (c*pivot[0] + s*pivot[2]);
+  t[13] = ground - pivot[1];
+  t[14] = z - (-s*pivot[0] + c*pivot[2]);
+
+  for(int a=0; a<3; a++){
+    instance.boundsMin[a] = FLT_MAX;
+    instance.boundsMax[a] = -FLT_MAX;
+  }
+  for(int corner=0; corner<8; corner++){
+    float p[3] = {corner&1 ? hi[0] : lo[0], corner&2 ? hi[1] : lo[1], corner&4 ? hi[2] : lo[2]};
+    for(int a=0; a<3; a++){
+      float w = t[a]*p[0] + t[4+a]*p[1] + t[8+a]*p[2] + t[12+a];
+      instance.boundsMin[a] = std::min(instance.boundsMin[a], w);
+      instance.boundsMax[a] = std::max(instance.boundsMax[a], w);
+    }
+  }
+  return instance;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Generates a dense scene: a forest around a ring of benches
+/// @param trees Rough number of trees
+///
+/// The orbit camera stays just outside the forest, so from every angle the
+/// nearest trees hide most of the rest.
+vector<SceneInstance>
+denseScene(int trees) {
+  vector<SceneInstance> scene;
+  //The two tree files hold the same geometry with their own materials
+  std::shared_ptr<Model> tree[2] = {readFile("tree.obj"), readFile("lowpolytree.obj")};
+  std::shared_ptr<Model> bench = readFile("theBench.obj");
+  if(tree[0]->geometry->mesh.faces.empty() || tree[1]->geometry->mesh.faces.empty() ||
+     bench->geometry->mesh.faces.empty())
+    return scene;
+  const float GROUND = -2.5f;
+  const float RING = 3.f;
+  const float FOREST = 7.f;
+  const int BENCHES = 6;
+  for(int b=0; b<BENCHES; b++){
+    float phi = 6.2831853f*b/BENCHES;
+    scene.push_back(placeInstance(bench, RING*std::sin(phi), GROUND, RING*std::cos(phi),
+                                  phi+1.5707963f));
+  }
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> jitter(-0.25f, 0.25f);
+  std::uniform_real_distribution<float> turn(0.f, 6.2831853f);
+  float spacing = std::sqrt(3.14159265f*FOREST*FOREST/std::max(1, trees));
+  for(float x=-FOREST; x<=FOREST; x+=spacing)
+    for(float z=-FOREST; z<=FOREST; z+=spacing)
+      if(x*x + z*z <= FOREST*FOREST)
+        scene.push_back(placeInstance(tree[scene.size()%2], x+jitter(rng)*spacing, GROUND, z+jitter(rng)*spacing,
+                                      turn(rng)));
+  return scene;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Headless occlusion culling benchmark on a generated dense scene
+/// @param trees Rough number of trees in the scene
+/// @param frames Frames to draw around the orbit with culling off and on
+/// @param jsonFile If not empty, results are also written here
+/// @param _argc Command line argument count, for GLUT if a window is needed
+/// @param _argv Command line arguments
+/// @return Application success status
+///
+/// With culling on, the OCCLUDERS objects that look largest from the camera
+/// are rasterized into a small CPU depth buffer each frame, and every object
+/// whose bounding box is outside the view or behind them is not drawn. Frame
+/// times include the culling and wait for the GPU to finish.
+int
+benchmarkOcclusion(int trees, int frames, std::string jsonFile, int& _argc, char** _argv) {
+  using namespace std::chrono;
+  const int OCCLUDERS = 16;
+  const int DEPTH_WIDTH = 256;
+  if(!createHeadlessContext(g_width, g_height, "Spiderling occlusion", _argc, _argv))
+    return 1;
+  glState.enable(GL_DEPTH_TEST);
+  Offscreen offscreen;
+  if(!offscreen.initialize(g_width, g_height, 1))
+    return 1;
+  vector<SceneInstance> scene = denseScene(trees);
+  if(scene.empty())
+    return 1;
+
+  //One renderer per distinct geometry, drawn once per instance
+  vector<std::shared_ptr<Geometry>> geometries;
+  vector<unique_ptr<ShaderRenderer>> renderers;
+  vector<int> rendererOf(scene.size());
+  int sceneTriangles = 0;
+  for(size_t i=0; i<scene.size(); i++){
+    size_t r = 0;
+    while(r < geometries.size() && geometries[r] != scene[i].model->geometry)
+      r++;
+    if(r == geometries.size()){
+      geometries.push_back(scene[i].model->geometry);
+      renderers.push_back(unique_ptr<ShaderRenderer>(new ShaderRenderer()));
+      if(!renderers[r]->initialize())
+        return 1;
+      Geometry& g = *scene[i].model->geometry;
+      renderers[r]->upload(g.mesh.faces, g.mesh.hasNormals(), false, g.meshlets);
+    }
+    rendererOf[i] = r;
+    sceneTriangles += scene[i].model->triangles;
+  }
+  std::cout << "Scene: " << scene.size() << " objects, " << sceneTriangles << " triangles, "
+            << frames << " frames of " << g_width << "x" << g_height << std::endl;
+
+  OcclusionCuller culler;
+  int depthHeight = std::max(1, DEPTH_WIDTH*g_height/g_width);
+  FrameStats times[2];
+  float cullSeconds = 0.f;
+  long occluded = 0, outside = 0, occluderTriangles = 0;
+  long drawnTriangles[2] = {0, 0};
+  vector<int> order(scene.size());
+  vector<float> size(scene.size());
+  const float color[3] = {0.5f, 0.5f, 0.5f};
+  for(int cull=0; cull<2; cull++){
+    for(int f=0; f<frames; f++){
+      TRACE_ZONE("occlusion frame");
+      high_resolution_clock::time_point start = high_resolution_clock::now();
+      float theta = 6.2831853f*f/frames;
+      vector<bool> visible(scene.size(), true);
+      if(cull){
+        TRACE_ZONE("occlusion cull");
+        float view[16], projection[16], viewProjection[16], eye[3];
+        Camera::modelview(theta, view);
+        Camera::projection(float(g_width)/g_height, projection);
+        Camera::multiply(projection, view, viewProjection);
+        Camera::eye(theta, eye);
+        culler.beginFrame(viewProjection, DEPTH_WIDTH, depthHeight);
+
+        //Largest on screen first: bounding radius over distance from the eye
+        for(size_t i=0; i<scene.size(); i++){
+          float radius = 0.f, distance = 0.f;
+          for(int a=0; a<3; a++){
+            float extent = scene[i].boundsMax[a]-scene[i].boundsMin[a];
+            float center = 0.5f*(scene[i].boundsMax[a]+scene[i].boundsMin[a]);
+            radius += extent*extent;
+            distance += (center-eye[a])*(center-eye[a]);
+          }
+          size[i] = std::sqrt(radius/distance);
+          order[i] = i;
+        }
+        int occluders = std::min<int>(OCCLUDERS, scene.size());
+        std::partial_sort(order.begin(), order.begin()+occluders, order.end(),
+                          [&](int a, int b){return size[a] > size[b];});
+        for(int o=0; o<occluders; o++)
+          culler.addOccluder(scene[order[o]].model->geometry->mesh.faces, scene[order[o]].transform);
+        culler.buildPyramid();
+        for(size_t i=0; i<scene.size(); i++)
+          visible[i] = culler.isVisible(scene[i].boundsMin, scene[i].boundsMax);
+        cullSeconds += duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+        occluded += culler.getOccluded();
+        outside += culler.getOutside();
+        occluderTriangles += culler.getOccluderTriangles();
+      }
+
+      offscreen.bind();
+      glState.setClearColor(0.f, 0.f, 0.f, 0.f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      for(size_t i=0; i<scene.size(); i++){
+        if(!visible[i])
+          continue;
+        ShaderRenderer& renderer = *renderers[rendererOf[i]];
+        renderer.setTransform(scene[i].transform);
+        renderer.draw(theta, g_width, g_height, RENDER_SOLID, color, 1.f, 1.f, 0xFFFF);
+        drawnTriangles[cull] += scene[i].model->triangles;
+      }
+      glFinish();
+      times[cull].add(duration_cast<duration<float>>(high_resolution_clock::now()-start).count());
+    }
+  }
+
+  times[0].printSummary("Occlusion culling off");
+  times[1].printSummary("Occlusion culling on");
+  std::cout << "  occluded " << float(occluded)/frames << " and outside the view "
+            << float(outside)/frames << " of " << scene.size() << " objects per frame" << std::endl;
+  std::cout << "  triangles drawn per frame " << drawnTriangles[0]/frames << " -> "
+            << drawnTriangles[1]/frames << std::endl;
+  std::cout << "  culling " << 1000.f*cullSeconds/frames << " ms per frame ("
+            << occluderTriangles/frames << " occluder triangles into " << DEPTH_WIDTH << "x"
+            << depthHeight << "), mean frame " << 1000.f*times[0].getMean() << " -> "
+            << 1000.f*times[1].getMean() << " ms" << std::endl;
+
+  if(!jsonFile.empty()){
+    ofstream out(jsonFile.c_str());
+    out << "{\"objects\": " << scene.size() << ", \"triangles\": " << sceneTriangles
+        << ", \"frames\": " << frames << ", \"width\": " << g_width << ", \"height\": " << g_height
+        << ", \"occludedPerFrame\": " << float(occluded)/frames
+        << ", \"outsidePerFrame\": " << float(outside)/frames
+        << ", \"trianglesDrawnOff\": " << drawnTriangles[0]/frames
+        << ", \"trianglesDrawnOn\": " << drawnTriangles[1]/frames
+        << ", \"cullSecondsPerFrame\": " << cullSeconds/frames
+        << ",\n \"off\": " << times[0].toJson() << ",\n \"on\": " << times[1].toJson() << "}" << std::endl;
+    std::cout << "Wrote " << jsonFile << std::endl;
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Resident size of the process in bytes
+///
+/// Where the system only reports the largest resident size so far, that.
+size_t
+residentBytes() {
+#if   defined(LINUX)
+  long pages = 0, resident = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if(statm){
+    if(fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+      resident = 0;
+    fclose(statm);
+  }
+  return size_t(resident)*sysconf(_SC_PAGESIZE);
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#if defined(OSX)
+  return size_t(usage.ru_maxrss);
+#else
+  return size_t(usage.ru_maxrss)*1024;
+#endif
+#endif
+}
+
+//One generated mesh, loaded and drawn by every render path
+struct ScaleRun{
+  std::string shape;
+  int triangles = 0;
+  float generateSeconds = 0.f;
+  float writeSeconds = 0.f;
+  long fileBytes = 0;
+  float parseSeconds = 0.f;
+  float buildSeconds = 0.f;
+  float uploadSeconds = 0.f;
+  size_t trackedPeak = 0;
+  size_t resident = 0;
+  vector<FrameStats> times;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Headless scaling benchmark on generated meshes of growing size
+/// @param shapes Shapes for MeshGenerator::generate: sphere, terrain or a model
+/// file to make copies of
+/// @param maxTriangles Largest size; sizes double from a million up to it
+/// @param frames Frames drawn around the orbit by each render path per size
+/// @param jsonFile If not empty, results are also written here
+/// @param _argc Command line argument count, for GLUT if a window is needed
+/// @param _argv Command line arguments
+/// @return Application success status
+///
+/// Each mesh is saved as binary PLY under generated/ and loaded back, so load
+/// time is parsing plus everything readFile builds (hash, BVH, topology and
+/// meshlets). Then the fixed function pipeline and the GLSL renderer draw it
+/// solid, as wire and as points, waiting for the GPU every frame; the GLSL
+/// upload is timed on its own. A shape stops growing before a size that would
+/// not fit in physical memory, going by the bytes per triangle of the last
+/// size: resident once drawn plus what the load needed only while building.
+int
+benchmarkScale(vector<std::string> shapes, int maxTriangles, int frames, std::string jsonFile,
+               int& _argc, char** _argv) {
+  using namespace std::chrono;
+  const int FIRST_SIZE = 1000000;
+  const double MEMORY_HEADROOM = 0.9;
+  if(!createHeadlessContext(g_width, g_height, "Spiderling scale", _argc, _argv, false))
+    return 1;
+  bool glsl = shaderRenderer.initialize();
+  if(!glsl)
+    std::cout << "GLSL path unavailable in this context, timing fixed function only" << std::endl;
+  glState.enable(GL_DEPTH_TEST);
+  glState.enable(GL_COLOR_MATERIAL);
+  Offscreen offscreen;
+  if(!offscreen.initialize(g_width, g_height, 0))
+    return 1;
+  mkdir("generated", 0755);
+
+  struct Path{
+    const char* label;
+    bool shaders;
+    void (*mode)();
+  };
+  vector<Path> paths = {{"fixed solid", false, changeToSolid}, {"fixed wire", false, changeToWire},
+                        {"fixed points", false, changeToPoints}};
+  if(glsl){
+    paths.push_back({"glsl solid", true, changeToSolid});
+    paths.push_back({"glsl wire", true, changeToWire});
+    paths.push_back({"glsl points", true, changeToPoints});
+  }
+  vector<int> sizes;
+  for(long n=FIRST_SIZE; n<maxTriangles; n*=2)
+    sizes.push_back(int(n));
+  sizes.push_back(maxTriangles);
+  double physical = double(sysconf(_SC_PHYS_PAGES))*sysconf(_SC_PAGESIZE);
+  std::cout << "Sweeping " << shapes.size() << " shapes up to " << maxTriangles << " triangles, "
+            << frames << " frames of " << g_width << "x" << g_height << " per path, "
+            << physical/1073741824.0 << " GB of memory" << std::endl;
+
+  vector<ScaleRun> runs;
+  vector<std::string> stops;
+  RenderPacket packet;
+  for(size_t s=0; s<shapes.size(); s++){
+    std::string name = shapes[s].substr(shapes[s].find_last_of('/')+1);
+    name = name.substr(0, name.find_first_of('.'));
+    double bytesPerTriangle = 0.0;
+    for(size_t z=0; z<sizes.size(); z++){
+      if(bytesPerTriangle*sizes[z] > MEMORY_HEADROOM*physical){
+        char line[160];
+        snprintf(line, sizeof(line), "%s stopped before %d triangles: about %.1f GB needed of %.1f GB",
+                 shapes[s].c_str(), sizes[z], bytesPerTriangle*sizes[z]/1073741824.0,
+                 physical/1073741824.0);
+        std::cout << line << std::endl;
+        stops.push_back(line);
+        break;
+      }
+      ScaleRun run;
+      run.shape = shapes[s];
+      std::string file = "generated/" + name + "_" + std::to_string(sizes[z]) + ".ply";
+
+      //Only the file is kept between generating and loading
+      high_resolution_clock::time_point start = high_resolution_clock::now();
+      {
+        Mesh mesh = MeshGenerator::generate(shapes[s], sizes[z]);
+        if(mesh.faces.empty()){
+          std::cout << "Could not generate " << shapes[s] << std::endl;
+          return 1;
+        }
+        high_resolution_clock::time_point written = high_resolution_clock::now();
+        run.generateSeconds = duration_cast<duration<float>>(written-start).count();
+        if(!PlyFile::writeFile(file, mesh, true))
+          return 1;
+        run.writeSeconds = duration_cast<duration<float>>(high_resolution_clock::now()-written).count();
+      }
+      struct stat info;
+      run.fileBytes = stat(file.c_str(), &info) == 0 ? long(info.st_size) : 0;
+
+      //The last size's geometry goes before the next one is loaded, and empty
+      //uploads hand back its GPU buffers
+      model = std::make_shared<Model>();
+      packet.model = model;
+      uploadedGeometry.reset();
+      if(glsl){
+        FaceList none;
+        Meshlets empty;
+        shaderRenderer.upload(none, false, false, empty);
+        shaderRenderer.uploadPoints(nullptr, 0);
+      }
+      MemoryTracker::resetPeak();
+      size_t before = MemoryTracker::getCurrent(MEMORY_MESH) + MemoryTracker::getCurrent(MEMORY_CACHE);
+      start = high_resolution_clock::now();
+      Mesh mesh = MeshLoader::load(file);
+      high_resolution_clock::time_point parsed = high_resolution_clock::now();
+      model = buildModel(mesh, file, before);
+      run.parseSeconds = duration_cast<duration<float>>(parsed-start).count();
+      run.buildSeconds = duration_cast<duration<float>>(high_resolution_clock::now()-parsed).count();
+      std::remove(file.c_str());
+      run.triangles = model->triangles;
+      if(run.triangles == 0)
+        return 1;
+
+      run.times.resize(paths.size());
+      for(size_t p=0; p<paths.size(); p++){
+        useShaders = paths[p].shaders;
+        paths[p].mode();
+        offscreen.bind();
+        resize(g_width, g_height);
+        //The first frame of a path is not timed, and for GLSL it uploads
+        for(int f=-1; f<frames; f++){
+          TRACE_ZONE("scale frame");
+          start = high_resolution_clock::now();
+          g_theta = 6.2831853f*std::max(0, f)/frames;
+          fillPacket(packet);
+          renderPacket(packet);
+          glFinish();
+          float seconds = duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+          if(f >= 0)
+            run.times[p].add(seconds);
+          else if(paths[p].shaders && run.uploadSeconds == 0.f)
+            run.uploadSeconds = seconds;
+        }
+      }
+      run.trackedPeak = MemoryTracker::getTotalPeak();
+      run.resident = residentBytes();
+      bytesPerTriangle = double(run.resident + run.trackedPeak - MemoryTracker::getTotalCurrent())/run.triangles;
+
+      printf("%s: %d triangles, generate %.2f s, write %.2f s (%.1f MB), load %.2f s + build %.2f s,"
+             " upload %.2f s\n", shapes[s].c_str(), run.triangles, run.generateSeconds, run.writeSeconds,
+             run.fileBytes/1048576.0, run.parseSeconds, run.buildSeconds, run.uploadSeconds);
+      printf("  memory %.1f MB tracked peak (%.0f B/triangle), %.1f MB resident\n",
+             run.trackedPeak/1048576.0, double(run.trackedPeak)/run.triangles, run.resident/1048576.0);
+      for(size_t p=0; p<paths.size(); p++)
+        printf("  %-12s mean %9.2f ms  median %9.2f ms  max %9.2f ms\n", paths[p].label,
+               1000.f*run.times[p].getMean(), 1000.f*run.times[p].getPercentile(50.f),
+               1000.f*run.times[p].getMax());
+      runs.push_back(run);
+    }
+  }
+  model = std::make_shared<Model>();
+  packet.model = model;
+  uploadedGeometry.reset();
+
+  //One row per size, ready to chart
+  printf("\n%-14s %11s %9s %9s %9s", "shape", "triangles", "load s", "peak MB", "rss MB");
+  for(size_t p=0; p<paths.size(); p++)
+    printf(" %12s", paths[p].label);
+  printf("\n");
+  for(size_t r=0; r<runs.size(); r++){
+    printf("%-14s %11d %9.2f %9.1f %9.1f", runs[r].shape.c_str(), runs[r].triangles,
+           runs[r].parseSeconds+runs[r].buildSeconds, runs[r].trackedPeak/1048576.0,
+           runs[r].resident/1048576.0);
+    for(size_t p=0; p<paths.size(); p++)
+      printf(" %12.2f", 1000.f*runs[r].times[p].getMean());
+    printf("\n");
+  }
+  for(size_t i=0; i<stops.size(); i++)
+    std::cout << stops[i] << std::endl;
+
+  if(!jsonFile.empty()){
+    ofstream out(jsonFile.c_str());
+    out << "{\"maxTriangles\": " << maxTriangles << ", \"frames\": " << frames << ", \"width\": " << g_width
+        << ", \"height\": " << g_height << ", \"physicalBytes\": " << physical << ", \"runs\": [";
+    for(size_t r=0; r<runs.size(); r++){
+      out << (r ? ",\n  " : "\n  ") << "{\"shape\": \"" << runs[r].shape << "\", \"triangles\": "
+          << runs[r].triangles << ", \"generateSeconds\": " << runs[r].generateSeconds
+          << ", \"writeSeconds\": " << runs[r].writeSeconds << ", \"fileBytes\": " << runs[r].fileBytes
+          << ", \"parseSeconds\": " << runs[r].parseSeconds << ", \"buildSeconds\": " << runs[r].buildSeconds
+          << ", \"uploadSeconds\": " << runs[r].uploadSeconds << ", \"trackedPeakBytes\": "
+          << runs[r].trackedPeak << ", \"residentBytes\": " << runs[r].resident << ", \"paths\": {";
+      for(size_t p=0; p<paths.size(); p++)
+        out << (p ? ", " : "") << "\"" << paths[p].label << "\": " << runs[r].times[p].toJson();
+      out << "}}";
+    }
+    out << "],\n \"stopped\": [";
+    for(size_t i=0; i<stops.size(); i++)
+      out << (i ? ", " : "") << "\"" << stops[i] << "\"";
+    out << "]}" << std::endl;
+    std::cout << "Wrote " << jsonFile << std::endl;
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Headless microbenchmark of the fixed function draw kernels
+/// @param triangles Rough triangle count of each test model
+/// @param frames Frames drawn around the orbit per kernel
+/// @param jsonFile If not empty, results are also written here
+/// @param _argc Command line argument count, for GLUT if a window is needed
+/// @param _argv Command line arguments
+/// @return Application success status
+///
+/// Copies of Skull.obj test the triangle kernels and copies of pencil.obj the
+/// quad kernels; both have file normals and texture coordinates, so every
+/// variant reads defined data. Every kernel draws all meshlets of the model,
+/// and so do the generic loop and the line and point kernels. Submit time
+/// runs until the kernel returns; frame time waits for the GPU as well.
+/// Speedups are submit time against the generic loop with the same normals,
+/// or with file normals for unlit kernels.
+int
+benchmarkKernels(int triangles, int frames, std::string jsonFile, int& _argc, char** _argv) {
+  using namespace std::chrono;
+  if(!createHeadlessContext(g_width, g_height, "Spiderling kernels", _argc, _argv, false))
+    return 1;
+  glState.enable(GL_DEPTH_TEST);
+  glState.enable(GL_COLOR_MATERIAL);
+  Offscreen offscreen;
+  if(!offscreen.initialize(g_width, g_height, 0))
+    return 1;
+  offscreen.bind();
+  resize(g_width, g_height);
+  clusterCulling = false;
+  changeToSolid();
+
+  struct Variant{
+    std::string label;
+    DrawKernel kernel;
+    RenderMode mode;
+    bool lit;
+    int generic;
+    float submit = 0.f;
+    float frame = 0.f;
+  };
+  struct Test{
+    const char* file;
+    DrawPrimitive primitive;
+    int triangles;
+    vector<Variant> variants;
+  };
+  vector<Test> tests = {{"Skull.obj", DRAW_TRIANGLES, 0, {}}, {"pencil.obj", DRAW_QUADS, 0, {}}};
+  RenderPacket packet;
+  for(size_t t=0; t<tests.size(); t++){
+    Test& test = tests[t];
+    Mesh source = MeshLoader::load(test.file);
+    size_t before = MemoryTracker::getCurrent(MEMORY_MESH) + MemoryTracker::getCurrent(MEMORY_CACHE);
+    Mesh mesh = MeshGenerator::instances(source, triangles);
+    if(mesh.faces.empty() || !mesh.hasNormals() || !mesh.hasTextures())
+      return 1;
+    model = buildModel(mesh, test.file, before);
+    test.triangles = model->triangles;
+    while(textureCache.getPendingCount() > 0){
+      textureCache.update(TEXTURE_UPLOAD_BYTES);
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+
+    //The generic loops come first, so every kernel has one to compare with
+    test.variants.push_back({"generic, file normals", [](const DrawSpan& span){
+      DrawKernels::drawGeneric(span, true);}, RENDER_SOLID, true, -1});
+    test.variants.push_back({"generic, computed normals", [](const DrawSpan& span){
+      DrawKernels::drawGeneric(span, false);}, RENDER_SOLID, true, -1});
+    //Without lighting no normals are sent, so which kind does not matter
+    for(int variant=0; variant<6; variant++){
+      bool lit = variant < 4, normals = lit && variant < 2, textured = variant % 2 == 0;
+      test.variants.push_back({DrawKernels::name(normals, textured, test.primitive, lit),
+                               DrawKernels::select(normals, textured, test.primitive, lit),
+                               RENDER_SOLID, lit, normals || !lit ? 0 : 1});
+    }
+    test.variants.push_back({"lines", DrawKernels::select(false, false, DRAW_LINES, false),
+                             RENDER_WIRE, false, -1});
+    test.variants.push_back({"points", DrawKernels::select(false, false, DRAW_POINTS, false),
+                             RENDER_POINTS, false, -1});
+
+    for(size_t v=0; v<test.variants.size(); v++){
+      Variant& variant = test.variants[v];
+      model->kernels[variant.mode] = variant.kernel;
+      fillPacket(packet);
+      packet.mode = variant.mode;
+      float submit = 0.f, frame = 0.f;
+      //The first frame is not timed
+      for(int f=-1; f<frames; f++){
+        TRACE_ZONE("kernel frame");
+        float view[16];
+        Camera::modelview(6.2831853f*std::max(0, f)/frames, view);
+        glState.setClearColor(0.f, 0.f, 0.f, 0.f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        setupLight();
+        glLoadMatrixf(view);
+        if(variant.lit)
+          glState.enable(GL_LIGHTING);
+        else
+          glState.disable(GL_LIGHTING);
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+        if(variant.mode == RENDER_SOLID)
+          drawClusters(packet);
+        else
+          drawTopology(packet);
+        high_resolution_clock::time_point submitted = high_resolution_clock::now();
+        glFinish();
+        if(f >= 0){
+          submit += duration_cast<duration<float>>(submitted-start).count();
+          frame += duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+        }
+      }
+      variant.submit = submit/frames;
+      variant.frame = frame/frames;
+    }
+
+    printf("%s copies: %d triangles, %d frames of %dx%d per kernel\n", test.file, test.triangles,
+           frames, g_width, g_height);
+    printf("  %-44s %10s %10s %14s %8s\n", "kernel", "submit ms", "frame ms", "triangles/s", "speedup");
+    for(size_t v=0; v<test.variants.size(); v++){
+      Variant& variant = test.variants[v];
+      printf("  %-44s %10.2f %10.2f %14.0f", variant.label.c_str(), 1000.f*variant.submit,
+             1000.f*variant.frame, test.triangles/variant.submit);
+      if(variant.generic >= 0)
+        printf(" %7.2fx", test.variants[variant.generic].submit/variant.submit);
+      printf("\n");
+    }
+  }
+  model = std::make_shared<Model>();
+  packet.model = model;
+
+  if(!jsonFile.empty()){
+    ofstream out(jsonFile.c_str());
+    out << "{\"frames\": " << frames << ", \"width\": " << g_width << ", \"height\": " << g_height
+        << ", \"models\": [";
+    for(size_t t=0; t<tests.size(); t++){
+      out << (t ? ",\n  " : "\n  ") << "{\"model\": \"" << tests[t].file << "\", \"triangles\": "
+          << tests[t].triangles << ", \"kernels\": [";
+      for(size_t v=0; v<tests[t].variants.size(); v++){
+        Variant& variant = tests[t].variants[v];
+        out << (v ? ",\n    " : "\n    ") << "{\"kernel\": \"" << variant.label << "\", \"submitMs\": "
+            << 1000.f*variant.submit << ", \"frameMs\": " << 1000.f*variant.frame;
+        if(variant.generic >= 0)
+          out << ", \"speedup\": " << tests[t].variants[variant.generic].submit/variant.submit;
+        out << "}";
+      }
+      out << "]}";
+    }
+    out << "]}" << std::endl;
+    std::cout << "Wrote " << jsonFile << std::endl;
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Reads a whole command line argument as a number
+/// @param text Argument to read
+/// @param value Set to the number, and left alone if the argument is not one
+/// @return Whether the whole argument was a number
+bool
+readNumber(const char* text, int& value) {
+  char* end;
+  long number = strtol(text, &end, 10);
+  if(end == text || *end || number < INT_MIN || number > INT_MAX)
+    return false;
+  value = int(number);
+  return true;
+}
+
+bool
+readNumber(const char* text, float& value) {
+  char* end;
+  float number = strtof(text, &end);
+  if(end == text || *end || !std::isfinite(number))
+    return false;
+  value = number;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Writes the trace when the application exits
+void
+writeTraceAtExit() {
+  Trace::write(traceFile);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Main
 
@@ -810,24 +2437,188 @@ void submenuModel(int choice){
 /// @return Application success status
 int
 main(int _argc, char** _argv) {
+  //////////////////////////////////////////////////////////////////////////////
+  // Headless modes, run before GLUT needs a display
+  Trace::setThreadName("main");
+  std::string jsonFile;
+  for(int i=1; i<_argc; i++){
+    std::string arg = _argv[i];
+    if(arg == "-json" && i+1 < _argc)
+      jsonFile = _argv[i+1];
+    else if(arg == "-trace"){
+      if(i+1 < _argc && _argv[i+1][0] != '-')
+        traceFile = _argv[i+1];
+      Trace::setEnabled(true);
+      atexit(writeTraceAtExit);
+    }
+  }
+  for(int i=1; i<_argc; i++){
+    if(std::string(_argv[i]) == "-benchRays"){
+      std::string file = i+1 < _argc && _argv[i+1][0] != '-' ? _argv[i+1] : "Skull.obj";
+      int count = 1000000;
+      if(i+2 < _argc)
+        readNumber(_argv[i+2], count);
+      benchmarkRays(file, std::max(1, count), jsonFile);
+      return 0;
+    }
+  }
+  for(int i=1; i<_argc; i++){
+    if(std::string(_argv[i]) == "-benchFormats"){
+      std::string file = i+1 < _argc && _argv[i+1][0] != '-' ? _argv[i+1] : "Skull.obj";
+      int runs = 5;
+      if(i+2 < _argc)
+        readNumber(_argv[i+2], runs);
+      return benchmarkFormats(file, std::max(1, runs), jsonFile) ? 0 : 1;
+    }
+  }
+  for(int i=1; i<_argc; i++){
+    if(std::string(_argv[i]) == "-benchOcclusion"){
+      int trees = 400, frames = 30;
+      if(i+1 < _argc)
+        readNumber(_argv[i+1], trees);
+      if(i+2 < _argc)
+        readNumber(_argv[i+2], frames);
+      return benchmarkOcclusion(std::max(1, trees), std::max(1, frames), jsonFile, _argc, _argv);
+    }
+  }
+  for(int i=1; i<_argc; i++){
+    if(std::string(_argv[i]) == "-benchScale"){
+      int maxTriangles = 100000000, frames = 5;
+      if(i+1 < _argc && readNumber(_argv[i+1], maxTriangles))
+        i++;
+      if(i+1 < _argc && readNumber(_argv[i+1], frames))
+        i++;
+      vector<std::string> shapes;
+      for(int j=i+1; j<_argc; j++){
+        std::string arg = _argv[j];
+        if((arg == "-json" || arg == "-trace") && j+1 < _argc && _argv[j+1][0] != '-')
+          j++;
+        else if(arg[0] != '-')
+          shapes.push_back(arg);
+      }
+      if(shapes.empty())
+        shapes = {"sphere", "terrain", "Skull.obj"};
+      return benchmarkScale(shapes, std::max(1, maxTriangles), std::max(1, frames), jsonFile, _argc, _argv);
+    }
+  }
+  for(int i=1; i<_argc; i++){
+    if(std::string(_argv[i]) == "-benchKernels"){
+      int triangles = 1000000, frames = 10;
+      if(i+1 < _argc)
+        readNumber(_argv[i+1], triangles);
+      if(i+2 < _argc)
+        readNumber(_argv[i+2], frames);
+      return benchmarkKernels(std::max(1, triangles), std::max(1, frames), jsonFile, _argc, _argv);
+    }
+  }
+  for(int i=1; i<_argc; i++){
+    if(std::string(_argv[i]) == "-thumbnails"){
+      int angles = 8;
+      if(i+1 < _argc && readNumber(_argv[i+1], angles))
+        i++;
+      int size = 256;
+      std::string outDir = "thumbnails";
+      vector<std::string> files;
+      for(int j=i+1; j<_argc; j++){
+        std::string arg = _argv[j];
+        if(arg == "-thumbnailSize" && j+1 < _argc){
+          if(!readNumber(_argv[++j], size) || size < 1){
+            std::cout << "-thumbnailSize needs pixels, not " << _argv[j] << std::endl;
+            return 1;
+          }
+        }
+        else if(arg == "-thumbnailDir" && j+1 < _argc)
+          outDir = _argv[++j];
+        else if((arg == "-json" || arg == "-trace") && j+1 < _argc && _argv[j+1][0] != '-')
+          j++;
+        else if(arg[0] != '-')
+          files.push_back(arg);
+      }
+      if(files.empty())
+        files = {"theBench.obj", "cube.obj", "Skull.obj", "tree.obj", "pencil.obj", "palm.obj"};
+      return renderThumbnails(files, std::max(1, angles), size, outDir, jsonFile, _argc, _argv);
+    }
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Initialize GLUT Window
   std::cout << "Initializing GLUTWindow" << std::endl;
   // GLUT
   glutInit(&_argc, _argv);
+
+  //Command line options left over after GLUT removed its own
+  std::string startModel = "theBench.obj";
+  for(int i=1; i<_argc; i++){
+    std::string arg = _argv[i];
+    if(arg == "-clean"){
+      cleanOnLoad = true;
+      if(i+1 < _argc && readNumber(_argv[i+1], cleanEpsilon))
+        i++;
+    }
+    else if(arg == "-glsl")
+      useShaders = true;
+    else if(arg == "-dynamicResolution"){
+      dynamicResolution = true;
+      float milliseconds;
+      if(i+1 < _argc && readNumber(_argv[i+1], milliseconds) && milliseconds > 0.f){
+        resolution.setBudget(milliseconds/1000.f);
+        i++;
+      }
+    }
+    else if(arg == "-model" && i+1 < _argc)
+      startModel = _argv[++i];
+    else if(arg == "-featureAngle" && i+1 < _argc){
+      if(!readNumber(_argv[++i], featureAngle))
+        std::cout << "-featureAngle needs degrees, not " << _argv[i] << std::endl;
+    }
+    else if(arg == "-textureBudget" && i+1 < _argc){
+      float megabytes;
+      if(readNumber(_argv[++i], megabytes) && megabytes >= 0.f)
+        textureCache.setBudget(size_t(megabytes*1048576.0));
+      else
+        std::cout << "-textureBudget needs megabytes, not " << _argv[i] << std::endl;
+    }
+    else if(arg == "-trace" && i+1 < _argc && _argv[i+1][0] != '-')
+      i++;
+    else if(arg == "-record" && i+1 < _argc){
+      if(!recorder.startRecording(_argv[++i]))
+        return 1;
+    }
+    else if(arg == "-replay" && i+1 < _argc){
+      if(!recorder.startReplay(_argv[++i]))
+        return 1;
+      replayJsonFile = jsonFile;
+      atexit(printReplaySummary);
+    }
+  }
+
+#if   defined(OSX)
+  glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH |
+                      (useShaders ? GLUT_3_2_CORE_PROFILE : 0));
+#else
+  if(useShaders){
+    glutInitContextVersion(3, 3);
+    glutInitContextProfile(GLUT_CORE_PROFILE);
+  }
   glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
+#endif
   glutInitWindowPosition(50, 100);
   glutInitWindowSize(g_width, g_height); // HD size
   g_window = glutCreateWindow("Spiderling: A Rudamentary Game Engine");
 
-  readFile("theBench.obj");
+  model = readFile(startModel);
 
 
   // GL
   initialize();
 
+  // Simulation runs on its own thread from the first packet on
+  publishPacket();
+  simulationThread = std::thread(simulate);
+  atexit(stopSimulation);
+
   
-  submenuColorID = glutCreateMenu(submenuColor);
+  submenuColorID = glutCreateMenu(queueMenu<MENU_COLOR>);
   glutAddMenuEntry("Red",0);
   glutAddMenuEntry("Orange",1);
   glutAddMenuEntry("Yellow",2);
@@ -836,7 +2627,7 @@ main(int _argc, char** _argv) {
   glutAddMenuEntry("Purple",5);
   glutAddMenuEntry("Grey",6);
 
-  submenuBackgroundColorID = glutCreateMenu(submenuBackgroundColor);
+  submenuBackgroundColorID = glutCreateMenu(queueMenu<MENU_BACKGROUND>);
   glutAddMenuEntry("Red",0);
   glutAddMenuEntry("Orange",1);
   glutAddMenuEntry("Yellow",2);
@@ -846,7 +2637,7 @@ main(int _argc, char** _argv) {
   glutAddMenuEntry("Black",6);
 
 
-  submenuLineWidthID= glutCreateMenu(submenuLineWidth);
+  submenuLineWidthID= glutCreateMenu(queueMenu<MENU_LINE_WIDTH>);
   glutAddMenuEntry("0.1",6);
   glutAddMenuEntry("0.5",7);
   glutAddMenuEntry("1.0",0);
@@ -857,7 +2648,7 @@ main(int _argc, char** _argv) {
   glutAddMenuEntry("6.0",5);
 
 
-  submenuPointSizeID= glutCreateMenu(submenuPointSize);
+  submenuPointSizeID= glutCreateMenu(queueMenu<MENU_POINT_SIZE>);
   glutAddMenuEntry("0.1",6);
   glutAddMenuEntry("0.5",7);
   glutAddMenuEntry("1.0",0);
@@ -867,19 +2658,21 @@ main(int _argc, char** _argv) {
   glutAddMenuEntry("5.0",4);
   glutAddMenuEntry("6.0",5);
 
-  submenuLineStyleID = glutCreateMenu(submenuLineStyle);
+  submenuLineStyleID = glutCreateMenu(queueMenu<MENU_LINE_STYLE>);
   glutAddMenuEntry("Dash-dot",0);
   glutAddMenuEntry("Dashed",1);
   glutAddMenuEntry("Dotted",2);
   glutAddMenuEntry("Solid",3);
 
-  submenuModelID = glutCreateMenu(submenuModel);
+  submenuModelID = glutCreateMenu(queueMenu<MENU_MODEL>);
   glutAddMenuEntry("Skull",2);
   glutAddMenuEntry("Cube",1);
   glutAddMenuEntry("Bench",0);
   glutAddMenuEntry("Tree",3);
   glutAddMenuEntry("Pencil",4);
   glutAddMenuEntry("Palm",5);
+  glutAddMenuEntry("Skull (PLY)",6);
+  glutAddMenuEntry("Skull (STL)",7);
 
 
 
@@ -904,8 +2697,9 @@ main(int _argc, char** _argv) {
   std::cout << "Assigning Callback functions" << std::endl;
   glutReshapeFunc(resize);
   glutDisplayFunc(draw);
-  glutKeyboardFunc(keyPressed);
-  glutSpecialFunc(specialKeyPressed);
+  glutKeyboardFunc(queueKey);
+  glutSpecialFunc(queueSpecialKey);
+  glutMouseFunc(queueMouse);
   glutTimerFunc(1000/FPS, timer, 0);
 
   // Start application
@@ -0,0 +1,325 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Headless batch processor for directories of OBJ, PLY and STL files
+///
+/// Runs parse, clean, optimize and write as separate stages, each with its own
+/// workers, connected by bounded queues so a fast stage cannot run arbitrarily
+/// far ahead of a slow one. Reports per-stage throughput and the slowest files.
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Includes
+
+// STL
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include "BoundedQueue.h"
+#include "DecompressStream.h"
+#include "Mesh.h"
+#include "MeshCleaner.h"
+#include "MeshLoader.h"
+#include "ObjWriter.h"
+#include "Trace.h"
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// Pipeline
+
+enum Stage{
+  STAGE_PARSE,
+  STAGE_CLEAN,
+  STAGE_OPTIMIZE,
+  STAGE_WRITE,
+  STAGE_COUNT
+};
+
+const char* stageNames[STAGE_COUNT] = {"parse", "clean", "optimize", "write"};
+const char* workerNames[STAGE_COUNT] = {"parse worker", "clean worker", "optimize worker", "write worker"};
+
+//One file travelling through the stages
+struct Job{
+  string path;
+  string output;
+  long bytes;
+  Mesh mesh;
+  IndexedMesh indexed;
+  float seconds[STAGE_COUNT];
+};
+
+typedef unique_ptr<Job> JobPtr;
+
+//Totals of one stage across its workers
+struct StageStats{
+  mutex lock;
+  int files;
+  long bytes;
+  float busy;
+  float blocked;
+};
+
+struct Options{
+  int threads;
+  int queue;
+  string outDir;
+  string traceFile;
+  bool clean;
+  float epsilon;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Does the work of one stage on one file
+/// @return Whether the file should continue down the pipeline
+bool runStage(int stage, Job& job, Options& options){
+  TRACE_ZONE(stageNames[stage]);
+  switch(stage){
+    case STAGE_PARSE:
+    job.mesh = MeshLoader::load(job.path);
+    return !job.mesh.faces.empty();
+
+    case STAGE_CLEAN:
+    if(options.clean){
+      MeshCleaner cleaner(options.epsilon);
+      cleaner.clean(job.mesh);
+    }
+    return true;
+
+    case STAGE_OPTIMIZE:
+    ObjWriter::optimize(job.mesh, job.indexed);
+    job.mesh.clear();
+    return true;
+
+    case STAGE_WRITE:
+    {
+      bool ok = ObjWriter::writeFile(options.outDir + "/" + job.output, job.indexed);
+      job.indexed = IndexedMesh();
+      return ok;
+    }
+  }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Names the output of every input, all different
+///
+/// PLY and STL inputs are written out as OBJ too, so a/x.obj, b/x.obj and
+/// x.ply would all become x.obj; later ones are numbered x-2.obj, x-3.obj
+/// rather than overwrite each other from concurrent writers.
+vector<string> outputNames(vector<string>& inputs){
+  vector<string> names;
+  set<string> used;
+  for(size_t i=0; i<inputs.size(); i++){
+    string name = DecompressStream::uncompressedName(inputs[i].substr(inputs[i].find_last_of('/')+1));
+    string base = name.substr(0, name.find_last_of('.'));
+    name = base + ".obj";
+    for(int n=2; used.count(name); n++)
+      name = base + "-" + to_string(n) + ".obj";
+    if(name != base + ".obj")
+      cout << "Writing " << inputs[i] << " as " << name << ", another input has its name" << endl;
+    used.insert(name);
+    names.push_back(name);
+  }
+  return names;
+}
+
+//Reads a whole argument as a number, without throwing on anything else
+bool readNumber(const char* text, int& value){
+  char* end;
+  long number = strtol(text, &end, 10);
+  if(end == text || *end || number < INT_MIN || number > INT_MAX)
+    return false;
+  value = int(number);
+  return true;
+}
+
+bool readNumber(const char* text, float& value){
+  char* end;
+  value = strtof(text, &end);
+  return end != text && !*end && std::isfinite(value);
+}
+
+long fileSize(string path){
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 ? long(info.st_size) : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief main
+/// @param _argc Count of command line arguments
+/// @param _argv Command line arguments
+/// @return Application success status
+int
+main(int _argc, char** _argv) {
+  using namespace std::chrono;
+
+  Options options;
+  options.threads = max(1, int(thread::hardware_concurrency())/STAGE_COUNT);
+  options.queue = 0;
+  options.outDir = "optimized";
+  options.clean = true;
+  options.epsilon = 1e-4f;
+
+  vector<string> inputs;
+  bool usage = false;
+  for(int i=1; i<_argc && !usage; i++){
+    string arg = _argv[i];
+    if(arg == "-j" && i+1 < _argc)
+      usage = !readNumber(_argv[++i], options.threads) || options.threads < 1;
+    else if(arg == "-q" && i+1 < _argc)
+      usage = !readNumber(_argv[++i], options.queue) || options.queue < 1;
+    else if(arg == "-o" && i+1 < _argc)
+      options.outDir = _argv[++i];
+    else if(arg == "-clean" && i+1 < _argc)
+      usage = !readNumber(_argv[++i], options.epsilon) || options.epsilon < 0.f;
+    else if(arg == "-noclean")
+      options.clean = false;
+    else if(arg == "-trace" && i+1 < _argc)
+      options.traceFile = _argv[++i];
+    else
+      MeshLoader::collectInputs(arg, inputs);
+  }
+  if(options.queue == 0)
+    options.queue = 2*options.threads;
+
+  if(inputs.empty() || usage){
+    cout << "Usage: " << _argv[0] << " [-j workers per stage] [-q queue size]"
+         << " [-o output dir] [-clean epsilon | -noclean] [-trace file]"
+         << " files or directories" << endl;
+    return 1;
+  }
+  mkdir(options.outDir.c_str(), 0755);
+  Trace::setEnabled(!options.traceFile.empty());
+  Trace::setThreadName("main");
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Queues feed each stage; the last one collects finished jobs
+  vector<unique_ptr<BoundedQueue<JobPtr>>> queues;
+  for(int s=0; s<=STAGE_COUNT; s++)
+    queues.push_back(unique_ptr<BoundedQueue<JobPtr>>(new BoundedQueue<JobPtr>(options.queue)));
+
+  StageStats stats[STAGE_COUNT];
+  atomic<int> running[STAGE_COUNT];
+  atomic<int> failures{0};
+  for(int s=0; s<STAGE_COUNT; s++){
+    stats[s].files = 0;
+    stats[s].bytes = 0;
+    stats[s].busy = 0.f;
+    stats[s].blocked = 0.f;
+    running[s] = options.threads;
+  }
+
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+
+  vector<thread> workers;
+  for(int s=0; s<STAGE_COUNT; s++)
+    for(int w=0; w<options.threads; w++)
+      workers.push_back(thread([&, s](){
+        Trace::setThreadName(workerNames[s]);
+        JobPtr job;
+        while(queues[s]->pop(job)){
+          high_resolution_clock::time_point t0 = high_resolution_clock::now();
+          bool ok = runStage(s, *job, options);
+          high_resolution_clock::time_point t1 = high_resolution_clock::now();
+          job->seconds[s] = duration_cast<duration<float>>(t1-t0).count();
+
+          {
+            lock_guard<mutex> guard(stats[s].lock);
+            stats[s].files++;
+            stats[s].bytes += job->bytes;
+            stats[s].busy += job->seconds[s];
+          }
+
+          if(!ok){
+            cout << "Failed to " << stageNames[s] << " " << job->path << endl;
+            failures++;
+            continue;
+          }
+          queues[s+1]->push(std::move(job));
+          float blocked = duration_cast<duration<float>>(high_resolution_clock::now()-t1).count();
+          lock_guard<mutex> guard(stats[s].lock);
+          stats[s].blocked += blocked;
+        }
+        //Last worker out closes the next stage's input
+        if(--running[s] == 0)
+          queues[s+1]->close();
+      }));
+
+  //Drain finished jobs while the feeder blocks on a full first queue
+  vector<JobPtr> done;
+  thread collector([&](){
+    JobPtr job;
+    while(queues[STAGE_COUNT]->pop(job))
+      done.push_back(std::move(job));
+  });
+
+  vector<string> outputs = outputNames(inputs);
+  for(size_t i=0; i<inputs.size(); i++){
+    JobPtr job(new Job());
+    job->path = inputs[i];
+    job->output = outputs[i];
+    job->bytes = fileSize(inputs[i]);
+    for(int s=0; s<STAGE_COUNT; s++)
+      job->seconds[s] = 0.f;
+    queues[0]->push(std::move(job));
+  }
+  queues[0]->close();
+
+  for(size_t i=0; i<workers.size(); i++)
+    workers[i].join();
+  collector.join();
+  float wall = duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Report
+  long totalBytes = 0;
+  for(size_t i=0; i<inputs.size(); i++)
+    totalBytes += fileSize(inputs[i]);
+
+  printf("%zu files (%.1f MB) in %.3f s, %d failed, %d workers per stage, queue %d\n",
+         inputs.size(), totalBytes/1048576.0, wall, int(failures), options.threads, options.queue);
+  printf("%-10s %8s %10s %10s %10s %10s\n", "stage", "files", "busy s", "files/s", "MB/s", "blocked s");
+  for(int s=0; s<STAGE_COUNT; s++){
+    float busy = max(stats[s].busy, 1e-9f);
+    printf("%-10s %8d %10.3f %10.1f %10.1f %10.3f\n", stageNames[s], stats[s].files, stats[s].busy,
+           stats[s].files*options.threads/busy, stats[s].bytes/1048576.0*options.threads/busy,
+           stats[s].blocked);
+  }
+
+  sort(done.begin(), done.end(), [](const JobPtr& a, const JobPtr& b){
+    float ta=0.f, tb=0.f;
+    for(int s=0; s<STAGE_COUNT; s++){
+      ta += a->seconds[s];
+      tb += b->seconds[s];
+    }
+    return ta > tb;
+  });
+  printf("Slowest files:\n");
+  for(size_t i=0; i<done.size() && i<5; i++){
+    float total=0.f;
+    for(int s=0; s<STAGE_COUNT; s++)
+      total += done[i]->seconds[s];
+    printf("  %8.3f s  %s (", total, done[i]->path.c_str());
+    for(int s=0; s<STAGE_COUNT; s++)
+      printf("%s%s %.3f", s ? ", " : "", stageNames[s], done[i]->seconds[s]);
+    printf(")\n");
+  }
+
+  if(!options.traceFile.empty())
+    Trace::write(options.traceFile);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief Multithreaded stress run of the mesh library
+///
+/// Loads every input once on one thread for reference, then has a pool of
+/// threads load all of them again, round after round, at the same time, and
+/// checks each concurrent load against its reference. Links against
+/// libspidermesh.a alone, with no window or GL.
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// Includes
+
+// STL
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Memory.h"
+#include "Mesh.h"
+#include "MeshLoader.h"
+#include "Trace.h"
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// Comparison
+
+bool sameVertex(Vertex a, Vertex b){
+  return a.getX() == b.getX() && a.getY() == b.getY() && a.getZ() == b.getZ();
+}
+
+bool sameTexture(Texture a, Texture b){
+  return a.getX() == b.getX() && a.getY() == b.getY();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Whether two loads of one file produced the same mesh
+///
+/// NaN coordinates never compare equal, so a file holding them always reports
+/// a mismatch; none of the bundled models do.
+bool sameMesh(Mesh& a, Mesh& b){
+  if(a.vertices.size() != b.vertices.size() || a.normals.size() != b.normals.size() ||
+     a.textures.size() != b.textures.size() || a.faces.size() != b.faces.size() ||
+     a.objectNames != b.objectNames || a.objectFirstFace != b.objectFirstFace ||
+     a.materialFirstFace != b.materialFirstFace || a.materialIndex != b.materialIndex ||
+     a.materials.size() != b.materials.size())
+    return false;
+  for(size_t i=0; i<a.vertices.size(); i++)
+    if(!sameVertex(a.vertices[i], b.vertices[i]))
+      return false;
+  for(size_t i=0; i<a.normals.size(); i++)
+    if(a.normals[i].getX() != b.normals[i].getX() || a.normals[i].getY() != b.normals[i].getY() ||
+       a.normals[i].getZ() != b.normals[i].getZ())
+      return false;
+  for(size_t i=0; i<a.textures.size(); i++)
+    if(!sameTexture(a.textures[i], b.textures[i]))
+      return false;
+  for(size_t f=0; f<a.faces.size(); f++){
+    Face& fa = a.faces[f];
+    Face& fb = b.faces[f];
+    if(fa.isTriangle() != fb.isTriangle() || !sameVertex(fa.getV1(), fb.getV1()) ||
+       !sameVertex(fa.getV2(), fb.getV2()) || !sameVertex(fa.getV3(), fb.getV3()) ||
+       (!fa.isTriangle() && !sameVertex(fa.getV4(), fb.getV4())))
+      return false;
+  }
+  for(size_t i=0; i<a.materials.size(); i++)
+    if(a.materials[i].name != b.materials[i].name || a.materials[i].diffuseMap != b.materials[i].diffuseMap)
+      return false;
+  return true;
+}
+
+//Reads a whole argument as a number, without throwing on anything else
+bool readNumber(const char* text, int& value){
+  char* end;
+  long number = strtol(text, &end, 10);
+  if(end == text || *end || number < INT_MIN || number > INT_MAX)
+    return false;
+  value = int(number);
+  return true;
+}
+
+bool readNumber(const char* text, float& value){
+  char* end;
+  value = strtof(text, &end);
+  return end != text && !*end && std::isfinite(value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief main
+/// @param _argc Count of command line arguments
+/// @param _argv Command line arguments
+/// @return Application success status
+int
+main(int _argc, char** _argv) {
+  using namespace std::chrono;
+
+  int threads = max(8, int(thread::hardware_concurrency()));
+  int rounds = 20;
+  LoadOptions options;
+  string traceFile;
+  vector<string> inputs;
+  bool named = false;
+  bool usage = false;
+  for(int i=1; i<_argc && !usage; i++){
+    string arg = _argv[i];
+    if(arg == "-t" && i+1 < _argc)
+      usage = !readNumber(_argv[++i], threads) || threads < 1;
+    else if(arg == "-r" && i+1 < _argc)
+      usage = !readNumber(_argv[++i], rounds) || rounds < 1;
+    else if(arg == "-clean" && i+1 < _argc){
+      options.clean = true;
+      usage = !readNumber(_argv[++i], options.epsilon) || options.epsilon < 0.f;
+    }
+    else if(arg == "-trace" && i+1 < _argc)
+      traceFile = _argv[++i];
+    else{
+      MeshLoader::collectInputs(arg, inputs);
+      named = true;
+    }
+  }
+  //Without inputs every model in the working directory is loaded
+  if(!named)
+    MeshLoader::collectInputs(".", inputs);
+  if(inputs.empty() || usage){
+    cout << "Usage: " << _argv[0] << " [-t threads] [-r rounds] [-clean epsilon] [-trace file]"
+         << " [files or directories]" << endl;
+    return 1;
+  }
+  Trace::setEnabled(!traceFile.empty());
+  Trace::setThreadName("main");
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Reference loads, one at a time
+  vector<Mesh> reference(inputs.size());
+  long long triangles = 0;
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  for(size_t i=0; i<inputs.size(); i++){
+    reference[i] = MeshLoader::load(inputs[i], options);
+    if(reference[i].faces.empty()){
+      cout << "Could not load " << inputs[i] << endl;
+      return 1;
+    }
+    triangles += reference[i].getTriangleCount();
+  }
+  float serial = duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Every thread takes the next load until all rounds are done
+  int total = rounds*int(inputs.size());
+  atomic<int> next{0};
+  atomic<int> mismatches{0};
+  atomic<int> inFlight{0};
+  atomic<int> mostInFlight{0};
+  MemoryTracker::resetPeak();
+  start = high_resolution_clock::now();
+  vector<thread> workers;
+  for(int t=0; t<threads; t++)
+    workers.push_back(thread([&](){
+      Trace::setThreadName("load worker");
+      for(int job=next++; job<total; job=next++){
+        //Start each round at a different file so threads mix models
+        size_t file = size_t(job + job/int(inputs.size())) % inputs.size();
+        int loading = ++inFlight;
+        int most = mostInFlight;
+        while(loading > most && !mostInFlight.compare_exchange_weak(most, loading)){}
+        Mesh mesh = MeshLoader::load(inputs[file], options);
+        inFlight--;
+        if(!sameMesh(mesh, reference[file])){
+          cout << "Mismatch loading " << inputs[file] << endl;
+          mismatches++;
+        }
+      }
+    }));
+  for(size_t t=0; t<workers.size(); t++)
+    workers[t].join();
+  float wall = duration_cast<duration<float>>(high_resolution_clock::now()-start).count();
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Report
+  printf("%zu models, %lld triangles: one pass alone in %.3f s\n", inputs.size(), triangles, serial);
+  printf("%d loads on %d threads (up to %d at once) in %.3f s, %.1f loads/s, %.1f M triangles/s\n",
+         total, threads, int(mostInFlight), wall, total/wall, triangles*rounds/wall/1e6);
+  printf("Peak memory while loading %.1f MB, %d mismatches\n",
+         MemoryTracker::getTotalPeak()/1048576.0, int(mismatches));
+
+  if(!traceFile.empty())
+    Trace::write(traceFile);
+  return mismatches == 0 ? 0 : 1;
+}